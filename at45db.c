@@ -0,0 +1,233 @@
+/*************************************************************************
+* Title     : AT45DB DataFlash
+* Author    : Dimitri Dening
+* Created   : 17.10.2026 16:41:22
+* Software  : Microchip Studio V7
+* Hardware  : Atmega1284P
+
+DESCRIPTION:
+    Page and byte range access to an AT45DB041B through spi_transfer().
+USAGE:
+    see <at45db.h>
+NOTES:
+    Only the buffer the next page goes into is written while the chip is
+    busy, everything else polls the ready bit first. The buffer that is
+    programming was toggled away from by the time the next write starts.
+*************************************************************************/
+
+/* General libraries */
+#include <stddef.h>
+
+/* User defined libraries */
+#include "at45db.h"
+
+/* Opcode followed by 4 reserved bits, 11 page address bits and 9 byte address bits */
+#define AT45DB_COMMAND_BYTES    4
+#define AT45DB_BYTE_BITS        9
+
+/* Don't care bytes between the address and the data of a continuous array read */
+#define AT45DB_READ_DUMMY_BYTES 4
+
+#ifndef ARRAY_LEN
+# define ARRAY_LEN(a) (sizeof(a) / sizeof((a)[0]))
+#endif
+
+static void at45db_command(uint8_t* command, uint8_t opcode, uint16_t page, uint16_t offset){
+
+    uint32_t address = ((uint32_t)page << AT45DB_BYTE_BITS) | offset;
+
+    command[0] = opcode;
+    command[1] = (uint8_t)(address >> 16);
+    command[2] = (uint8_t)(address >> 8);
+    command[3] = (uint8_t)address;
+}
+
+/* 
+ * Sends a transaction under one chip select and sleeps until it completed. The transaction and
+ * the segments live on the stack, so this only returns once the bus is done with them. A
+ * submission without a free completion handle is refused by the driver and never queued.
+ */
+static spi_error_t at45db_transfer(at45db_t* flash, const spi_segment_t* segments, uint8_t nr_segments){
+
+    spi_transaction_t transaction = {
+        .device = flash->device,
+        .segments = segments,
+        .nr_segments = nr_segments,
+        .priority = PRIORITY_MEDIUM,
+        .callback = NULL,
+        .ctx = NULL
+    };
+
+    spi_handle_t handle = spi_transfer(&transaction);
+
+    if (handle == SPI_HANDLE_NONE) return SPI_ERR_BUFFER_OVERFLOW;
+
+    return spi_wait(handle);
+}
+
+static spi_error_t at45db_opcode(at45db_t* flash, uint8_t opcode, uint16_t page){
+
+    uint8_t command[AT45DB_COMMAND_BYTES];
+
+    at45db_command(command, opcode, page, 0);
+
+    const spi_segment_t segments[] = { SPI_TX(command, sizeof(command)) };
+
+    return at45db_transfer(flash, segments, ARRAY_LEN(segments));
+}
+
+/* Copies data into the current SRAM buffer, allowed while the other buffer programs */
+static spi_error_t at45db_buffer_write(at45db_t* flash, uint16_t offset, const uint8_t* data, spi_length_t length){
+
+    uint8_t command[AT45DB_COMMAND_BYTES];
+
+    at45db_command(command, flash->buffer ? AT45DB_BUFFER2_WRITE : AT45DB_BUFFER1_WRITE, 0, offset);
+
+    const spi_segment_t segments[] = {
+        SPI_TX(command, sizeof(command)),
+        SPI_TX(data, length)
+    };
+
+    return at45db_transfer(flash, segments, ARRAY_LEN(segments));
+}
+
+/* Starts programming the current SRAM buffer into a page and moves on to the other buffer */
+static spi_error_t at45db_buffer_program(at45db_t* flash, uint16_t page){
+
+    spi_error_t err = at45db_sync(flash);
+
+    if (err != SPI_NO_ERROR) return err;
+
+    err = at45db_opcode(flash, flash->buffer ? AT45DB_BUFFER2_PROGRAM : AT45DB_BUFFER1_PROGRAM, page);
+
+    if (err != SPI_NO_ERROR) return err;
+
+    flash->buffer ^= 1;
+
+    return SPI_NO_ERROR;
+}
+
+/* Writes part of a page, the rest of the page is loaded into the buffer first */
+static spi_error_t at45db_merge(at45db_t* flash, uint16_t page, uint16_t offset, const uint8_t* data, spi_length_t length){
+
+    spi_error_t err = at45db_sync(flash);
+
+    if (err != SPI_NO_ERROR) return err;
+
+    err = at45db_opcode(flash, flash->buffer ? AT45DB_PAGE_TO_BUFFER2 : AT45DB_PAGE_TO_BUFFER1, page);
+
+    if (err != SPI_NO_ERROR) return err;
+
+    /* The buffer is written by the transfer until the chip is ready again */
+    err = at45db_sync(flash);
+
+    if (err != SPI_NO_ERROR) return err;
+
+    err = at45db_buffer_write(flash, offset, data, length);
+
+    if (err != SPI_NO_ERROR) return err;
+
+    return at45db_buffer_program(flash, page);
+}
+
+spi_error_t at45db_init(at45db_t* flash, device_t* device){
+
+    if (device == NULL) return error_handler(SPI_ERR_INVALID_PORT);
+
+    flash->device = device;
+    flash->buffer = 0;
+
+    return at45db_sync(flash);
+}
+
+spi_error_t at45db_sync(at45db_t* flash){
+
+    static const uint8_t opcode = AT45DB_STATUS_READ;
+    uint8_t status;
+
+    const spi_segment_t segments[] = {
+        SPI_TX(&opcode, 1),
+        SPI_RX(&status, 1)
+    };
+
+    do {
+
+        spi_error_t err = at45db_transfer(flash, segments, ARRAY_LEN(segments));
+
+        if (err != SPI_NO_ERROR) return err;
+
+    } while (!(status & AT45DB_STATUS_READY));
+
+    return SPI_NO_ERROR;
+}
+
+spi_error_t at45db_read(at45db_t* flash, uint32_t address, uint8_t* data, spi_length_t length){
+
+    if (length == 0) return SPI_NO_ERROR;
+
+    if (address >= AT45DB_SIZE || length > AT45DB_SIZE - address) return error_handler(SPI_ERR_DATA_OVERFLOW);
+
+    uint8_t command[AT45DB_COMMAND_BYTES];
+
+    at45db_command(command, AT45DB_CONTINUOUS_READ, address / AT45DB_PAGE_SIZE, address % AT45DB_PAGE_SIZE);
+
+    const spi_segment_t segments[] = {
+        SPI_TX(command, sizeof(command)),
+        SPI_FILL(AT45DB_READ_DUMMY_BYTES),
+        SPI_RX(data, length)
+    };
+
+    /* The array can't be read while a page programs */
+    spi_error_t err = at45db_sync(flash);
+
+    if (err != SPI_NO_ERROR) return err;
+
+    return at45db_transfer(flash, segments, ARRAY_LEN(segments));
+}
+
+spi_error_t at45db_write(at45db_t* flash, uint32_t address, const uint8_t* data, spi_length_t length){
+
+    if (length == 0) return SPI_NO_ERROR;
+
+    if (address >= AT45DB_SIZE || length > AT45DB_SIZE - address) return error_handler(SPI_ERR_DATA_OVERFLOW);
+
+    while (length != 0) {
+
+        uint16_t page = address / AT45DB_PAGE_SIZE;
+        uint16_t offset = address % AT45DB_PAGE_SIZE;
+        spi_length_t chunk = AT45DB_PAGE_SIZE - offset;
+        spi_error_t err;
+
+        if (chunk > length) chunk = length;
+
+        if (chunk == AT45DB_PAGE_SIZE) err = at45db_write_page(flash, page, data);
+        else err = at45db_merge(flash, page, offset, data, chunk);
+
+        if (err != SPI_NO_ERROR) return err;
+
+        address += chunk;
+        data += chunk;
+        length -= chunk;
+    }
+
+    return SPI_NO_ERROR;
+}
+
+spi_error_t at45db_read_page(at45db_t* flash, uint16_t page, uint8_t* data){
+
+    if (page >= AT45DB_PAGES) return error_handler(SPI_ERR_DATA_OVERFLOW);
+
+    return at45db_read(flash, (uint32_t)page * AT45DB_PAGE_SIZE, data, AT45DB_PAGE_SIZE);
+}
+
+spi_error_t at45db_write_page(at45db_t* flash, uint16_t page, const uint8_t* data){
+
+    if (page >= AT45DB_PAGES) return error_handler(SPI_ERR_DATA_OVERFLOW);
+
+    /* Overlaps the program of the previous page, which uses the other buffer */
+    spi_error_t err = at45db_buffer_write(flash, 0, data, AT45DB_PAGE_SIZE);
+
+    if (err != SPI_NO_ERROR) return err;
+
+    return at45db_buffer_program(flash, page);
+}
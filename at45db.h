@@ -0,0 +1,121 @@
+/*************************************************************************
+* Title		: AT45DB DataFlash Driver
+* Author	: Dimitri Dening
+* Created	: 17.10.2026 17:52:10
+* Software	: Microchip Studio V7
+* Hardware	: Atmega1284P
+* License	: MIT License
+* Usage		: see Doxygen manual
+*
+*       Copyright (C) 2021 Dimitri Dening
+*
+*       Permission is hereby granted, free of charge, to any person obtaining a copy
+*       of this software and associated documentation files (the "Software"), to deal
+*       in the Software without restriction, including without limitation the rights
+*       to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*       copies of the Software, and to permit persons to whom the Software is
+*       furnished to do so, subject to the following conditions:
+*
+*       The above copyright notice and this permission notice shall be included in all
+*       copies or substantial portions of the Software.
+*
+*       THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*       IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*       FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*       AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*       LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*       OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*       SOFTWARE.
+*
+*************************************************************************/
+
+/**
+@file at45db.h
+@author Dimitri Dening
+@date 17.10.2026
+@copyright (C) 2021 Dimitri Dening, MIT License
+@brief Page and byte range access to an AT45DB041B DataFlash on top of the SPI driver.
+
+Addresses are linear byte addresses, address / AT45DB_PAGE_SIZE selects the page and
+address % AT45DB_PAGE_SIZE the byte within it.
+
+Reads use the continuous array read, so a range of any length crosses page boundaries
+within a single transaction.
+
+Writes go through the two SRAM buffers of the chip in turn. A page is copied into one buffer
+and programmed from there, and the next page is copied into the other buffer while the first
+one is still programming, so the SPI transfer and the program time of the chip overlap.
+Partial pages are merged with the current page content (read-modify-write).
+
+The chip is never waited on with a fixed delay. Before an operation that needs it to be idle
+the ready bit of the status register is polled.
+
+@code
+    static at45db_t flash;
+
+    at45db_init(&flash, spi_create_device(&PORTB, PORTB3, NULL));
+
+    at45db_write(&flash, 0, log_record, sizeof(log_record));
+    at45db_read(&flash, 0, copy, sizeof(copy));
+@endcode
+
+@note All functions block until their transfers completed, spi_wait() sleeps in the meantime.
+      With every completion handle taken they return SPI_ERR_BUFFER_OVERFLOW without sending.
+      They must not be called from an interrupt or a transaction callback.
+@note The last page program may still be running when at45db_write() returns, at45db_sync()
+      waits for it.
+@note Needs SPI_LENGTH_BITS 16 or 32, at45db.c and at45db_cache.c are left out of 8 bit builds.
+@bug No known bugs.
+*/
+#ifndef AT45DB_H_
+#define AT45DB_H_
+
+#include <stdint.h>
+
+#include "spi.h"
+
+#if SPI_LENGTH_BITS == 8
+# error "A 264 byte AT45DB page needs SPI_LENGTH_BITS 16 or 32"
+#endif
+
+#define AT45DB_PAGE_SIZE    264
+#define AT45DB_PAGES        2048
+#define AT45DB_SIZE         ((uint32_t)AT45DB_PAGE_SIZE * AT45DB_PAGES)
+
+/* Opcodes of the AT45DB041B */
+#define AT45DB_CONTINUOUS_READ      0xE8
+#define AT45DB_PAGE_READ            0xD2
+#define AT45DB_STATUS_READ          0xD7
+#define AT45DB_BUFFER1_WRITE        0x84
+#define AT45DB_BUFFER2_WRITE        0x87
+#define AT45DB_BUFFER1_PROGRAM      0x83    // Buffer to page program with built-in erase
+#define AT45DB_BUFFER2_PROGRAM      0x86
+#define AT45DB_PAGE_TO_BUFFER1      0x53
+#define AT45DB_PAGE_TO_BUFFER2      0x55
+
+/* Status register */
+#define AT45DB_STATUS_READY         0x80
+
+typedef struct at45db_t {
+    device_t* device;
+    uint8_t buffer;         // SRAM buffer the next page is copied into
+} at45db_t;
+
+spi_error_t at45db_init(at45db_t*, device_t*);
+
+/* Reads length bytes starting at a linear address */
+spi_error_t at45db_read(at45db_t*, uint32_t address, uint8_t* data, spi_length_t length);
+
+/* Writes length bytes starting at a linear address */
+spi_error_t at45db_write(at45db_t*, uint32_t address, const uint8_t* data, spi_length_t length);
+
+/* Reads one page */
+spi_error_t at45db_read_page(at45db_t*, uint16_t page, uint8_t* data);
+
+/* Writes one page of AT45DB_PAGE_SIZE bytes */
+spi_error_t at45db_write_page(at45db_t*, uint16_t page, const uint8_t* data);
+
+/* Polls the status register until the chip is idle */
+spi_error_t at45db_sync(at45db_t*);
+
+#endif /* AT45DB_H_ */
@@ -0,0 +1,201 @@
+/*************************************************************************
+* Title     : AT45DB Page Cache
+* Author    : Dimitri Dening
+* Created   : 17.10.2026 17:36:50
+* Software  : Microchip Studio V7
+* Hardware  : Atmega1284P
+
+DESCRIPTION:
+    Write-back cache of AT45DB pages with LRU eviction.
+USAGE:
+    see <at45db_cache.h>
+NOTES:
+    The frames are ranked by their age, the most recently used frame has
+    age 0 and the victim of a miss is the frame with the highest age.
+    Write backs use at45db_write_page(), so the program of an evicted page
+    overlaps the transfer of the next one.
+*************************************************************************/
+
+/* General libraries */
+#include <string.h>
+
+/* User defined libraries */
+#include "at45db_cache.h"
+
+/* Makes a frame the most recently used one */
+static void at45db_cache_touch(at45db_cache_t* cache, at45db_frame_t* frame){
+
+    for (uint8_t i = 0; i < AT45DB_CACHE_FRAMES; i++) {
+        if (cache->frames[i].age < frame->age) cache->frames[i].age++;
+    }
+
+    frame->age = 0;
+}
+
+static at45db_frame_t* at45db_cache_find(at45db_cache_t* cache, uint16_t page){
+
+    for (uint8_t i = 0; i < AT45DB_CACHE_FRAMES; i++) {
+        if (cache->frames[i].page == page) return &cache->frames[i];
+    }
+
+    return NULL;
+}
+
+static spi_error_t at45db_cache_write_back(at45db_cache_t* cache, at45db_frame_t* frame){
+
+    if (!frame->dirty) return SPI_NO_ERROR;
+
+    spi_error_t err = at45db_write_page(cache->flash, frame->page, frame->data);
+
+    if (err != SPI_NO_ERROR) return err;
+
+    frame->dirty = 0;
+    cache->write_backs++;
+
+    return SPI_NO_ERROR;
+}
+
+/*
+ * Returns the frame of a page, evicting the least recently used frame on a miss. The page is
+ * only read from the flash if load is set, a write of the whole page doesn't need it.
+ */
+static spi_error_t at45db_cache_get(at45db_cache_t* cache, uint16_t page, uint8_t load, at45db_frame_t** result){
+
+    at45db_frame_t* frame = at45db_cache_find(cache, page);
+
+    if (frame != NULL) {
+        cache->hits++;
+        at45db_cache_touch(cache, frame);
+        *result = frame;
+        return SPI_NO_ERROR;
+    }
+
+    cache->misses++;
+
+    frame = &cache->frames[0];
+
+    for (uint8_t i = 1; i < AT45DB_CACHE_FRAMES; i++) {
+        if (cache->frames[i].age > frame->age) frame = &cache->frames[i];
+    }
+
+    spi_error_t err = at45db_cache_write_back(cache, frame);
+
+    if (err != SPI_NO_ERROR) return err;
+
+    frame->page = AT45DB_CACHE_NO_PAGE;
+
+    if (load) {
+        err = at45db_read_page(cache->flash, page, frame->data);
+        if (err != SPI_NO_ERROR) return err;
+    }
+
+    frame->page = page;
+    at45db_cache_touch(cache, frame);
+    *result = frame;
+
+    return SPI_NO_ERROR;
+}
+
+void at45db_cache_init(at45db_cache_t* cache, at45db_t* flash){
+
+    cache->flash = flash;
+    cache->hits = 0;
+    cache->misses = 0;
+    cache->write_backs = 0;
+
+    at45db_cache_invalidate(cache);
+}
+
+spi_error_t at45db_cache_read(at45db_cache_t* cache, uint32_t address, uint8_t* data, spi_length_t length){
+
+    if (address >= AT45DB_SIZE || length > AT45DB_SIZE - address) return error_handler(SPI_ERR_DATA_OVERFLOW);
+
+    while (length != 0) {
+
+        uint16_t page = address / AT45DB_PAGE_SIZE;
+        uint16_t offset = address % AT45DB_PAGE_SIZE;
+        spi_length_t chunk = AT45DB_PAGE_SIZE - offset;
+        at45db_frame_t* frame;
+        spi_error_t err;
+
+        if (chunk > length) chunk = length;
+
+        if (chunk == AT45DB_PAGE_SIZE && at45db_cache_find(cache, page) == NULL) {
+            cache->misses++;
+            err = at45db_read_page(cache->flash, page, data);
+        } else {
+            err = at45db_cache_get(cache, page, 1, &frame);
+            if (err == SPI_NO_ERROR) memcpy(data, &frame->data[offset], chunk);
+        }
+
+        if (err != SPI_NO_ERROR) return err;
+
+        address += chunk;
+        data += chunk;
+        length -= chunk;
+    }
+
+    return SPI_NO_ERROR;
+}
+
+spi_error_t at45db_cache_write(at45db_cache_t* cache, uint32_t address, const uint8_t* data, spi_length_t length){
+
+    if (address >= AT45DB_SIZE || length > AT45DB_SIZE - address) return error_handler(SPI_ERR_DATA_OVERFLOW);
+
+    while (length != 0) {
+
+        uint16_t page = address / AT45DB_PAGE_SIZE;
+        uint16_t offset = address % AT45DB_PAGE_SIZE;
+        spi_length_t chunk = AT45DB_PAGE_SIZE - offset;
+        at45db_frame_t* frame;
+
+        if (chunk > length) chunk = length;
+
+        spi_error_t err = at45db_cache_get(cache, page, chunk != AT45DB_PAGE_SIZE, &frame);
+
+        if (err != SPI_NO_ERROR) return err;
+
+        memcpy(&frame->data[offset], data, chunk);
+        frame->dirty = 1;
+
+        address += chunk;
+        data += chunk;
+        length -= chunk;
+    }
+
+    return SPI_NO_ERROR;
+}
+
+spi_error_t at45db_cache_sync(at45db_cache_t* cache){
+
+    for (uint8_t i = 0; i < AT45DB_CACHE_FRAMES; i++) {
+
+        spi_error_t err = at45db_cache_write_back(cache, &cache->frames[i]);
+
+        if (err != SPI_NO_ERROR) return err;
+    }
+
+    return at45db_sync(cache->flash);
+}
+
+void at45db_cache_invalidate(at45db_cache_t* cache){
+
+    for (uint8_t i = 0; i < AT45DB_CACHE_FRAMES; i++) {
+        cache->frames[i].page = AT45DB_CACHE_NO_PAGE;
+        cache->frames[i].dirty = 0;
+        cache->frames[i].age = i;
+    }
+}
+
+void at45db_cache_stats(const at45db_cache_t* cache, at45db_cache_stats_t* stats){
+
+    stats->frames = AT45DB_CACHE_FRAMES;
+    stats->dirty = 0;
+    stats->hits = cache->hits;
+    stats->misses = cache->misses;
+    stats->write_backs = cache->write_backs;
+
+    for (uint8_t i = 0; i < AT45DB_CACHE_FRAMES; i++) {
+        if (cache->frames[i].dirty) stats->dirty++;
+    }
+}
@@ -0,0 +1,116 @@
+/*************************************************************************
+* Title		: AT45DB Page Cache
+* Author	: Dimitri Dening
+* Created	: 17.10.2026 17:36:50
+* Software	: Microchip Studio V7
+* Hardware	: Atmega1284P
+* License	: MIT License
+* Usage		: see Doxygen manual
+*
+*       Copyright (C) 2021 Dimitri Dening
+*
+*       Permission is hereby granted, free of charge, to any person obtaining a copy
+*       of this software and associated documentation files (the "Software"), to deal
+*       in the Software without restriction, including without limitation the rights
+*       to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*       copies of the Software, and to permit persons to whom the Software is
+*       furnished to do so, subject to the following conditions:
+*
+*       The above copyright notice and this permission notice shall be included in all
+*       copies or substantial portions of the Software.
+*
+*       THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*       IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*       FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*       AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*       LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*       OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*       SOFTWARE.
+*
+*************************************************************************/
+
+/**
+@file at45db_cache.h
+@author Dimitri Dening
+@date 17.10.2026
+@copyright (C) 2021 Dimitri Dening, MIT License
+@brief Optional write-back RAM cache of AT45DB pages between the application and <at45db.h>.
+
+The cache holds AT45DB_CACHE_FRAMES pages. A read or write that touches a cached page is served
+from RAM, a miss loads the page into the least recently used frame. Writes only mark their frame
+dirty, the page is written back when its frame is evicted or at45db_cache_sync() is called.
+
+A read miss that covers a whole page bypasses the cache, so long sequential reads don't push the
+small, hot pages out. A write that covers a whole page doesn't load the page first.
+
+@code
+    static at45db_t flash;
+    static at45db_cache_t cache;
+
+    at45db_init(&flash, spi_create_device(&PORTB, PORTB3, NULL));
+    at45db_cache_init(&cache, &flash);
+
+    at45db_cache_write(&cache, CONFIG_ADDRESS, &config, sizeof(config));
+    at45db_cache_sync(&cache);
+@endcode
+
+@note Accesses that bypass the cache and go to <at45db.h> directly don't see dirty frames,
+      call at45db_cache_sync() first.
+@note Every frame takes AT45DB_PAGE_SIZE bytes of RAM.
+@bug No known bugs.
+*/
+#ifndef AT45DB_CACHE_H_
+#define AT45DB_CACHE_H_
+
+#include <stdint.h>
+
+#include "at45db.h"
+
+/* Number of cached pages */
+#ifndef AT45DB_CACHE_FRAMES
+#define AT45DB_CACHE_FRAMES 4
+#endif
+
+#define AT45DB_CACHE_NO_PAGE 0xFFFF
+
+typedef struct at45db_frame_t {
+    uint16_t page;              // AT45DB_CACHE_NO_PAGE while the frame is empty
+    uint8_t dirty;
+    uint8_t age;                // 0 for the most recently used frame
+    uint8_t data[AT45DB_PAGE_SIZE];
+} at45db_frame_t;
+
+typedef struct at45db_cache_t {
+    at45db_t* flash;
+    at45db_frame_t frames[AT45DB_CACHE_FRAMES];
+    uint32_t hits;              // Page accesses served from a frame
+    uint32_t misses;            // Page accesses that went to the flash
+    uint32_t write_backs;       // Dirty pages written to the flash
+} at45db_cache_t;
+
+/* Snapshot of the cache counters */
+typedef struct at45db_cache_stats_t {
+    uint8_t frames;
+    uint8_t dirty;              // Frames waiting for a write back
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t write_backs;
+} at45db_cache_stats_t;
+
+void at45db_cache_init(at45db_cache_t*, at45db_t*);
+
+/* Reads length bytes starting at a linear address */
+spi_error_t at45db_cache_read(at45db_cache_t*, uint32_t address, uint8_t* data, spi_length_t length);
+
+/* Writes length bytes starting at a linear address into the cache */
+spi_error_t at45db_cache_write(at45db_cache_t*, uint32_t address, const uint8_t* data, spi_length_t length);
+
+/* Writes every dirty frame back and waits until the last page is programmed */
+spi_error_t at45db_cache_sync(at45db_cache_t*);
+
+/* Drops every frame, dirty frames are lost */
+void at45db_cache_invalidate(at45db_cache_t*);
+
+void at45db_cache_stats(const at45db_cache_t*, at45db_cache_stats_t*);
+
+#endif /* AT45DB_CACHE_H_ */
@@ -0,0 +1,183 @@
+/*************************************************************************
+* Title     : Host-side AT45DB DataFlash Model
+* Author    : Dimitri Dening
+* Created   : 17.10.2026 16:58:03
+* Software  : GCC (host)
+* Hardware  : Simulated AT45DB041B
+
+DESCRIPTION:
+    Slave model of an AT45DB041B with its memory array, both SRAM buffers
+    and the busy time of page programs and transfers.
+USAGE:
+    see <at45db_sim.h>
+NOTES:
+    The opcode is checked against the busy state when its byte arrives,
+    programs and transfers run when the chip select is released.
+*************************************************************************/
+
+/* General libraries */
+#include <string.h>
+
+/* User defined libraries */
+#include "at45db_sim.h"
+
+#define AT45DB_SIM_COMMAND_BYTES    4
+#define AT45DB_SIM_READ_DUMMY_BYTES 4
+#define AT45DB_SIM_DENSITY          0x1C    // Status bits 5:2 of the 4 Mbit part
+#define AT45DB_SIM_IDLE             0xFF    // MISO while the chip doesn't drive it
+
+static uint8_t busy(at45db_sim_t* sim) {
+
+    if (spi_sim_now() < sim->busy_until) return 1;
+
+    sim->busy_buffer = AT45DB_SIM_NO_BUFFER;
+
+    return 0;
+}
+
+/* SRAM buffer of a buffer write, program or transfer opcode, AT45DB_SIM_NO_BUFFER otherwise */
+static uint8_t buffer_of(uint8_t opcode) {
+
+    switch (opcode) {
+        case AT45DB_BUFFER1_WRITE:
+        case AT45DB_BUFFER1_PROGRAM:
+        case AT45DB_PAGE_TO_BUFFER1:
+            return 0;
+        case AT45DB_BUFFER2_WRITE:
+        case AT45DB_BUFFER2_PROGRAM:
+        case AT45DB_PAGE_TO_BUFFER2:
+            return 1;
+        default:
+            return AT45DB_SIM_NO_BUFFER;
+    }
+}
+
+/* Returns 1 if the command may run in the current busy state */
+static uint8_t allowed(at45db_sim_t* sim, uint8_t opcode) {
+
+    if (!busy(sim)) return 1;
+
+    if (opcode == AT45DB_STATUS_READ) return 1;
+
+    if (opcode == AT45DB_BUFFER1_WRITE || opcode == AT45DB_BUFFER2_WRITE) {
+        return buffer_of(opcode) != sim->busy_buffer;
+    }
+
+    return 0;
+}
+
+/* Moves the data position to the next byte, continuous reads cross into the next page */
+static void advance(at45db_sim_t* sim) {
+
+    if (++sim->offset < AT45DB_PAGE_SIZE) return;
+
+    sim->offset = 0;
+
+    if (sim->opcode == AT45DB_CONTINUOUS_READ) sim->page = (sim->page + 1) % AT45DB_PAGES;
+}
+
+void at45db_sim_init(at45db_sim_t* sim) {
+
+    /* Erased flash reads as 0xFF, the buffers power up undefined */
+    memset(sim->memory, 0xFF, sizeof(sim->memory));
+    memset(sim->buffers, 0x00, sizeof(sim->buffers));
+
+    sim->busy_until = 0;
+    sim->busy_buffer = AT45DB_SIM_NO_BUFFER;
+    sim->opcode = 0;
+    sim->ignored = 0;
+    sim->index = 0;
+    sim->address = 0;
+    sim->page = 0;
+    sim->offset = 0;
+    sim->reads = 0;
+    sim->programs = 0;
+    sim->transfers = 0;
+    sim->status_reads = 0;
+    sim->violations = 0;
+}
+
+uint8_t at45db_sim_xfer(void* ctx, uint8_t mosi) {
+
+    at45db_sim_t* sim = ctx;
+    uint16_t index = sim->index++;
+
+    if (index == 0) {
+        sim->opcode = mosi;
+        sim->address = 0;
+        sim->ignored = !allowed(sim, mosi);
+        if (sim->ignored) sim->violations++;
+        else if (mosi == AT45DB_STATUS_READ) sim->status_reads++;
+        return AT45DB_SIM_IDLE;
+    }
+
+    if (sim->ignored) return AT45DB_SIM_IDLE;
+
+    if (sim->opcode == AT45DB_STATUS_READ) {
+        return (busy(sim) ? 0 : AT45DB_STATUS_READY) | AT45DB_SIM_DENSITY;
+    }
+
+    if (index < AT45DB_SIM_COMMAND_BYTES) {
+        sim->address = (sim->address << 8) | mosi;
+        if (index == AT45DB_SIM_COMMAND_BYTES - 1) {
+            sim->page = (sim->address >> 9) % AT45DB_PAGES;
+            sim->offset = (sim->address & 0x1FF) % AT45DB_PAGE_SIZE;
+        }
+        return AT45DB_SIM_IDLE;
+    }
+
+    switch (sim->opcode) {
+
+        case AT45DB_CONTINUOUS_READ:
+        case AT45DB_PAGE_READ: {
+            if (index < AT45DB_SIM_COMMAND_BYTES + AT45DB_SIM_READ_DUMMY_BYTES) return AT45DB_SIM_IDLE;
+            uint8_t data = sim->memory[(uint32_t)sim->page * AT45DB_PAGE_SIZE + sim->offset];
+            sim->reads++;
+            advance(sim);
+            return data;
+        }
+
+        case AT45DB_BUFFER1_WRITE:
+        case AT45DB_BUFFER2_WRITE:
+            sim->buffers[buffer_of(sim->opcode)][sim->offset] = mosi;
+            advance(sim);
+            return AT45DB_SIM_IDLE;
+
+        default:
+            return AT45DB_SIM_IDLE;
+    }
+}
+
+void at45db_sim_release(void* ctx) {
+
+    at45db_sim_t* sim = ctx;
+    uint8_t complete = sim->index >= AT45DB_SIM_COMMAND_BYTES && !sim->ignored;
+    uint8_t* page = &sim->memory[(uint32_t)sim->page * AT45DB_PAGE_SIZE];
+    uint8_t buffer = buffer_of(sim->opcode);
+
+    sim->index = 0;
+
+    if (!complete) return;
+
+    switch (sim->opcode) {
+
+        case AT45DB_BUFFER1_PROGRAM:
+        case AT45DB_BUFFER2_PROGRAM:
+            memcpy(page, sim->buffers[buffer], AT45DB_PAGE_SIZE);
+            sim->busy_until = spi_sim_now() + AT45DB_SIM_PROGRAM_CYCLES;
+            sim->busy_buffer = buffer;
+            sim->programs++;
+            break;
+
+        case AT45DB_PAGE_TO_BUFFER1:
+        case AT45DB_PAGE_TO_BUFFER2:
+            memcpy(sim->buffers[buffer], page, AT45DB_PAGE_SIZE);
+            sim->busy_until = spi_sim_now() + AT45DB_SIM_TRANSFER_CYCLES;
+            sim->busy_buffer = buffer;
+            sim->transfers++;
+            break;
+
+        default:
+            break;
+    }
+}
@@ -0,0 +1,97 @@
+/*************************************************************************
+* Title		: Host-side AT45DB DataFlash Model
+* Author	: Dimitri Dening
+* Created	: 17.10.2026 16:58:03
+* Software	: GCC (host)
+* Hardware	: Simulated AT45DB041B
+* License	: MIT License
+* Usage		: see Doxygen manual
+*
+*       Copyright (C) 2021 Dimitri Dening
+*
+*       Permission is hereby granted, free of charge, to any person obtaining a copy
+*       of this software and associated documentation files (the "Software"), to deal
+*       in the Software without restriction, including without limitation the rights
+*       to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*       copies of the Software, and to permit persons to whom the Software is
+*       furnished to do so, subject to the following conditions:
+*
+*       The above copyright notice and this permission notice shall be included in all
+*       copies or substantial portions of the Software.
+*
+*       THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*       IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*       FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*       AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*       LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*       OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*       SOFTWARE.
+*
+* NOTES:
+*	Attach with spi_sim_attach() after spi_sim_reset(), the model keeps
+*	its whole memory array, so give it static storage.
+*************************************************************************/
+
+/**
+@file at45db_sim.h
+@author Dimitri Dening
+@date 17.10.2026
+@copyright (C) 2021 Dimitri Dening, MIT License
+@brief Slave model of an AT45DB041B for the host simulation in <spi_sim.h>.
+
+The model decodes the opcodes <at45db.h> uses: continuous array and main memory page read,
+status read, buffer write, buffer to page program with built-in erase and page to buffer transfer.
+Programs and transfers start when the chip select is released and keep the chip busy for
+AT45DB_SIM_PROGRAM_CYCLES and AT45DB_SIM_TRANSFER_CYCLES of the simulated CPU clock, the status
+register reports ready once they elapsed.
+
+While the chip is busy only status reads and writes to the buffer that is not in use are allowed,
+every other command is counted as a violation and ignored, so a driver that doesn't wait for the
+chip shows up in the statistics instead of silently working.
+
+@code
+    static at45db_sim_t flash;
+
+    spi_sim_reset();
+    at45db_sim_init(&flash);
+    spi_sim_attach(SIM_PORTB, PORTB2, at45db_sim_xfer, at45db_sim_release, &flash);
+@endcode
+@bug No known bugs.
+*/
+#ifndef AT45DB_SIM_H_
+#define AT45DB_SIM_H_
+
+#include <stdint.h>
+
+#include "at45db.h"
+#include "spi_sim.h"
+
+/* Typical program and transfer times of the datasheet at F_CPU */
+#define AT45DB_SIM_PROGRAM_CYCLES   ((uint64_t)F_CPU / 1000 * 20)      // tEP 20 ms
+#define AT45DB_SIM_TRANSFER_CYCLES  ((uint64_t)F_CPU / 1000000 * 250)  // tXFR 250 us
+
+#define AT45DB_SIM_NO_BUFFER        0xFF
+
+typedef struct at45db_sim_t {
+    uint8_t memory[AT45DB_SIZE];
+    uint8_t buffers[2][AT45DB_PAGE_SIZE];
+    uint64_t busy_until;            // Cycle the running program or transfer completes
+    uint8_t busy_buffer;            // Buffer used by it, AT45DB_SIM_NO_BUFFER if idle
+    uint8_t opcode;                 // Command of the current chip select
+    uint8_t ignored;                // Current command is a violation
+    uint16_t index;                 // Bytes since the chip select was asserted
+    uint32_t address;               // Address bytes of the command
+    uint16_t page;                  // Decoded address, advanced by the data bytes
+    uint16_t offset;
+    uint32_t reads;                 // Bytes read from the array
+    uint32_t programs;
+    uint32_t transfers;
+    uint32_t status_reads;
+    uint32_t violations;
+} at45db_sim_t;
+
+void at45db_sim_init(at45db_sim_t*);
+uint8_t at45db_sim_xfer(void* ctx, uint8_t mosi);
+void at45db_sim_release(void* ctx);
+
+#endif /* AT45DB_SIM_H_ */
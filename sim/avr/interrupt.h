@@ -0,0 +1,23 @@
+/*************************************************************************
+* Title		: <avr/interrupt.h> shim for host builds
+* Author	: Dimitri Dening
+* Created	: 17.10.2026 09:12:40
+* Software	: GCC (host)
+* Hardware	: Simulated ATmega1284P
+* License	: MIT License
+*
+* NOTES:
+*	ISR() expands to a plain function that the register model in
+*	<spi_sim.c> calls once the interrupt condition is met.
+*************************************************************************/
+#ifndef SIM_AVR_INTERRUPT_H_
+#define SIM_AVR_INTERRUPT_H_
+
+#include "../spi_sim.h"
+
+#define ISR(vector)         void vector(void); void vector(void)
+
+#define sei()               spi_sim_sei()
+#define cli()               spi_sim_cli()
+
+#endif /* SIM_AVR_INTERRUPT_H_ */
@@ -0,0 +1,18 @@
+/*************************************************************************
+* Title		: <avr/io.h> shim for host builds
+* Author	: Dimitri Dening
+* Created	: 17.10.2026 09:12:40
+* Software	: GCC (host)
+* Hardware	: Simulated ATmega1284P
+* License	: MIT License
+*
+* NOTES:
+*	Resolves the register declarations used by <spi_io.h> to the
+*	register model in <spi_sim.h>.
+*************************************************************************/
+#ifndef SIM_AVR_IO_H_
+#define SIM_AVR_IO_H_
+
+#include "../spi_sim.h"
+
+#endif /* SIM_AVR_IO_H_ */
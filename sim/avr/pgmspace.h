@@ -0,0 +1,27 @@
+/*************************************************************************
+* Title		: <avr/pgmspace.h> shim for host builds
+* Author	: Dimitri Dening
+* Created	: 17.10.2026 18:20:15
+* Software	: GCC (host)
+* Hardware	: Simulated ATmega1284P
+* License	: MIT License
+*
+* NOTES:
+*	The host has a single address space, flash data is ordinary const
+*	data and the accessors are plain reads.
+*************************************************************************/
+#ifndef SIM_AVR_PGMSPACE_H_
+#define SIM_AVR_PGMSPACE_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#define PROGMEM
+#define PGM_P                       const char*
+
+#define pgm_read_byte(address)      (*(const uint8_t*)(address))
+#define pgm_read_word(address)      (*(const uint16_t*)(address))
+#define pgm_read_ptr(address)       (*(const void* const*)(address))
+#define strncpy_P(dst, src, n)      strncpy((dst), (src), (n))
+
+#endif /* SIM_AVR_PGMSPACE_H_ */
@@ -0,0 +1,25 @@
+/*************************************************************************
+* Title		: <avr/sleep.h> shim for host builds
+* Author	: Dimitri Dening
+* Created	: 17.10.2026 15:24:08
+* Software	: GCC (host)
+* Hardware	: Simulated ATmega1284P
+* License	: MIT License
+*
+* NOTES:
+*	sleep_cpu() advances the register model in <spi_sim.c> to the
+*	next byte completion instead of halting the host.
+*************************************************************************/
+#ifndef SIM_AVR_SLEEP_H_
+#define SIM_AVR_SLEEP_H_
+
+#include "../spi_sim.h"
+
+#define SLEEP_MODE_IDLE     0
+
+#define set_sleep_mode(mode)    ((void)(mode))
+#define sleep_enable()
+#define sleep_disable()
+#define sleep_cpu()             spi_sim_sleep()
+
+#endif /* SIM_AVR_SLEEP_H_ */
@@ -0,0 +1,149 @@
+/*************************************************************************
+* Title		: SPI Driver Check without the Classic SPI
+* Author	: Dimitri Dening
+* Created	: 18.10.2026 00:41:27
+* Software	: GCC (host)
+* Hardware	: Simulated AVR128DA48
+* Usage		: see Doxygen manual
+* License	: MIT License
+*
+*       Copyright (C) 2021 Dimitri Dening
+*
+*       Permission is hereby granted, free of charge, to any person obtaining a copy
+*       of this software and associated documentation files (the "Software"), to deal
+*       in the Software without restriction, including without limitation the rights
+*       to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*       copies of the Software, and to permit persons to whom the Software is
+*       furnished to do so, subject to the following conditions:
+*
+*       The above copyright notice and this permission notice shall be included in all
+*       copies or substantial portions of the Software.
+*
+*       THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*       IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*       FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*       AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*       LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*       OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*       SOFTWARE.
+*
+*************************************************************************/
+
+/**
+@file bench_dx.c
+@author Dimitri Dening
+@date 18.10.2026
+@brief Host-side check of the driver built for an MCU without the classic SPI.
+
+The simulation built with -DSPI_SIM_DX=1 has no SPCR, SPSR and SPDR, like an AVR Dx, so the
+driver is compiled without SPI_BUS_SPI. spi_init(), spi_add_device() and spi_stream_start()
+have to report SPI_ERR_INVALID_PORT, and the buffered SPI has to carry a transaction:
+
+@code
+    dx native=0 init=4 add=4 stream=4 bytes=64 cs_asserts=1 ok
+@endcode
+
+@note Build from the repository root:
+@code
+    gcc -std=c99 -O2 -Isim -I. -DSPI_SIM_DX=1 -DSPI_BUFFERED=1 sim/spi_sim.c sim/bench_dx.c spi.c spi_mspim.c spi_payload.c spi_queue.c spi_completion.c spi_error_handler.c spi_trace.c spi_soft.c spi_buffered.c -o bench_dx
+@endcode
+*/
+#include <avr/interrupt.h>
+#include <stdio.h>
+#include <stdint.h>
+
+#include "spi.h"
+
+#if SPI_NATIVE || !SPI_BUFFERED
+#  error "Build with -DSPI_SIM_DX=1 -DSPI_BUFFERED=1"
+#endif
+
+#define BENCH_CS        PORTC2
+#define BENCH_LENGTH    64
+
+static uint8_t tx[BENCH_LENGTH];
+static uint8_t rx[BENCH_LENGTH];
+static uint8_t buffer[BENCH_LENGTH];
+
+/* Slave model: echoes the previous MOSI byte, ctx holds the last byte */
+static uint8_t echo(void* ctx, uint8_t mosi) {
+    uint8_t* last = ctx;
+    uint8_t miso = *last;
+    *last = mosi;
+    return miso;
+}
+
+static uint8_t echo_buffered;
+
+int main(void) {
+
+    uint8_t ok = 1;
+
+    for (uint8_t i = 0; i < BENCH_LENGTH; i++) tx[i] = i;
+
+    spi_config_t config = {
+        .data_order = SPI_MSB,
+        .mode = SPI_MODE3,
+        .clockrate = SPI_CLOCK_DIV16,
+        .poll_threshold = 0,
+        .fill_byte = SPI_FILL_BYTE
+    };
+
+    spi_sim_reset();
+    spi_sim_attach_buffered(SIM_PORTC, BENCH_CS, echo, NULL, &echo_buffered);
+
+    /* The payload pool and the handles are set up, the classic SPI is reported missing */
+    spi_error_t init = spi_init(&config);
+    ok &= init == SPI_ERR_INVALID_PORT;
+
+    ok &= spi_bus_init(SPI_BUS_BUFFERED, &config) == SPI_NO_ERROR;
+    sei();
+
+    /* Devices and streams of the classic SPI are rejected */
+    static device_t orphan;
+    orphan.port = &PORTC;
+    orphan.mask = (1 << PORTC3);
+    spi_error_t add = spi_add_device(&orphan);
+    ok &= add == SPI_ERR_INVALID_PORT;
+
+    spi_device_config_t device_config = {
+        .bus = SPI_BUS_BUFFERED,
+        .data_order = config.data_order,
+        .mode = config.mode,
+        .max_frequency = 0,
+        .fill_byte = config.fill_byte
+    };
+
+    device_t* device = spi_create_device(&PORTC, BENCH_CS, &device_config);
+    ok &= device != NULL;
+
+    static uint8_t* const buffers[] = { buffer };
+    static spi_stream_t stream = { .buffers = buffers, .nr_buffers = 1, .length = BENCH_LENGTH };
+    stream.transaction.device = device;
+
+    spi_error_t streamed = spi_wait(spi_stream_start(&stream));
+    ok &= streamed == SPI_ERR_INVALID_PORT;
+
+    spi_sim_stats_reset();
+
+    const spi_segment_t segments[] = { SPI_DUPLEX(tx, rx, BENCH_LENGTH) };
+    spi_transaction_t transaction = { .device = device, .segments = segments, .nr_segments = 1, .priority = PRIORITY_LOW };
+
+    ok &= spi_wait(spi_transfer(&transaction)) == SPI_NO_ERROR;
+
+    /* The echo slave returns the previous byte */
+    for (uint8_t i = 1; i < BENCH_LENGTH; i++) {
+        if (rx[i] != tx[i - 1]) ok = 0;
+    }
+
+    const spi_sim_stats_t* s = spi_sim_stats();
+    ok &= s->bytes == BENCH_LENGTH && s->cs_asserts == 1;
+
+    printf("dx native=%u init=%u add=%u stream=%u bytes=%lu cs_asserts=%lu %s\n",
+        (unsigned)SPI_NATIVE, (unsigned)init, (unsigned)add, (unsigned)streamed,
+        (unsigned long)s->bytes, (unsigned long)s->cs_asserts, ok ? "ok" : "error");
+
+    spi_free_device(device);
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,118 @@
+/*************************************************************************
+* Title		: SPI C++ Wrapper Check
+* Author	: Dimitri Dening
+* Created	: 17.10.2026 23:58:03
+* Software	: G++ (host)
+* Hardware	: Simulated ATmega1284P
+* Usage		: see Doxygen manual
+* License	: MIT License
+*
+*       Copyright (C) 2021 Dimitri Dening
+*
+*       Permission is hereby granted, free of charge, to any person obtaining a copy
+*       of this software and associated documentation files (the "Software"), to deal
+*       in the Software without restriction, including without limitation the rights
+*       to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*       copies of the Software, and to permit persons to whom the Software is
+*       furnished to do so, subject to the following conditions:
+*
+*       The above copyright notice and this permission notice shall be included in all
+*       copies or substantial portions of the Software.
+*
+*       THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*       IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*       FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*       AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*       LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*       OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*       SOFTWARE.
+*
+*************************************************************************/
+
+/**
+@file bench_hpp.cpp
+@author Dimitri Dening
+@date 17.10.2026
+@brief Host-side check of the C++ wrapper <spi.hpp> against the simulated peripheral in <spi_sim.h>.
+
+Sets up a bus type with two devices on different ports, checks that their register values are the
+ones spi_create_device() resolves for the same settings and sends a write to each of them:
+
+@code
+    hpp devices=2 flash_ctrl=0xdd dac_ctrl=0xd0 cs_asserts=2 bytes=8 ok
+@endcode
+
+@note Build from the repository root, the driver is compiled as C and linked with the C++ object.
+      The same lines with -DSPI_STATS=1 -DSPI_TRACE=1 cover the optional device_t members:
+@code
+    gcc -std=c99 -O2 -Isim -I. -c sim/spi_sim.c spi.c spi_mspim.c spi_payload.c spi_queue.c spi_completion.c spi_error_handler.c spi_trace.c spi_soft.c spi_buffered.c
+    g++ -std=c++11 -O2 -Wall -Wextra -Isim -I. sim/bench_hpp.cpp spi_sim.o spi.o spi_mspim.o spi_payload.o spi_queue.o spi_completion.o spi_error_handler.o spi_trace.o spi_soft.o spi_buffered.o -o bench_hpp
+@endcode
+*/
+#include <avr/interrupt.h>
+#include <sys/types.h>
+#include <stdio.h>
+
+#include "spi.hpp"
+
+#define BENCH_FILL 0xFF
+
+typedef spi::device<spi::port::B, PORTB4, spi::settings<SPI_MSB, SPI_MODE3, 16, BENCH_FILL>> flash;
+typedef spi::device<spi::port::D, PORTD5, spi::settings<SPI_MSB, SPI_MODE0, 4>> dac;
+typedef spi::bus<spi::settings<SPI_MSB, SPI_MODE3, 2>, flash, dac> bus;
+
+static uint8_t tx[4] = { 0x82, 0x00, 0x01, 0x08 };
+
+/* Slave model: echoes the previous MOSI byte, ctx holds the last byte */
+static uint8_t echo(void* ctx, uint8_t mosi) {
+    uint8_t* last = static_cast<uint8_t*>(ctx);
+    uint8_t miso = *last;
+    *last = mosi;
+    return miso;
+}
+
+static uint8_t echo_flash;
+static uint8_t echo_dac;
+
+/* The register values spi_create_device() resolves for the settings of a device */
+static uint8_t bench_matches(device_t* device, volatile uint8_t* port, uint8_t pin, spi_mode_t mode, uint32_t frequency, uint8_t fill) {
+
+    spi_device_config_t config = { SPI_BUS_SPI, SPI_MSB, mode, frequency, fill };
+    device_t* runtime = spi_create_device(port, pin, &config);
+
+    uint8_t ok = runtime != NULL && runtime->ctrl == device->ctrl && runtime->rate == device->rate
+        && runtime->fill == device->fill && runtime->poll_max_bytes == device->poll_max_bytes;
+
+    if (runtime != NULL) spi_free_device(runtime);
+
+    return ok;
+}
+
+int main(void) {
+
+    spi_sim_reset();
+    spi_sim_attach(SIM_PORTB, PORTB4, echo, NULL, &echo_flash);
+    spi_sim_attach(SIM_PORTD, PORTD5, echo, NULL, &echo_dac);
+
+    uint8_t ok = bus::init() == SPI_NO_ERROR;
+    sei();
+
+    ok &= bench_matches(flash::get(), &PORTB, PORTB4, SPI_MODE3, F_CPU / 16, BENCH_FILL);
+    ok &= bench_matches(dac::get(), &PORTD, PORTD5, SPI_MODE0, F_CPU / 4, SPI_FILL_BYTE);
+
+    /* Both chip selects are outputs and inactive */
+    ok &= (PORTB & (1 << PORTB4)) && (DDRB & (1 << PORTB4)) && (PORTD & (1 << PORTD5)) && (DDRD & (1 << PORTD5));
+
+    spi_sim_stats_reset();
+
+    ok &= spi_wait(spi_write(payload_create_spi(PRIORITY_LOW, flash::get(), tx, sizeof(tx), NULL))) == SPI_NO_ERROR;
+    ok &= spi_wait(spi_write(payload_create_spi(PRIORITY_LOW, dac::get(), tx, sizeof(tx), NULL))) == SPI_NO_ERROR;
+
+    const spi_sim_stats_t* s = spi_sim_stats();
+    ok &= s->cs_asserts == 2 && s->bytes == 2 * sizeof(tx) && echo_flash == tx[3] && echo_dac == tx[3];
+
+    printf("hpp devices=2 flash_ctrl=0x%02x dac_ctrl=0x%02x cs_asserts=%lu bytes=%lu %s\n",
+        flash::get()->ctrl, dac::get()->ctrl, (unsigned long)s->cs_asserts, (unsigned long)s->bytes, ok ? "ok" : "error");
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,1666 @@
+/*************************************************************************
+* Title		: SPI Throughput Benchmark
+* Author	: Dimitri Dening
+* Created	: 17.10.2026 09:12:40
+* Software	: GCC (host)
+* Hardware	: Simulated ATmega1284P
+* Usage		: see Doxygen manual
+* License	: MIT License
+*
+*       Copyright (C) 2021 Dimitri Dening
+*
+*       Permission is hereby granted, free of charge, to any person obtaining a copy
+*       of this software and associated documentation files (the "Software"), to deal
+*       in the Software without restriction, including without limitation the rights
+*       to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*       copies of the Software, and to permit persons to whom the Software is
+*       furnished to do so, subject to the following conditions:
+*
+*       The above copyright notice and this permission notice shall be included in all
+*       copies or substantial portions of the Software.
+*
+*       THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*       IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*       FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*       AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*       LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*       OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*       SOFTWARE.
+*
+*************************************************************************/
+
+/**
+@file bench_spi.c
+@author Dimitri Dening
+@date 17.10.2026
+@brief Host-side SPI benchmark against the simulated peripheral in <spi_sim.h>.
+
+Runs the unchanged driver for every clock_rate_t and a set of payload sizes and
+prints one machine-readable line per case:
+
+@code
+    bench bus=spi div=16 size=64 transfers=32 bytes=2048 cycles=337651 bytes_per_s=60654 isr_cycles_per_byte=70 isr_ns_per_byte=131 cs_gap_cycles=4 bus_util=77% pool_hwm=4
+@endcode
+
+The policy cases run a single transfer once polled and once interrupt driven and report
+the CPU cycles each engine takes. The crossover line names the smallest payload for which
+the interrupt engine is cheaper in the model. The model charges no cycles for C code, so the
+per-transfer overhead SPI_POLL_START_CYCLES in <spi_config.h> is an estimate for the target and
+not taken from these lines. SPI_POLL_BYTE_CYCLES follows them: at a byte time up to it the
+crossover finds no size for which the interrupt engine is cheaper:
+
+@code
+    policy div=16 size=16 poll_cycles=2088 irq_latency=2630 irq_cpu=1112
+    crossover div=16 byte_cycles=128 size=1
+@endcode
+
+The transaction cases send one AT45DB style read of four segments and check that the
+chip select was asserted once and the data phase came back intact:
+
+@code
+    transaction bus=spi engine=irq div=16 segments=4 bytes=72 cycles=11705 cs_asserts=1 isr_cycles_per_byte=70 ok
+@endcode
+
+The budget cases report the modelled interrupt cost of a byte in the middle of a segment for
+every segment kind next to SPI_ISR_BYTE_BUDGET in <spi_bus.h>. The model is the hand count in
+<spi.c> replayed through SPI_CYCLES() plus the register accesses, not the code avr-gcc emitted,
+so these lines can't notice a grown ISR. That takes counting the cycles in the avr-objdump -d
+listing of SPI_STC_vect. Built with -DSPI_FIXED_FILL=1 -DSPI_FILL_BYTE=0xA5, the fill byte of
+the bench devices, the receive and fill kinds take one cycle less:
+
+@code
+    budget kind=duplex model_cycles_per_byte=76 budget=80 ok
+    budget kind=fill model_cycles_per_byte=63 budget=80 ok
+@endcode
+
+The stream cases start an ADC model with a command byte and read it into two buffers until the
+watermark callback stops the stream after eight buffers:
+
+@code
+    stream div=16 length=64 buffers=8 bytes=544 cycles=88103 bytes_per_s=61745 isr_cycles_per_byte=68 ok
+@endcode
+
+The large cases send one full-duplex segment of one and of four 264 byte AT45DB pages:
+
+@code
+    large bus=spi div=16 length=1056 cycles=174155 bytes_per_s=60635 cs_asserts=1 isr_cycles_per_byte=75 ok
+@endcode
+
+The flash cases write sixteen pages to the AT45DB model in <at45db_sim.h>, once waiting for every
+page program and once overlapping it with the transfer of the next page into the other SRAM buffer,
+and read them back. The merge case writes a range that starts and ends inside a page:
+
+@code
+    flash div=2 pages=16 sequential_cycles=3505836 overlapped_cycles=3220672 bytes_per_s=13115 speedup=1.08 ok
+    flash_merge div=16 address=200 length=600 transfers=2 programs=8 status_reads=4252 ok
+@endcode
+
+The cache case runs small reads and writes against three hot pages, once straight to the flash and
+once through the page cache of <at45db_cache.h>, and compares the bytes on the bus:
+
+@code
+    cache div=16 frames=4 pages=3 accesses=256 hits=260 misses=3 write_backs=3 bus_bytes=4780 uncached_bus_bytes=170876 cycles=779911 uncached_cycles=27858086 ok
+@endcode
+
+The batch cases send a burst of short writes once through spi_transfer() in a loop and once through
+spi_submit_batch(), both with polling disabled. The caller spends BENCH_BATCH_WORK cycles preparing
+each write. They report the cycles spent inside the submission calls, the critical sections entered,
+the cycles the chip select stayed released between two writes and the cycles until the last byte was
+sent. They also check that a batch one transaction larger than a queue level is rejected as a whole:
+
+@code
+    batch div=2 transactions=8 size=3 work=64 loop_submit_cycles=18 batch_submit_cycles=4 loop_sections=8 batch_sections=1 loop_gap_cycles=140 batch_gap_cycles=0 loop_cycles=1965 batch_cycles=1965 ok
+    batch div=16 transactions=8 size=3 work=64 loop_submit_cycles=4 batch_submit_cycles=4 loop_sections=8 batch_sections=1 loop_gap_cycles=0 batch_gap_cycles=0 loop_cycles=3975 batch_cycles=4355 ok
+@endcode
+
+The C code of a submission costs no cycles in the model, so the submit cycles only hold register
+accesses. The caller's overhead shows in the critical sections, one per write in the loop and one for
+the batch. At DIV2 a write is shorter than its preparation, so the loop leaves the bus idle between
+the writes and the batch doesn't. At DIV16 the bus is the slower side and never idles in either arm,
+and the loop finishes first because it overlaps the preparation with the transfers.
+
+The queue cases keep the queue of an interrupt driven bus full while the interrupt drains it and
+check that every transaction completes once and in order, with no critical section besides the
+one of each completion handle:
+
+@code
+    queue div=16 transactions=64 capacity=8 bytes=544 completed=64 critical_sections=64 ok
+@endcode
+
+The error case logs two errors more than the error log of <spi_error_handler.h> holds and reads the
+log back. Built with -DSPI_ERROR_LED=1 it also steps one LED sequence with spi_error_tick():
+
+@code
+    errors logged=10 read=8 lost=2 cycles=0 led_toggles=12 led_ticks=1501 ok
+@endcode
+
+The static cases attach a device of SPI_DEVICE() from <spi_static.h> next to one of spi_create_device()
+with the same settings, check that the folded register values and poll limit match and time one write on each:
+
+@code
+    static div=2 size=16 ctrl=0xdc rate=1 poll_max_bytes=80 cycles=296 runtime_cycles=296 ok
+@endcode
+
+Built with -DSPI_SOFT=1 the soft cases write on the bit-banged bus of <spi_soft.c> in every mode and
+both bit orders to a slave that returns each byte one byte later, once at full speed and once stretched
+to 400 kHz and 100 kHz. The SCK frequency is the one the simulated pins saw at F_CPU:
+
+@code
+    soft mode=0 order=msb max_frequency=4294967295 size=64 delay=0 cycles=6146 cycles_per_byte=96 bytes_per_s=104132 sck_hz=833062 ok
+@endcode
+
+Built with -DSPI_STATS=1 the stats case fills a queue level, lets the bus idle and checks the snapshot
+of spi_get_stats() against the simulated peripheral. Times are ticks of TCNT1 at F_CPU / 8:
+
+@code
+    stats div=16 transactions=8 bytes=128 queue_peak=7 busy_ticks=2628 idle_ticks=5003 max_latency_ticks=2300 ok
+@endcode
+
+The sleep case, built with -DSPI_STATS=1 as well, waits for a queue of writes with spi_wait_idle(). Plain C costs no cycles in the
+simulation, so the wait is awake for no time and sleeps through all of it, including the interrupts:
+
+@code
+    sleep div=16 transactions=8 sleeps=128 slept_ticks=2630 awake_ticks=0 isr_ticks=1109 ok
+@endcode
+
+Built with -DSPI_TRACE=1 the trace case records an interrupt driven transaction of three segments and
+a submission without a device, checks the dumped frame of <spi_trace.h> event by event and sends a
+second run with spi_trace_report(). Piping the bench into <sim/spi_trace_decode.c> prints its timeline:
+
+@code
+    trace div=16 events=8 frame_bytes=46 cs_ticks=322 ok
+    [spi trace]: 535401080000a81d000001a81d010000
+@endcode
+
+Built with -DSPI_MSPIM_USART1=1 the throughput and transaction cases are repeated on USART1 in
+master SPI mode, the transaction once per engine. The dual cases split bulk writes between the
+SPI and USART1 and compare the aggregate bandwidth against the SPI alone:
+
+@code
+    dual div=16 size=64 spi_bytes_per_s=60654 spi_usart1_bytes_per_s=118133
+@endcode
+
+Built with -DSPI_BUFFERED=1 the throughput and transaction cases are repeated on the buffered
+SPI of the AVR Dx series. The transmit buffer keeps the shifter fed, so the bus is busy for all
+but the chip select gaps at every clock rate the interrupt keeps up with:
+
+@code
+    bench bus=buffered div=16 size=64 transfers=32 bytes=2048 cycles=263183 bytes_per_s=77816 isr_cycles_per_byte=49 isr_ns_per_byte=143 cs_gap_cycles=6 bus_util=99% pool_hwm=4
+@endcode
+
+The priority cases queue a short transfer behind a backlog of bulk writes, once as PRIORITY_LOW
+and once as PRIORITY_HIGH, and report its latency and completion position. The aging case checks
+that a PRIORITY_LOW transfer is passed over at most SPI_QUEUE_AGING times:
+
+@code
+    priority div=16 urgent=high backlog=7 latency=11194 position=2
+    aging div=16 limit=4 position=6 ok
+@endcode
+
+@note Build from the repository root, with -DSPI_LENGTH_BITS=8 leave out sim/at45db_sim.c, at45db.c and at45db_cache.c:
+@code
+    gcc -std=c99 -O2 -Isim -I. sim/spi_sim.c sim/at45db_sim.c sim/bench_spi.c spi.c spi_mspim.c spi_payload.c spi_queue.c spi_completion.c spi_error_handler.c spi_trace.c spi_soft.c spi_buffered.c at45db.c at45db_cache.c -o bench_spi
+    gcc -std=c99 -O2 -Isim -I. -DSPI_MSPIM_USART1=1 sim/spi_sim.c sim/at45db_sim.c sim/bench_spi.c spi.c spi_mspim.c spi_payload.c spi_queue.c spi_completion.c spi_error_handler.c spi_trace.c spi_soft.c spi_buffered.c at45db.c at45db_cache.c -o bench_spi
+    gcc -std=c99 -O2 -I. sim/spi_trace_decode.c -o spi_trace_decode
+@endcode
+*/
+#include <avr/interrupt.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "spi.h"
+#include "spi_bus.h"
+#include "spi_sim.h"
+
+#if SPI_LENGTH_BITS > 8
+#include "at45db_sim.h"
+#include "at45db_cache.h"
+#endif
+
+#define BENCH_TRANSFERS 32
+#define BENCH_BURST     4
+#define BENCH_CS        PORTB4
+#define BENCH_CS_USART  PORTC0
+#define BENCH_CS_ADC    PORTB3
+#define BENCH_CS_FLASH  PORTB2
+#define BENCH_CS_SOFT   PORTC1
+#define BENCH_CS_BUFFERED PORTC2
+#define BENCH_SOFT_PORT SIM_PORTA       // Port of the default SPI_SOFT_* pins
+#define BENCH_ADC_START 0x5A
+#define BENCH_FILL      0xA5
+
+#define BENCH_STREAM_BUFFERS    8
+#define BENCH_FLASH_PAGES       16
+#define BENCH_BATCH             SPI_QUEUE_SIZE
+#define BENCH_BATCH_WORK        64      // Caller cycles to prepare one write of the batch cases
+#define BENCH_QUEUE_TRANSACTIONS 64
+#define BENCH_CACHE_PAGES       3
+#define BENCH_CACHE_ACCESSES    256
+#define BENCH_STATS_SIZE        16
+#define BENCH_STATS_IDLE        40000
+
+#ifndef ARRAY_LEN
+# define ARRAY_LEN(a) (sizeof(a) / sizeof((a)[0]))
+#endif
+
+typedef struct {
+    clock_rate_t rate;
+    uint8_t div;
+} divider_t;
+
+static const divider_t dividers[] = {
+    { SPI_CLOCK_DIV2,   2   },
+    { SPI_CLOCK_DIV4,   4   },
+    { SPI_CLOCK_DIV8,   8   },
+    { SPI_CLOCK_DIV16,  16  },
+    { SPI_CLOCK_DIV32,  32  },
+    { SPI_CLOCK_DIV64,  64  },
+    { SPI_CLOCK_DIV128, 128 }
+};
+
+static const uint8_t sizes[] = { 1, 4, 16, 64, 255 };
+
+static uint8_t tx[255];
+
+/* Slave model: echoes the previous MOSI byte, ctx holds the last byte */
+static uint8_t echo(void* ctx, uint8_t mosi) {
+    uint8_t* last = ctx;
+    uint8_t miso = *last;
+    *last = mosi;
+    return miso;
+}
+
+static uint8_t echo_spi;
+static uint8_t echo_usart;
+static uint8_t echo_buffered;
+
+/* Device on the native SPI, on USART1 in master SPI mode or on the buffered SPI with the same clock rate */
+static device_t* bench_device(spi_bus_id_t bus, spi_config_t* config) {
+
+    if (bus == SPI_BUS_SPI) {
+        spi_sim_attach(SIM_PORTB, BENCH_CS, echo, NULL, &echo_spi);
+        return spi_create_device(&PORTB, BENCH_CS, NULL);
+    }
+
+    spi_device_config_t device_config = {
+        .bus = bus,
+        .data_order = config->data_order,
+        .mode = config->mode,
+        .max_frequency = 0,
+        .fill_byte = config->fill_byte
+    };
+
+    if (spi_bus_init(bus, config) != SPI_NO_ERROR) return NULL;
+
+    if (bus == SPI_BUS_BUFFERED) {
+        spi_sim_attach_buffered(SIM_PORTC, BENCH_CS_BUFFERED, echo, NULL, &echo_buffered);
+        return spi_create_device(&PORTC, BENCH_CS_BUFFERED, &device_config);
+    }
+
+    spi_sim_attach_usart(1, SIM_PORTC, BENCH_CS_USART, echo, NULL, &echo_usart);
+
+    return spi_create_device(&PORTC, BENCH_CS_USART, &device_config);
+}
+
+static spi_config_t config;
+
+static const char* bench_bus_name(spi_bus_id_t bus) {
+    if (bus == SPI_BUS_BUFFERED) return "buffered";
+
+    return bus == SPI_BUS_SPI ? "spi" : "usart1";
+}
+
+static device_t* bench_setup(clock_rate_t rate, uint32_t poll_threshold, spi_bus_id_t bus) {
+
+    config.data_order = SPI_MSB;
+    config.mode = SPI_MODE3;
+    config.clockrate = rate;
+    config.poll_threshold = poll_threshold;
+    config.fill_byte = BENCH_FILL;
+
+    spi_sim_reset();
+    spi_init(&config);
+    sei();
+
+    device_t* device = bench_device(bus, &config);
+
+    spi_sim_stats_reset();
+
+    return device;
+}
+
+static uint64_t done_at;
+
+static void bench_done(void* ctx, spi_error_t status) {
+    (void)ctx;
+    (void)status;
+    done_at = spi_sim_stats()->cycles;
+}
+
+/* Back-to-back transfers with the default polled/interrupt policy */
+static void bench_throughput(const divider_t* div, uint8_t size, spi_bus_id_t bus) {
+
+    device_t* device = bench_setup(div->rate, SPI_POLL_THRESHOLD, bus);
+
+    for (uint16_t i = 0; i < BENCH_TRANSFERS; i++) {
+
+        payload_t* payload = payload_create_spi(PRIORITY_LOW, device, tx, size, NULL);
+        spi_error_t status = SPI_NO_ERROR;
+
+        /* Errors at submission complete the handle right away */
+        if (payload == NULL || (spi_poll(spi_write(payload), &status) && status != SPI_NO_ERROR)) {
+            printf("bench bus=%s div=%u size=%u error\n", bench_bus_name(bus), div->div, size);
+            spi_free_device(device);
+            return;
+        }
+
+        if ((i % BENCH_BURST) == BENCH_BURST - 1) spi_sim_run_until_idle();
+    }
+
+    spi_sim_run_until_idle();
+
+    const spi_sim_stats_t* s = spi_sim_stats();
+    uint64_t elapsed = s->last_done - s->first_start;
+    spi_pool_stats_t pool;
+
+    spi_payload_pool_stats(&pool);
+
+    if (pool.in_use != 0) {
+        printf("bench bus=%s div=%u size=%u error=pool_leak in_use=%u\n", bench_bus_name(bus), div->div, size, pool.in_use);
+        spi_free_device(device);
+        return;
+    }
+
+    printf("bench bus=%s div=%u size=%u transfers=%u bytes=%lu cycles=%llu bytes_per_s=%llu isr_cycles_per_byte=%llu isr_ns_per_byte=%llu cs_gap_cycles=%llu bus_util=%llu%% pool_hwm=%u\n",
+        bench_bus_name(bus), div->div, size, BENCH_TRANSFERS, (unsigned long)s->bytes,
+        (unsigned long long)elapsed,
+        (unsigned long long)(elapsed ? (uint64_t)s->bytes * F_CPU / elapsed : 0),
+        (unsigned long long)(s->bytes ? s->isr_cycles / s->bytes : 0),
+        (unsigned long long)(s->bytes ? s->isr_host_ns / s->bytes : 0),
+        (unsigned long long)(s->cs_gaps ? s->cs_gap_cycles / s->cs_gaps : 0),
+        (unsigned long long)(elapsed ? s->busy_cycles * 100 / elapsed : 0),
+        pool.high_watermark);
+
+    spi_free_device(device);
+}
+
+/* Devices of SPI_DEVICE() with the settings bench_setup() gives the bus, by dividers[] */
+static device_t static_devices[] = {
+    SPI_DEVICE(B, BENCH_CS, SPI_MSB, SPI_MODE3, 2, BENCH_FILL),
+    SPI_DEVICE(B, BENCH_CS, SPI_MSB, SPI_MODE3, 4, BENCH_FILL),
+    SPI_DEVICE(B, BENCH_CS, SPI_MSB, SPI_MODE3, 8, BENCH_FILL),
+    SPI_DEVICE(B, BENCH_CS, SPI_MSB, SPI_MODE3, 16, BENCH_FILL),
+    SPI_DEVICE(B, BENCH_CS, SPI_MSB, SPI_MODE3, 32, BENCH_FILL),
+    SPI_DEVICE(B, BENCH_CS, SPI_MSB, SPI_MODE3, 64, BENCH_FILL),
+    SPI_DEVICE(B, BENCH_CS, SPI_MSB, SPI_MODE3, 128, BENCH_FILL)
+};
+
+/* One write with the default policy, returns the cycles until the bus is idle again */
+static uint64_t bench_static_write(device_t* device, uint8_t size) {
+
+    uint64_t start = spi_sim_stats()->cycles;
+
+    spi_write(payload_create_spi(PRIORITY_LOW, device, tx, size, NULL));
+    spi_sim_run_until_idle();
+
+    return spi_sim_stats()->cycles - start;
+}
+
+/*
+ * Checks that the register values SPI_DEVICE() folds at compile time are the ones spi_create_device()
+ * resolves at runtime, and that both devices clock the same write in the same time.
+ */
+static void bench_static(uint8_t d, uint8_t size) {
+
+    const divider_t* div = &dividers[d];
+    device_t* device = bench_setup(div->rate, SPI_POLL_THRESHOLD, SPI_BUS_SPI);
+    device_t* folded = &static_devices[d];
+    uint8_t ok = spi_add_device(folded) == SPI_NO_ERROR;
+
+    ok &= folded->ctrl == device->ctrl && folded->rate == device->rate && folded->fill == device->fill;
+    ok &= folded->poll_max_bytes == device->poll_max_bytes;
+
+    uint64_t runtime_cycles = bench_static_write(device, size);
+    uint64_t cycles = bench_static_write(folded, size);
+
+    ok &= cycles == runtime_cycles && spi_sim_stats()->bytes == 2UL * size;
+
+    printf("static div=%u size=%u ctrl=0x%02x rate=%u poll_max_bytes=%u cycles=%llu runtime_cycles=%llu %s\n",
+        div->div, size, folded->ctrl, folded->rate, folded->poll_max_bytes,
+        (unsigned long long)cycles, (unsigned long long)runtime_cycles, ok ? "ok" : "error");
+
+    spi_free_device(folded);
+    spi_free_device(device);
+}
+
+/* Single transfer from submission to completion. Returns the CPU cycles spent in the driver. */
+static uint64_t bench_single(const divider_t* div, uint8_t size, uint32_t poll_threshold, uint64_t* latency) {
+
+    device_t* device = bench_setup(div->rate, poll_threshold, SPI_BUS_SPI);
+    payload_t* payload = payload_create_spi(PRIORITY_LOW, device, tx, size, &bench_done);
+
+    uint64_t start = spi_sim_stats()->cycles;
+    uint64_t isr = spi_sim_stats()->isr_cycles;
+
+    spi_write(payload);
+
+    uint64_t returned = spi_sim_stats()->cycles;
+
+    spi_sim_run_until_idle();
+
+    *latency = done_at - start;
+
+    spi_free_device(device);
+
+    return (returned - start) + (spi_sim_stats()->isr_cycles - isr);
+}
+
+static void bench_transaction_done(void* ctx, spi_error_t status) {
+    if (status == SPI_NO_ERROR) (*(uint8_t*)ctx)++;
+}
+
+/*
+ * AT45DB style read as one transaction: opcode and address, dummy bytes, a full-duplex and a
+ * receive-only data phase. The chip select has to be asserted exactly once, the callback has to
+ * see its ctx and the handle has to complete with SPI_NO_ERROR.
+ */
+static void bench_transaction(const divider_t* div, spi_bus_id_t bus, uint32_t poll_threshold) {
+    
+    static uint8_t rx[64];
+    
+    uint8_t callbacks = 0;
+    
+    memset(rx, 0, sizeof(rx));
+    
+    const spi_segment_t segments[] = {
+        SPI_TX(tx, 4),
+        SPI_FILL(4),
+        SPI_DUPLEX(tx, rx, sizeof(rx) / 2),
+        SPI_RX(rx + sizeof(rx) / 2, sizeof(rx) / 2)
+    };
+    
+    spi_transaction_t transaction = {
+        .device = bench_setup(div->rate, poll_threshold, bus),
+        .segments = segments,
+        .nr_segments = ARRAY_LEN(segments),
+        .priority = PRIORITY_LOW,
+        .callback = bench_transaction_done,
+        .ctx = &callbacks
+    };
+    
+    spi_error_t status;
+    spi_handle_t handle = spi_transfer(&transaction);
+    
+    /* Polled transactions are complete on return, interrupt driven ones are still pending */
+    uint8_t ok = spi_poll(handle, &status) == (poll_threshold != 0);
+    
+    ok &= spi_wait(handle) == SPI_NO_ERROR && callbacks == 1;
+    
+    const spi_sim_stats_t* s = spi_sim_stats();
+    ok &= s->cs_asserts == 1 && rx[0] == BENCH_FILL && rx[sizeof(rx) / 2] == tx[sizeof(rx) / 2 - 1];
+    
+    /* The echo slave returns the previous byte, which is the fill byte during the receive-only phase */
+    for (uint8_t i = 1; i < sizeof(rx); i++) {
+        if (i < sizeof(rx) / 2 && rx[i] != tx[i - 1]) ok = 0;
+        if (i > sizeof(rx) / 2 && rx[i] != BENCH_FILL) ok = 0;
+    }
+    
+    printf("transaction bus=%s engine=%s div=%u segments=%u bytes=%lu cycles=%llu cs_asserts=%lu isr_cycles_per_byte=%llu %s\n",
+        bench_bus_name(bus), s->isr_count ? "irq" : "poll", div->div, (unsigned)ARRAY_LEN(segments), (unsigned long)s->bytes,
+        (unsigned long long)(s->last_done - s->first_start), (unsigned long)s->cs_asserts,
+        (unsigned long long)(s->bytes ? s->isr_cycles / s->bytes : 0),
+        ok ? "ok" : "error");
+    
+    spi_free_device(transaction.device);
+}
+
+static uint8_t completed;
+static uint8_t urgent_position;
+
+static void bench_bulk_done(void* ctx, spi_error_t status) {
+    (void)ctx;
+    (void)status;
+    completed++;
+}
+
+static void bench_urgent_done(void* ctx, spi_error_t status) {
+    (void)ctx;
+    (void)status;
+    done_at = spi_sim_stats()->cycles;
+    urgent_position = ++completed;
+}
+
+/*
+ * Short urgent transfer submitted behind a backlog of bulk writes. Reports the cycles until it
+ * completes and how many transfers finished before it, once for each priority of the urgent one.
+ */
+static void bench_priority(const divider_t* div, priority_t priority) {
+    
+    device_t* device = bench_setup(div->rate, 0, SPI_BUS_SPI);
+    
+    completed = 0;
+    
+    for (uint8_t i = 0; i < SPI_PAYLOAD_POOL_SIZE - 1; i++) {
+        spi_write(payload_create_spi(PRIORITY_LOW, device, tx, 64, &bench_bulk_done));
+    }
+    
+    uint64_t start = spi_sim_stats()->cycles;
+    
+    spi_write(payload_create_spi(priority, device, tx, 4, &bench_urgent_done));
+    
+    spi_sim_run_until_idle();
+    
+    printf("priority div=%u urgent=%s backlog=%u latency=%llu position=%u\n",
+        div->div, priority == PRIORITY_HIGH ? "high" : "low", SPI_PAYLOAD_POOL_SIZE - 1,
+        (unsigned long long)(done_at - start), urgent_position);
+    
+    spi_free_device(device);
+}
+
+/* Measurements of one arm of the batch cases */
+typedef struct {
+    uint64_t submit;            // cycles inside spi_transfer() or spi_submit_batch(), interrupts excluded
+    uint32_t sections;          // critical sections entered until the submission returned
+    uint64_t gaps;              // cycles the chip select stayed released between the writes
+    uint64_t total;             // cycles from the first work until the last byte
+} bench_batch_arm_t;
+
+/*
+ * A burst of short register writes, as a sensor setup or a display refresh sends them, once
+ * submitted one by one with spi_transfer() and once as a single batch, both interrupt driven
+ * so the arms only differ in the submission. The caller spends BENCH_BATCH_WORK cycles on
+ * every write before it is submitted, in the loop between the submissions, for the batch
+ * before it. Reports the cycles the caller spent inside the submission calls without the
+ * interrupts that hit them, the critical sections it took, the cycles the bus idled between
+ * the writes and the cycles from the first work until the last write left the bus.
+ */
+static void bench_batch_run(const divider_t* div, uint8_t size, uint8_t batched, bench_batch_arm_t* arm, uint8_t* ok) {
+
+    static spi_segment_t segments[BENCH_BATCH];
+    static spi_transaction_t transactions[BENCH_BATCH];
+    static spi_transaction_t* list[BENCH_BATCH];
+
+    spi_handle_t handles[BENCH_BATCH];
+    device_t* device = bench_setup(div->rate, 0, SPI_BUS_SPI);
+
+    uint64_t start = spi_sim_stats()->cycles;
+    uint64_t submit = 0;
+
+    for (uint8_t i = 0; i < BENCH_BATCH; i++) {
+
+        spi_sim_cycles(BENCH_BATCH_WORK);
+
+        segments[i] = (spi_segment_t)SPI_TX(&tx[i * size], size);
+        transactions[i] = (spi_transaction_t){ .device = device, .segments = &segments[i], .nr_segments = 1, .priority = PRIORITY_MEDIUM };
+        list[i] = &transactions[i];
+
+        if (!batched) {
+            uint64_t call = spi_sim_stats()->cycles - spi_sim_stats()->isr_cycles;
+            handles[i] = spi_transfer(list[i]);
+            submit += spi_sim_stats()->cycles - spi_sim_stats()->isr_cycles - call;
+        }
+    }
+
+    if (batched) {
+        uint64_t call = spi_sim_stats()->cycles - spi_sim_stats()->isr_cycles;
+        *ok &= spi_submit_batch(list, BENCH_BATCH, handles) == SPI_NO_ERROR;
+        submit += spi_sim_stats()->cycles - spi_sim_stats()->isr_cycles - call;
+    }
+
+    arm->submit = submit;
+    arm->sections = spi_sim_stats()->critical_sections;
+
+    for (uint8_t i = 0; i < BENCH_BATCH; i++) *ok &= spi_wait(handles[i]) == SPI_NO_ERROR;
+
+    arm->gaps = spi_sim_stats()->cs_gap_cycles;
+    arm->total = spi_sim_stats()->last_done - start;
+    *ok &= spi_sim_stats()->bytes == (uint32_t)BENCH_BATCH * size && spi_sim_stats()->cs_asserts == BENCH_BATCH;
+
+    spi_free_device(device);
+}
+
+static void bench_batch_rejected(void* ctx, spi_error_t status) {
+    if (status == SPI_ERR_BUFFER_OVERFLOW) (*(uint8_t*)ctx)++;
+}
+
+/* One transaction more than a queue level holds: nothing may be queued and every transaction completes with the overflow */
+static uint8_t bench_batch_overflow(const divider_t* div) {
+
+    static spi_segment_t segment = SPI_TX(tx, 4);
+    static spi_transaction_t transactions[BENCH_BATCH + 1];
+    static spi_transaction_t* list[BENCH_BATCH + 1];
+
+    device_t* device = bench_setup(div->rate, 0, SPI_BUS_SPI);
+    uint8_t rejected = 0;
+    uint8_t ok = 1;
+
+    for (uint8_t i = 0; i < BENCH_BATCH + 1; i++) {
+        transactions[i] = (spi_transaction_t){ .device = device, .segments = &segment, .nr_segments = 1, .priority = PRIORITY_MEDIUM,
+            .callback = bench_batch_rejected, .ctx = &rejected };
+        list[i] = &transactions[i];
+    }
+
+    ok &= spi_submit_batch(list, BENCH_BATCH + 1, NULL) == SPI_ERR_BUFFER_OVERFLOW;
+    ok &= rejected == BENCH_BATCH + 1;
+
+    ok &= spi_queue_empty(&device->bus->queue) && spi_sim_stats()->bytes == 0;
+
+    spi_free_device(device);
+
+    return ok;
+}
+
+static void bench_batch(const divider_t* div, uint8_t size) {
+
+    uint8_t ok = 1;
+    bench_batch_arm_t loop, batch;
+
+    bench_batch_run(div, size, 0, &loop, &ok);
+    bench_batch_run(div, size, 1, &batch, &ok);
+
+    ok &= bench_batch_overflow(div);
+
+    printf("batch div=%u transactions=%u size=%u work=%u loop_submit_cycles=%llu batch_submit_cycles=%llu loop_sections=%lu batch_sections=%lu loop_gap_cycles=%llu batch_gap_cycles=%llu loop_cycles=%llu batch_cycles=%llu %s\n",
+        div->div, BENCH_BATCH, size, BENCH_BATCH_WORK, (unsigned long long)loop.submit, (unsigned long long)batch.submit,
+        (unsigned long)loop.sections, (unsigned long)batch.sections, (unsigned long long)loop.gaps, (unsigned long long)batch.gaps,
+        (unsigned long long)loop.total, (unsigned long long)batch.total, ok ? "ok" : "error");
+}
+
+typedef struct {
+    uint8_t order[BENCH_QUEUE_TRANSACTIONS];
+    uint8_t done;
+} bench_queue_t;
+
+static bench_queue_t queue_log;
+
+static void bench_queue_done(void* ctx, spi_error_t status) {
+    if (status == SPI_NO_ERROR) queue_log.order[queue_log.done++] = (uint8_t)(uintptr_t)ctx;
+}
+
+/*
+ * Keeps the queue of an interrupt driven bus full while the interrupt drains it, so every
+ * submission races with a dequeue. Every transaction has to complete once and in submission
+ * order, and only the completion handles may take a critical section.
+ */
+static void bench_queue(const divider_t* div) {
+
+    static spi_segment_t segments[BENCH_QUEUE_TRANSACTIONS];
+    static spi_transaction_t transactions[BENCH_QUEUE_TRANSACTIONS];
+
+    device_t* device = bench_setup(div->rate, 0, SPI_BUS_SPI);
+    uint32_t bytes = 0;
+    uint8_t ok = 1;
+
+    memset(&queue_log, 0, sizeof(queue_log));
+
+    for (uint8_t i = 0; i < BENCH_QUEUE_TRANSACTIONS; i++) {
+
+        spi_length_t length = 1 + (i * 7) % 16;
+
+        segments[i] = (spi_segment_t)SPI_TX(tx, length);
+        transactions[i] = (spi_transaction_t){ .device = device, .segments = &segments[i], .nr_segments = 1,
+            .priority = PRIORITY_LOW, .callback = bench_queue_done, .ctx = (void*)(uintptr_t)i };
+        bytes += length;
+
+        /* Waits for a free entry and a free completion handle in idle sleep, like a producer that outruns the bus */
+        while (spi_queue_space(&device->bus->queue, &transactions[i]) == 0 || i - queue_log.done >= SPI_HANDLES) spi_sim_sleep();
+
+        spi_transfer(&transactions[i]);
+    }
+
+    spi_sim_run_until_idle();
+
+    const spi_sim_stats_t* s = spi_sim_stats();
+
+    ok &= queue_log.done == BENCH_QUEUE_TRANSACTIONS && s->bytes == bytes;
+#if !SPI_TRACE
+    /* Recording a trace event takes a critical section of its own */
+    ok &= s->critical_sections == BENCH_QUEUE_TRANSACTIONS;
+#endif
+
+    for (uint8_t i = 0; i < queue_log.done; i++) {
+        if (queue_log.order[i] != i) ok = 0;
+    }
+
+    printf("queue div=%u transactions=%u capacity=%u bytes=%lu completed=%u critical_sections=%lu %s\n",
+        div->div, BENCH_QUEUE_TRANSACTIONS, SPI_QUEUE_SIZE, (unsigned long)s->bytes, queue_log.done,
+        (unsigned long)s->critical_sections, ok ? "ok" : "error");
+
+    spi_free_device(device);
+}
+
+#if SPI_ERROR_LED
+#include "led_lib.h"
+
+/*
+ * Shows one error on the LED and counts the toggles and ticks until the sequence is over:
+ * three pulses twice, each followed by a second off, and a four second pause per repetition.
+ */
+static uint8_t bench_error_led(uint32_t* toggles, uint32_t* ticks) {
+
+    const uint32_t second = 1000 / SPI_ERROR_TICK_MS;
+
+    /* Lets the sequences of earlier errors run out */
+    for (uint32_t i = 0; i < 200 * second; i++) spi_error_tick();
+
+    uint8_t leds = sim_leds;
+
+    *toggles = 0;
+    *ticks = 0;
+
+    error_handler(SPI_ERR_BUFFER_OVERFLOW);
+
+    for (uint32_t i = 1; i <= 40 * second; i++) {
+        spi_error_tick();
+        if (sim_leds != leds) {
+            leds = sim_leds;
+            (*toggles)++;
+            *ticks = i;
+        }
+    }
+
+    /* The last toggle turns the LED off after the third pulse of the second repetition */
+    return *toggles == 12 && *ticks == 15 * second + 1 && sim_leds == 0;
+}
+#endif
+
+/*
+ * Logs more errors than the log holds. error_handler() must not take any time on the bus clock,
+ * the newest SPI_ERROR_LOG_SIZE entries have to come back in order and the rest counts as lost.
+ */
+static void bench_errors(void) {
+
+    spi_error_stats_t stats;
+    spi_error_entry_t entry;
+    uint8_t read = 0;
+    uint32_t last_tick = 0;
+    uint8_t ok = 1;
+
+    spi_error_report();
+    spi_error_clear();
+
+    uint64_t start = spi_sim_stats()->cycles;
+
+    for (uint8_t i = 0; i < SPI_ERROR_LOG_SIZE + 2; i++) {
+        ok &= error_handler(i & 1 ? SPI_ERR_BUFFER_OVERFLOW : SPI_ERR_RECV_BUSY) != SPI_NO_ERROR;
+        spi_error_tick();
+    }
+
+    uint64_t cycles = spi_sim_stats()->cycles - start;
+
+    spi_error_stats(&stats);
+
+    while (spi_error_log_read(&entry)) {
+        ok &= entry.tick >= last_tick && entry.error == ((read + 2) & 1 ? SPI_ERR_BUFFER_OVERFLOW : SPI_ERR_RECV_BUSY);
+        last_tick = entry.tick;
+        read++;
+    }
+
+    ok &= read == SPI_ERROR_LOG_SIZE && stats.lost == 2;
+    ok &= stats.count[SPI_ERR_BUFFER_OVERFLOW] + stats.count[SPI_ERR_RECV_BUSY] == SPI_ERROR_LOG_SIZE + 2;
+
+    printf("errors logged=%u read=%u lost=%u cycles=%llu", SPI_ERROR_LOG_SIZE + 2, read, stats.lost, (unsigned long long)cycles);
+
+#if SPI_ERROR_LED
+    uint32_t toggles, ticks;
+    ok &= bench_error_led(&toggles, &ticks);
+    printf(" led_toggles=%lu led_ticks=%lu", (unsigned long)toggles, (unsigned long)ticks);
+#endif
+
+    printf(" %s\n", ok ? "ok" : "error");
+}
+
+#if SPI_STATS
+/*
+ * Fills one queue level of an interrupt driven bus, lets the bus idle afterwards and compares the
+ * snapshot of spi_get_stats() against the simulated peripheral. The time base is TCNT1 of the
+ * simulation, F_CPU / 8.
+ */
+static void bench_stats(const divider_t* div) {
+
+    static spi_segment_t segments[SPI_QUEUE_SIZE];
+    static spi_transaction_t transactions[SPI_QUEUE_SIZE];
+
+    device_t* device = bench_setup(div->rate, 0, SPI_BUS_SPI);
+    spi_stats_t stats;
+    spi_device_stats_t device_stats;
+    uint8_t ok = 1;
+
+    spi_reset_stats();
+
+    for (uint8_t i = 0; i < SPI_QUEUE_SIZE; i++) {
+        segments[i] = (spi_segment_t)SPI_TX(tx, BENCH_STATS_SIZE);
+        transactions[i] = (spi_transaction_t){ .device = device, .segments = &segments[i], .nr_segments = 1,
+            .priority = PRIORITY_LOW, .callback = NULL, .ctx = NULL };
+        spi_transfer(&transactions[i]);
+    }
+
+    spi_sim_run_until_idle();
+    spi_sim_run(BENCH_STATS_IDLE);
+
+    spi_get_stats(&stats);
+    spi_get_device_stats(device, &device_stats);
+
+    const spi_sim_stats_t* s = spi_sim_stats();
+    const spi_bus_stats_t* bus = &stats.bus[SPI_BUS_SPI];
+    uint32_t idle = bus->elapsed - bus->busy;
+
+    ok &= bus->cs_asserts == s->cs_asserts && bus->bytes == s->bytes;
+    ok &= device_stats.transactions == SPI_QUEUE_SIZE && device_stats.bytes == s->bytes;
+
+    /* The first transaction starts right away, the rest waits in the queue */
+    ok &= bus->queue_peak == SPI_QUEUE_SIZE - 1;
+
+    /* Busy from the first chip select to the last release, the idle cycles at the end are not */
+    ok &= bus->busy <= bus->elapsed && bus->busy * 8 + 8 >= s->busy_cycles && idle * 8 + 8 >= BENCH_STATS_IDLE;
+
+    /* The last transaction waited for all the others */
+    ok &= (uint32_t)bus->max_latency * 8 >= (SPI_QUEUE_SIZE - 1) * BENCH_STATS_SIZE * 8 * div->div;
+
+    printf("stats div=%u transactions=%lu bytes=%lu queue_peak=%u busy_ticks=%lu idle_ticks=%lu max_latency_ticks=%u",
+        div->div, (unsigned long)device_stats.transactions, (unsigned long)bus->bytes, bus->queue_peak,
+        (unsigned long)bus->busy, (unsigned long)idle, bus->max_latency);
+
+    spi_reset_stats();
+    spi_get_stats(&stats);
+
+    ok &= stats.bus[SPI_BUS_SPI].cs_asserts == 0 && stats.bus[SPI_BUS_SPI].elapsed == 0;
+
+    printf(" %s\n", ok ? "ok" : "error");
+
+    spi_free_device(device);
+}
+
+static uint8_t sleep_completed;
+
+static void bench_sleep_done(void* ctx, spi_error_t status) {
+    (void)ctx;
+    if (status == SPI_NO_ERROR) sleep_completed++;
+}
+
+/*
+ * Queues one level full of interrupt driven writes and waits for all of them with spi_wait_idle().
+ * The wait sleeps once per byte interrupt, its slept and awake ticks have to add up to the
+ * simulated time it took, and the slept ticks include the interrupts that woke it.
+ */
+static void bench_sleep(const divider_t* div) {
+
+    static spi_segment_t segments[SPI_QUEUE_SIZE];
+    static spi_transaction_t transactions[SPI_QUEUE_SIZE];
+
+    device_t* device = bench_setup(div->rate, 0, SPI_BUS_SPI);
+    spi_stats_t stats;
+    uint8_t ok = 1;
+
+    sleep_completed = 0;
+
+    for (uint8_t i = 0; i < SPI_QUEUE_SIZE; i++) {
+        segments[i] = (spi_segment_t)SPI_TX(tx, BENCH_STATS_SIZE);
+        transactions[i] = (spi_transaction_t){ .device = device, .segments = &segments[i], .nr_segments = 1,
+            .priority = PRIORITY_LOW, .callback = bench_sleep_done, .ctx = NULL };
+        spi_transfer(&transactions[i]);
+    }
+
+    spi_reset_stats();
+    spi_sim_stats_reset();
+
+    uint64_t start = spi_sim_now();
+
+    ok &= spi_wait_idle() == SPI_NO_ERROR;
+
+    uint64_t waited = spi_sim_now() - start;
+
+    spi_get_stats(&stats);
+
+    const spi_sim_stats_t* s = spi_sim_stats();
+    const spi_sleep_stats_t* sleep = &stats.sleep;
+
+    /* Every transaction completed before the wait returned */
+    ok &= sleep_completed == SPI_QUEUE_SIZE && s->bytes + BENCH_STATS_SIZE >= SPI_QUEUE_SIZE * BENCH_STATS_SIZE;
+
+    /* One sleep per byte interrupt, the time base is F_CPU / 8 */
+    ok &= sleep->waits == 1 && sleep->sleeps == s->isr_count;
+    ok &= (uint64_t)(sleep->slept + sleep->awake) * 8 + 16 >= waited && (uint64_t)(sleep->slept + sleep->awake) * 8 <= waited + 16;
+    ok &= (uint64_t)sleep->slept * 8 + 16 >= s->isr_cycles;
+
+    printf("sleep div=%u transactions=%u sleeps=%lu slept_ticks=%lu awake_ticks=%lu isr_ticks=%llu",
+        div->div, SPI_QUEUE_SIZE, (unsigned long)sleep->sleeps, (unsigned long)sleep->slept, (unsigned long)sleep->awake,
+        (unsigned long long)(s->isr_cycles / 8));
+
+    printf(" %s\n", ok ? "ok" : "error");
+
+    spi_free_device(device);
+}
+#endif
+
+#if SPI_TRACE
+typedef struct {
+    uint8_t bytes[6 + 5 * SPI_TRACE_SIZE];
+    uint16_t length;
+} bench_trace_t;
+
+static void bench_trace_put(void* ctx, uint8_t byte) {
+
+    bench_trace_t* dump = ctx;
+
+    if (dump->length < sizeof(dump->bytes)) dump->bytes[dump->length++] = byte;
+}
+
+/* One interrupt driven transaction of three segments and one submission without a device */
+static void bench_trace_run(const divider_t* div) {
+
+    static uint8_t rx[8];
+
+    const spi_segment_t segments[] = {
+        SPI_TX(tx, 4),
+        SPI_FILL(4),
+        SPI_RX(rx, sizeof(rx))
+    };
+
+    spi_transaction_t transaction = {
+        .device = bench_setup(div->rate, 0, SPI_BUS_SPI),
+        .segments = segments,
+        .nr_segments = ARRAY_LEN(segments),
+        .priority = PRIORITY_MEDIUM,
+        .callback = NULL,
+        .ctx = NULL
+    };
+
+    spi_trace_clear();
+
+    spi_wait(spi_transfer(&transaction));
+
+    device_t* device = transaction.device;
+
+    transaction.device = NULL;
+    spi_wait(spi_transfer(&transaction));
+
+    spi_free_device(device);
+}
+
+/*
+ * Records the events of bench_trace_run() and checks the dump against the expected order. The
+ * second run is sent over the UART shim, so piping the bench into <spi_trace_decode.c> shows it.
+ */
+static void bench_trace(const divider_t* div) {
+
+    static const uint8_t expected[][3] = {
+        { SPI_TRACE_SUBMIT,     0,                   PRIORITY_MEDIUM },
+        { SPI_TRACE_CS_ASSERT,  0,                   0 },
+        { SPI_TRACE_SEGMENT,    0,                   1 },
+        { SPI_TRACE_SEGMENT,    0,                   2 },
+        { SPI_TRACE_CS_RELEASE, 0,                   0 },
+        { SPI_TRACE_DONE,       0,                   SPI_NO_ERROR },
+        { SPI_TRACE_ERROR,      SPI_TRACE_NO_DEVICE, SPI_ERR_INVALID_PORT },
+        { SPI_TRACE_DONE,       SPI_TRACE_NO_DEVICE, SPI_ERR_INVALID_PORT }
+    };
+
+    static bench_trace_t dump;
+    uint8_t ok = 1;
+
+    bench_trace_run(div);
+
+    dump.length = 0;
+    spi_trace_dump(bench_trace_put, &dump);
+
+    ok &= dump.length == 6 + 5 * ARRAY_LEN(expected) && dump.bytes[0] == 'S' && dump.bytes[1] == 'T';
+    ok &= dump.bytes[3] == ARRAY_LEN(expected) && dump.bytes[4] == 0 && dump.bytes[5] == 0;
+
+    for (uint8_t i = 0; ok && i < ARRAY_LEN(expected); i++) {
+        ok &= memcmp(&dump.bytes[6 + 5 * i + 2], expected[i], 3) == 0;
+    }
+
+    /* Time between the chip select edges of the 16 data bytes, a ring smaller than the run lost them */
+    uint16_t assert = ok ? dump.bytes[6 + 5] | dump.bytes[6 + 5 + 1] << 8 : 0;
+    uint16_t release = ok ? dump.bytes[6 + 20] | dump.bytes[6 + 20 + 1] << 8 : 0;
+
+    printf("trace div=%u events=%u frame_bytes=%u cs_ticks=%u %s\n", div->div, dump.bytes[3], dump.length,
+        (uint16_t)(release - assert), ok ? "ok" : "error");
+
+    bench_trace_run(div);
+    spi_trace_report();
+}
+#endif
+
+/* A low priority transfer behind a flood of high priority ones has to complete within SPI_QUEUE_AGING + 1 */
+static void bench_aging(const divider_t* div) {
+    
+    device_t* device = bench_setup(div->rate, 0, SPI_BUS_SPI);
+    
+    completed = 0;
+    
+    spi_write(payload_create_spi(PRIORITY_HIGH, device, tx, 16, &bench_bulk_done));
+    spi_write(payload_create_spi(PRIORITY_LOW, device, tx, 4, &bench_urgent_done));
+    
+    for (uint8_t i = 0; i < SPI_PAYLOAD_POOL_SIZE - 2; i++) {
+        spi_write(payload_create_spi(PRIORITY_HIGH, device, tx, 16, &bench_bulk_done));
+    }
+    
+    spi_sim_run_until_idle();
+    
+    printf("aging div=%u limit=%u position=%u %s\n", div->div, SPI_QUEUE_AGING, urgent_position,
+        (SPI_QUEUE_AGING == 0 || urgent_position <= SPI_QUEUE_AGING + 2) ? "ok" : "error");
+    
+    spi_free_device(device);
+}
+
+#if SPI_LENGTH_BITS > 8
+/*
+ * A full-duplex segment longer than 255 bytes: one AT45DB page and four pages in a row.
+ * The chip select has to be asserted once and every chunk has to land in the right place.
+ */
+static void bench_large(const divider_t* div, spi_bus_id_t bus, spi_length_t length) {
+    
+    static uint8_t large_tx[1056];
+    static uint8_t large_rx[1056];
+    
+    for (spi_length_t i = 0; i < length; i++) {
+        large_tx[i] = (uint8_t)(i * 7 + 1);
+        large_rx[i] = 0;
+    }
+    
+    const spi_segment_t segment = SPI_DUPLEX(large_tx, large_rx, length);
+    
+    spi_transaction_t transaction = {
+        .device = bench_setup(div->rate, SPI_POLL_THRESHOLD, bus),
+        .segments = &segment,
+        .nr_segments = 1,
+        .priority = PRIORITY_LOW
+    };
+    
+    uint8_t ok = spi_wait(spi_transfer(&transaction)) == SPI_NO_ERROR;
+    
+    const spi_sim_stats_t* s = spi_sim_stats();
+    uint64_t elapsed = s->last_done - s->first_start;
+    
+    ok &= s->cs_asserts == 1 && s->bytes == length;
+    
+    /* The echo slave returns the previous byte */
+    for (spi_length_t i = 1; i < length; i++) {
+        if (large_rx[i] != large_tx[i - 1]) ok = 0;
+    }
+    
+    printf("large bus=%s div=%u length=%lu cycles=%llu bytes_per_s=%llu cs_asserts=%lu isr_cycles_per_byte=%llu %s\n",
+        bench_bus_name(bus), div->div, (unsigned long)length, (unsigned long long)elapsed,
+        (unsigned long long)(elapsed ? (uint64_t)s->bytes * F_CPU / elapsed : 0), (unsigned long)s->cs_asserts,
+        (unsigned long long)(s->bytes ? s->isr_cycles / s->bytes : 0), ok ? "ok" : "error");
+    
+    spi_free_device(transaction.device);
+}
+#endif
+
+#if SPI_LENGTH_BITS > 8
+static at45db_sim_t flash_sim;
+
+/* Attaches a freshly erased AT45DB model and initializes the driver for it */
+static uint8_t bench_flash_setup(const divider_t* div, at45db_t* flash) {
+
+    spi_free_device(bench_setup(div->rate, SPI_POLL_THRESHOLD, SPI_BUS_SPI));
+
+    at45db_sim_init(&flash_sim);
+    spi_sim_attach(SIM_PORTB, BENCH_CS_FLASH, at45db_sim_xfer, at45db_sim_release, &flash_sim);
+
+    return at45db_init(flash, spi_create_device(&PORTB, BENCH_CS_FLASH, NULL)) == SPI_NO_ERROR;
+}
+
+/*
+ * Writes BENCH_FLASH_PAGES pages and reads them back. Overlapped, the next page goes into the
+ * other SRAM buffer while the previous one programs, otherwise every program is waited for.
+ * Returns the cycles until the last program completed.
+ */
+static uint64_t bench_flash_pages(const divider_t* div, uint8_t overlapped, uint8_t* ok) {
+
+    static uint8_t pages[BENCH_FLASH_PAGES][AT45DB_PAGE_SIZE];
+    static uint8_t back[BENCH_FLASH_PAGES][AT45DB_PAGE_SIZE];
+
+    at45db_t flash;
+
+    for (uint16_t p = 0; p < BENCH_FLASH_PAGES; p++) {
+        for (uint16_t i = 0; i < AT45DB_PAGE_SIZE; i++) pages[p][i] = (uint8_t)(p * 31 + i);
+    }
+
+    *ok &= bench_flash_setup(div, &flash);
+
+    uint64_t start = spi_sim_stats()->cycles;
+
+    for (uint16_t p = 0; p < BENCH_FLASH_PAGES; p++) {
+        *ok &= at45db_write_page(&flash, p, pages[p]) == SPI_NO_ERROR;
+        if (!overlapped) *ok &= at45db_sync(&flash) == SPI_NO_ERROR;
+    }
+
+    *ok &= at45db_sync(&flash) == SPI_NO_ERROR;
+
+    uint64_t elapsed = spi_sim_stats()->cycles - start;
+
+    memset(back, 0, sizeof(back));
+
+    *ok &= at45db_read(&flash, 0, back[0], sizeof(back)) == SPI_NO_ERROR;
+    *ok &= memcmp(pages, back, sizeof(pages)) == 0;
+    *ok &= flash_sim.programs == BENCH_FLASH_PAGES && flash_sim.violations == 0;
+
+    spi_free_device(flash.device);
+
+    return elapsed;
+}
+
+static void bench_flash(const divider_t* div) {
+
+    uint8_t ok = 1;
+    uint64_t sequential = bench_flash_pages(div, 0, &ok);
+    uint64_t overlapped = bench_flash_pages(div, 1, &ok);
+    uint64_t bytes = (uint64_t)BENCH_FLASH_PAGES * AT45DB_PAGE_SIZE;
+
+    printf("flash div=%u pages=%u sequential_cycles=%llu overlapped_cycles=%llu bytes_per_s=%llu speedup=%llu.%02llu %s\n",
+        div->div, BENCH_FLASH_PAGES, (unsigned long long)sequential, (unsigned long long)overlapped,
+        (unsigned long long)(bytes * F_CPU / overlapped),
+        (unsigned long long)(sequential / overlapped), (unsigned long long)(sequential * 100 / overlapped % 100),
+        ok ? "ok" : "error");
+}
+
+/*
+ * A write that starts and ends inside a page: the partial pages are merged with their old
+ * content through a page to buffer transfer, the full pages in between are written directly.
+ */
+static void bench_flash_merge(const divider_t* div, uint32_t address, spi_length_t length) {
+
+    static uint8_t expected[4 * AT45DB_PAGE_SIZE];
+    static uint8_t data[4 * AT45DB_PAGE_SIZE];
+    static uint8_t back[4 * AT45DB_PAGE_SIZE];
+
+    at45db_t flash;
+    uint8_t ok = bench_flash_setup(div, &flash);
+
+    for (uint16_t i = 0; i < sizeof(expected); i++) {
+        expected[i] = (uint8_t)(i ^ 0x5A);
+        data[i] = (uint8_t)(i * 3);
+    }
+
+    for (uint16_t p = 0; p < 4; p++) {
+        ok &= at45db_write_page(&flash, p, &expected[p * AT45DB_PAGE_SIZE]) == SPI_NO_ERROR;
+    }
+
+    ok &= at45db_write(&flash, address, data, length) == SPI_NO_ERROR;
+    memcpy(&expected[address], data, length);
+
+    ok &= at45db_read(&flash, 0, back, sizeof(back)) == SPI_NO_ERROR;
+    ok &= memcmp(expected, back, sizeof(back)) == 0 && flash_sim.violations == 0;
+
+    printf("flash_merge div=%u address=%lu length=%lu transfers=%lu programs=%lu status_reads=%lu %s\n",
+        div->div, (unsigned long)address, (unsigned long)length, (unsigned long)flash_sim.transfers,
+        (unsigned long)flash_sim.programs, (unsigned long)flash_sim.status_reads, ok ? "ok" : "error");
+
+    spi_free_device(flash.device);
+}
+/*
+ * Small reads and writes to a few hot pages, as configuration and log index structures do, once
+ * straight to the flash and once through the page cache. The flash has to end up with the same
+ * content both times, the bytes on the bus show the traffic the cache saves.
+ */
+static uint64_t bench_cache_run(const divider_t* div, uint8_t cached, uint32_t* bus_bytes, uint8_t* ok) {
+
+    static at45db_cache_t cache;
+    static uint8_t mirror[BENCH_CACHE_PAGES * AT45DB_PAGE_SIZE];
+    static uint8_t back[BENCH_CACHE_PAGES * AT45DB_PAGE_SIZE];
+
+    const uint32_t base = 5 * (uint32_t)AT45DB_PAGE_SIZE;
+    uint32_t seed = 1;
+    at45db_t flash;
+
+    *ok &= bench_flash_setup(div, &flash);
+
+    at45db_cache_init(&cache, &flash);
+    memset(mirror, 0xFF, sizeof(mirror));
+
+    uint64_t start = spi_sim_stats()->cycles;
+    uint32_t start_bytes = spi_sim_stats()->bytes;
+
+    for (uint16_t n = 0; n < BENCH_CACHE_ACCESSES; n++) {
+
+        uint8_t data[16];
+
+        seed = seed * 1103515245 + 12345;
+
+        spi_length_t length = 1 + (seed >> 8) % sizeof(data);
+        uint32_t offset = (seed >> 12) % (sizeof(mirror) - length);
+
+        if (seed & 0x80000000) {
+            for (uint8_t i = 0; i < length; i++) data[i] = (uint8_t)(n + i);
+            memcpy(&mirror[offset], data, length);
+            if (cached) *ok &= at45db_cache_write(&cache, base + offset, data, length) == SPI_NO_ERROR;
+            else *ok &= at45db_write(&flash, base + offset, data, length) == SPI_NO_ERROR;
+        } else {
+            if (cached) *ok &= at45db_cache_read(&cache, base + offset, data, length) == SPI_NO_ERROR;
+            else *ok &= at45db_read(&flash, base + offset, data, length) == SPI_NO_ERROR;
+            *ok &= memcmp(data, &mirror[offset], length) == 0;
+        }
+    }
+
+    if (cached) *ok &= at45db_cache_sync(&cache) == SPI_NO_ERROR;
+    else *ok &= at45db_sync(&flash) == SPI_NO_ERROR;
+
+    uint64_t elapsed = spi_sim_stats()->cycles - start;
+
+    *bus_bytes = spi_sim_stats()->bytes - start_bytes;
+
+    *ok &= at45db_read(&flash, base, back, sizeof(back)) == SPI_NO_ERROR;
+    *ok &= memcmp(mirror, back, sizeof(back)) == 0 && flash_sim.violations == 0;
+
+    if (cached) {
+        at45db_cache_stats_t stats;
+        at45db_cache_stats(&cache, &stats);
+        *ok &= stats.dirty == 0 && stats.hits + stats.misses >= BENCH_CACHE_ACCESSES;
+        printf("cache div=%u frames=%u pages=%u accesses=%u hits=%lu misses=%lu write_backs=%lu ",
+            div->div, stats.frames, BENCH_CACHE_PAGES, BENCH_CACHE_ACCESSES, (unsigned long)stats.hits,
+            (unsigned long)stats.misses, (unsigned long)stats.write_backs);
+    }
+
+    spi_free_device(flash.device);
+
+    return elapsed;
+}
+
+static void bench_cache(const divider_t* div) {
+
+    uint8_t ok = 1;
+    uint32_t uncached_bytes, cached_bytes;
+    uint64_t uncached = bench_cache_run(div, 0, &uncached_bytes, &ok);
+    uint64_t cached = bench_cache_run(div, 1, &cached_bytes, &ok);
+
+    printf("bus_bytes=%lu uncached_bus_bytes=%lu cycles=%llu uncached_cycles=%llu %s\n",
+        (unsigned long)cached_bytes, (unsigned long)uncached_bytes, (unsigned long long)cached,
+        (unsigned long long)uncached, ok ? "ok" : "error");
+}
+#endif
+
+/* Slave model of an ADC: returns a running sample counter, the start command resets it */
+static uint8_t adc(void* ctx, uint8_t mosi) {
+    if (mosi == BENCH_ADC_START) *(uint8_t*)ctx = 0;
+    return (*(uint8_t*)ctx)++;
+}
+
+typedef struct {
+    spi_stream_t* stream;
+    uint8_t expected;       // Next sample value
+    uint8_t halves;
+    uint8_t fulls;
+    uint8_t ok;
+} bench_stream_t;
+
+/* Checks every half buffer for consecutive samples and stops the stream after BENCH_STREAM_BUFFERS buffers */
+static void bench_stream_watermark(void* ctx, uint8_t* buffer, spi_stream_event_t event) {
+    
+    bench_stream_t* bench = ctx;
+    spi_length_t first = bench->stream->length / 2;
+    spi_length_t from = (event == SPI_STREAM_HALF) ? 0 : first;
+    spi_length_t to = (event == SPI_STREAM_HALF) ? first : bench->stream->length;
+    
+    for (spi_length_t i = from; i < to; i++) {
+        if (buffer[i] != bench->expected++) bench->ok = 0;
+    }
+    
+    if (event == SPI_STREAM_HALF) bench->halves++;
+    else if (++bench->fulls == BENCH_STREAM_BUFFERS) spi_stream_stop(bench->stream);
+}
+
+/*
+ * Starts an ADC with a command byte and reads it continuously into two buffers. The chip select has to stay asserted, every sample
+ * has to arrive once and in order, and a write submitted while streaming has to follow the stop.
+ * The bytes per second are those of the stream alone.
+ */
+static void bench_stream(const divider_t* div, spi_length_t length) {
+    
+    static uint8_t buffer_a[255], buffer_b[255];
+    static uint8_t* const buffers[] = { buffer_a, buffer_b };
+    
+    static const uint8_t start[] = { BENCH_ADC_START };
+    static const spi_segment_t command[] = { SPI_TX(start, 1) };
+    
+    uint8_t sample = 0x80;
+    
+    /* The sample clocked with the command byte is discarded */
+    bench_stream_t bench = { .expected = 1, .ok = 1 };
+    
+    spi_stream_t stream = {
+        .buffers = buffers,
+        .nr_buffers = ARRAY_LEN(buffers),
+        .length = length,
+        .watermark = bench_stream_watermark
+    };
+    
+    device_t* device = bench_setup(div->rate, 0, SPI_BUS_SPI);
+    
+    spi_sim_attach(SIM_PORTB, BENCH_CS_ADC, adc, NULL, &sample);
+    
+    stream.transaction.device = spi_create_device(&PORTB, BENCH_CS_ADC, NULL);
+    stream.transaction.segments = command;
+    stream.transaction.nr_segments = ARRAY_LEN(command);
+    stream.transaction.ctx = &bench;
+    bench.stream = &stream;
+    
+    spi_handle_t handle = spi_stream_start(&stream);
+    spi_handle_t write = spi_write(payload_create_spi(PRIORITY_HIGH, device, tx, 4, NULL));
+    
+    bench.ok &= spi_wait(handle) == SPI_NO_ERROR;
+    
+    const spi_sim_stats_t* s = spi_sim_stats();
+    /* The stop takes effect after the half that was already shifting */
+    uint64_t stream_bytes = (uint64_t)length * BENCH_STREAM_BUFFERS + length / 2;
+    uint64_t stream_done = s->last_done;
+    
+    spi_error_t status;
+    
+    bench.ok &= !spi_poll(write, &status);
+    bench.ok &= spi_wait(write) == SPI_NO_ERROR;
+    bench.ok &= bench.halves == BENCH_STREAM_BUFFERS + 1 && s->cs_asserts == 2 && s->bytes == stream_bytes + ARRAY_LEN(start) + 4;
+    
+    printf("stream div=%u length=%lu buffers=%u bytes=%llu cycles=%llu bytes_per_s=%llu isr_cycles_per_byte=%llu %s\n",
+        div->div, (unsigned long)length, BENCH_STREAM_BUFFERS, (unsigned long long)stream_bytes,
+        (unsigned long long)(stream_done - s->first_start),
+        (unsigned long long)(stream_bytes * F_CPU / (stream_done - s->first_start)),
+        (unsigned long long)(s->isr_cycles / s->bytes), bench.ok ? "ok" : "error");
+    
+    spi_free_device(stream.transaction.device);
+    spi_free_device(device);
+}
+
+/*
+ * Modelled interrupt cost of a byte in the middle of a segment for every segment kind, taken as the
+ * difference between a 255 and a 128 byte segment so that the per-transaction work cancels out.
+ * Runs at DIV128, where the bus never waits for the interrupt.
+ */
+static void bench_budget(void) {
+    
+    static uint8_t rx[255];
+    
+    static const struct {
+        const char* kind;
+        uint8_t tx;
+        uint8_t rx;
+    } kinds[] = {
+        { "duplex",  1, 1 },
+        { "write",   1, 0 },
+        { "receive", 0, 1 },
+        { "fill",    0, 0 }
+    };
+    
+    static const uint8_t lengths[] = { 128, 255 };
+    
+    for (uint8_t k = 0; k < ARRAY_LEN(kinds); k++) {
+        
+        uint64_t isr_cycles[ARRAY_LEN(lengths)];
+        
+        for (uint8_t i = 0; i < ARRAY_LEN(lengths); i++) {
+            
+            spi_segment_t segment = {
+                kinds[k].tx ? tx : NULL,
+                kinds[k].rx ? rx : NULL,
+                lengths[i]
+            };
+            
+            spi_transaction_t transaction = {
+                .device = bench_setup(SPI_CLOCK_DIV128, 0, SPI_BUS_SPI),
+                .segments = &segment,
+                .nr_segments = 1,
+                .priority = PRIORITY_LOW
+            };
+            
+            spi_sim_stats_reset();
+            spi_transfer(&transaction);
+            spi_sim_run_until_idle();
+            
+            isr_cycles[i] = spi_sim_stats()->isr_cycles;
+            
+            spi_free_device(transaction.device);
+        }
+        
+        uint64_t per_byte = (isr_cycles[1] - isr_cycles[0]) / (lengths[1] - lengths[0]);
+        
+        printf("budget kind=%s model_cycles_per_byte=%llu budget=%u %s\n", kinds[k].kind,
+            (unsigned long long)per_byte, SPI_ISR_BYTE_BUDGET, per_byte <= SPI_ISR_BYTE_BUDGET ? "ok" : "over");
+    }
+}
+
+#if SPI_MSPIM_USART1
+/*
+ * Bulk writes on the SPI alone, then split between the SPI and USART1. Both buses run
+ * interrupt driven, so the second one adds its bandwidth instead of sharing the CPU polling.
+ */
+static void bench_dual(const divider_t* div, uint8_t size) {
+    
+    uint64_t single = 0, dual = 0;
+    
+    for (uint8_t buses = 1; buses <= 2; buses++) {
+        
+        device_t* devices[2];
+        
+        devices[0] = bench_setup(div->rate, 0, SPI_BUS_SPI);
+        devices[1] = (buses == 2) ? bench_device(SPI_BUS_USART1, &config) : devices[0];
+        
+        spi_sim_stats_reset();
+        
+        for (uint16_t i = 0; i < BENCH_TRANSFERS; i++) {
+            spi_write(payload_create_spi(PRIORITY_LOW, devices[i % 2], tx, size, NULL));
+            if ((i % BENCH_BURST) == BENCH_BURST - 1) spi_sim_run_until_idle();
+        }
+        
+        spi_sim_run_until_idle();
+        
+        const spi_sim_stats_t* s = spi_sim_stats();
+        uint64_t elapsed = s->last_done - s->first_start;
+        uint64_t bytes_per_s = elapsed ? (uint64_t)s->bytes * F_CPU / elapsed : 0;
+        
+        if (buses == 1) single = bytes_per_s;
+        else dual = bytes_per_s;
+        
+        spi_free_device(devices[0]);
+        if (buses == 2) spi_free_device(devices[1]);
+    }
+    
+    printf("dual div=%u size=%u spi_bytes_per_s=%llu spi_usart1_bytes_per_s=%llu\n", div->div, size,
+        (unsigned long long)single, (unsigned long long)dual);
+}
+#endif
+
+#if SPI_SOFT
+/* Slave model of the bit-banged bus: returns every byte, so it comes back during the next one */
+static uint8_t mirror(void* ctx, uint8_t mosi) {
+    (void)ctx;
+    return mosi;
+}
+
+/*
+ * One full-duplex transaction on the bit-banged bus. Checks the bytes that came back, one
+ * chip select, and that the stretched loop keeps SCK at or below max_frequency.
+ */
+static void bench_soft(data_order_t data_order, spi_mode_t mode, uint32_t max_frequency, uint8_t size) {
+
+    static uint8_t rx[255];
+
+    spi_device_config_t device_config = {
+        .bus = SPI_BUS_SOFT,
+        .data_order = data_order,
+        .mode = mode,
+        .max_frequency = max_frequency,
+        .fill_byte = BENCH_FILL
+    };
+
+    device_t* native = bench_setup(SPI_CLOCK_DIV2, SPI_POLL_THRESHOLD, SPI_BUS_SPI);
+    spi_bus_init(SPI_BUS_SOFT, &config);
+    spi_sim_soft_pins(BENCH_SOFT_PORT, SPI_SOFT_SCK, BENCH_SOFT_PORT, SPI_SOFT_MOSI, BENCH_SOFT_PORT, SPI_SOFT_MISO);
+    spi_sim_attach_soft(SIM_PORTC, BENCH_CS_SOFT, mode, mirror, NULL, NULL);
+
+    device_t* device = spi_create_device(&PORTC, BENCH_CS_SOFT, &device_config);
+    spi_segment_t segment = SPI_DUPLEX(tx, rx, size);
+    spi_transaction_t transaction = { .device = device, .segments = &segment, .nr_segments = 1,
+        .priority = PRIORITY_LOW, .callback = NULL, .ctx = NULL };
+    uint8_t ok = device != NULL;
+
+    memset(rx, 0, sizeof(rx));
+    spi_sim_stats_reset();
+
+    uint64_t start = spi_sim_stats()->cycles;
+    spi_handle_t handle = spi_transfer(&transaction);
+    uint64_t cycles = spi_sim_stats()->cycles - start;
+    spi_error_t status = SPI_ERR_NOT_DEFINED;
+
+    /* The CPU clocks the transaction during the call */
+    ok &= spi_poll(handle, &status) && status == SPI_NO_ERROR;
+    ok &= spi_sim_stats()->bytes == size && spi_sim_stats()->cs_asserts == 1 && rx[0] == 0xFF;
+
+    for (uint8_t i = 1; i < size; i++) ok &= rx[i] == tx[i - 1];
+
+    uint64_t sck_hz = cycles ? 8ULL * size * F_CPU / cycles : 0;
+
+    if (max_frequency != UINT32_MAX) ok &= sck_hz <= max_frequency;
+
+    printf("soft mode=%u order=%s max_frequency=%lu size=%u delay=%u cycles=%llu cycles_per_byte=%llu bytes_per_s=%llu sck_hz=%llu %s\n",
+        mode, data_order == SPI_LSB ? "lsb" : "msb", (unsigned long)max_frequency, size, ok ? device->rate : 0,
+        (unsigned long long)cycles, (unsigned long long)(cycles / size),
+        (unsigned long long)(cycles ? (uint64_t)size * F_CPU / cycles : 0), (unsigned long long)sck_hz, ok ? "ok" : "error");
+
+    if (device != NULL) spi_free_device(device);
+    spi_free_device(native);
+}
+#endif
+
+/*
+ * Compares the polled engine with the interrupt engine. The crossover is the smallest
+ * payload for which the interrupt engine leaves CPU time to the main loop.
+ */
+static void bench_policy(const divider_t* div) {
+
+    static const uint8_t policy_sizes[] = { 1, 2, 4, 8, 16, 32, 64, 128, 255 };
+    uint8_t crossover = 0;
+
+    for (uint8_t i = 0; i < ARRAY_LEN(policy_sizes); i++) {
+
+        uint64_t poll_latency, irq_latency;
+        uint64_t poll_cpu = bench_single(div, policy_sizes[i], UINT32_MAX, &poll_latency);
+        uint64_t irq_cpu = bench_single(div, policy_sizes[i], 0, &irq_latency);
+
+        printf("policy div=%u size=%u poll_cycles=%llu irq_latency=%llu irq_cpu=%llu\n",
+            div->div, policy_sizes[i], (unsigned long long)poll_cpu,
+            (unsigned long long)irq_latency, (unsigned long long)irq_cpu);
+
+        if (crossover == 0 && irq_cpu < poll_cpu) crossover = policy_sizes[i];
+    }
+
+    if (crossover) {
+        printf("crossover div=%u byte_cycles=%u size=%u\n", div->div, 8 * div->div, crossover);
+    }
+    else {
+        printf("crossover div=%u byte_cycles=%u size=none\n", div->div, 8 * div->div);
+    }
+}
+
+int main(void) {
+
+    for (uint16_t i = 0; i < sizeof(tx); i++) tx[i] = (uint8_t)i;
+
+    printf("bench f_cpu=%lu\n", (unsigned long)F_CPU);
+
+    for (uint8_t d = 0; d < ARRAY_LEN(dividers); d++) {
+        for (uint8_t s = 0; s < ARRAY_LEN(sizes); s++) {
+            bench_throughput(&dividers[d], sizes[s], SPI_BUS_SPI);
+        }
+    }
+
+    for (uint8_t d = 0; d < ARRAY_LEN(dividers); d++) {
+        bench_transaction(&dividers[d], SPI_BUS_SPI, 0);
+    }
+
+    bench_budget();
+
+    bench_stream(&dividers[3], 64);
+    bench_stream(&dividers[3], 255);
+    bench_stream(&dividers[6], 64);
+
+#if SPI_LENGTH_BITS > 8
+    bench_large(&dividers[0], SPI_BUS_SPI, 264);
+    bench_large(&dividers[0], SPI_BUS_SPI, 1056);
+    bench_large(&dividers[3], SPI_BUS_SPI, 264);
+    bench_large(&dividers[3], SPI_BUS_SPI, 1056);
+#if SPI_MSPIM_USART1
+    bench_large(&dividers[3], SPI_BUS_USART1, 1056);
+#endif
+
+    bench_flash(&dividers[0]);
+    bench_flash(&dividers[3]);
+    bench_flash(&dividers[6]);
+    bench_flash_merge(&dividers[3], 200, 600);
+    bench_cache(&dividers[3]);
+#endif
+
+#if SPI_MSPIM_USART1
+    for (uint8_t d = 0; d < ARRAY_LEN(dividers); d++) {
+        for (uint8_t s = 0; s < ARRAY_LEN(sizes); s++) {
+            bench_throughput(&dividers[d], sizes[s], SPI_BUS_USART1);
+        }
+    }
+
+    for (uint8_t d = 0; d < ARRAY_LEN(dividers); d++) {
+        bench_transaction(&dividers[d], SPI_BUS_USART1, 0);
+        bench_transaction(&dividers[d], SPI_BUS_USART1, UINT32_MAX);
+    }
+
+    bench_dual(&dividers[3], 64);
+    bench_dual(&dividers[5], 64);
+#endif
+
+#if SPI_BUFFERED
+    for (uint8_t d = 0; d < ARRAY_LEN(dividers); d++) {
+        for (uint8_t s = 0; s < ARRAY_LEN(sizes); s++) {
+            bench_throughput(&dividers[d], sizes[s], SPI_BUS_BUFFERED);
+        }
+    }
+
+    for (uint8_t d = 0; d < ARRAY_LEN(dividers); d++) {
+        bench_transaction(&dividers[d], SPI_BUS_BUFFERED, 0);
+        bench_transaction(&dividers[d], SPI_BUS_BUFFERED, UINT32_MAX);
+    }
+#endif
+
+    bench_priority(&dividers[3], PRIORITY_LOW);
+    bench_priority(&dividers[3], PRIORITY_HIGH);
+    bench_aging(&dividers[3]);
+
+    bench_queue(&dividers[0]);
+    bench_queue(&dividers[3]);
+
+    bench_batch(&dividers[0], 3);
+    bench_batch(&dividers[3], 3);
+    bench_batch(&dividers[3], 16);
+
+    for (uint8_t d = 0; d < ARRAY_LEN(dividers); d++) {
+        bench_policy(&dividers[d]);
+    }
+
+    bench_errors();
+
+    bench_static(0, 16);
+    bench_static(3, 64);
+    bench_static(6, 64);
+
+#if SPI_SOFT
+    bench_soft(SPI_MSB, SPI_MODE0, UINT32_MAX, 64);
+    bench_soft(SPI_MSB, SPI_MODE1, UINT32_MAX, 64);
+    bench_soft(SPI_MSB, SPI_MODE2, UINT32_MAX, 64);
+    bench_soft(SPI_MSB, SPI_MODE3, UINT32_MAX, 64);
+    bench_soft(SPI_LSB, SPI_MODE0, UINT32_MAX, 64);
+    bench_soft(SPI_LSB, SPI_MODE3, UINT32_MAX, 4);
+    bench_soft(SPI_MSB, SPI_MODE0, 400000, 64);
+    bench_soft(SPI_MSB, SPI_MODE3, 100000, 16);
+#endif
+
+#if SPI_STATS
+    bench_stats(&dividers[3]);
+    bench_sleep(&dividers[3]);
+#endif
+
+#if SPI_TRACE
+    bench_trace(&dividers[3]);
+#endif
+
+    return 0;
+}
@@ -0,0 +1,25 @@
+/*************************************************************************
+* Title		: <led_lib.h> shim for host builds
+* Author	: Dimitri Dening
+* Created	: 17.10.2026 18:20:15
+* Software	: GCC (host)
+* Hardware	: Simulated ATmega1284P
+* License	: MIT License
+*
+* NOTES:
+*	Stands in for the libAVR LED driver. The LEDs are bits of
+*	sim_leds, so the bench can follow the error sequence.
+*************************************************************************/
+#ifndef SIM_LED_LIB_H_
+#define SIM_LED_LIB_H_
+
+#include <stdint.h>
+
+#define LED_ERROR           7
+
+extern uint8_t sim_leds;
+
+#define led_init()          ((void)(sim_leds = 0))
+#define led_toggle(led)     ((void)(sim_leds ^= (uint8_t)(1 << (led))))
+
+#endif /* SIM_LED_LIB_H_ */
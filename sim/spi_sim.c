@@ -0,0 +1,786 @@
+/*************************************************************************
+* Title     : Host-side SPI Register Model
+* Author    : Dimitri Dening
+* Created   : 17.10.2026 09:12:40
+* Software  : GCC (host)
+* Hardware  : Simulated ATmega1284P
+
+DESCRIPTION:
+    Cycle-accounted model of the SPI peripheral, both USARTs in master SPI
+    mode, the buffered SPI0 of the AVR Dx series, the GPIO ports and the
+    global interrupt flag. Drives ISR(SPI_STC_vect), ISR(USARTn_RX_vect)
+    and ISR(SPI0_INT_vect) of the driver under test.
+USAGE:
+    see <spi_sim.h>
+NOTES:
+    Byte time is 8 SCK periods, SCK = F_CPU / divider as selected by
+    SPR1:0 and SPI2X. A byte written to SPDR while the shifter is busy
+    sets WCOL and is discarded, like on silicon.
+    USART byte time is 8 XCK periods, XCK = F_CPU / (2 * (UBRRn + 1)).
+    The buffered SPI shares the model of the USARTs, a transmit buffer in
+    front of the shifter and a two byte receive FIFO. Its byte time is 8
+    SCK periods as selected by PRESC and CLK2X. Only buffered mode (BUFEN)
+    is modelled, TXCIF is a status like TXCn and BUFOVF is not kept.
+    The bit-banged bus has no timing of its own, it follows the SCK edges
+    the driver writes to the ports.
+    The USART and SPI0 vectors are weak, so drivers without these buses
+    still link.
+*************************************************************************/
+
+#define _POSIX_C_SOURCE 199309L
+
+/* General libraries */
+#include <string.h>
+#include <time.h>
+
+/* User defined libraries */
+#include "spi_sim.h"
+
+#define SPDR_UNTOUCHED  0x0100
+#define NO_REG          0xFF
+#define MAX_SLAVES      8
+#define NR_USARTS       2
+#define NR_BUFFERED     (NR_USARTS + 1)     // USARTs and the buffered SPI
+#define BUFFERED_SPI    NR_USARTS           // Index of the buffered SPI in usarts[]
+#define USART_REGS      (SIM_UCSR1A - SIM_UCSR0A)
+#define BUS_SPI         0
+#define BUS_USART(n)    ((n) + 1)
+#define BUS_SOFT        (NR_USARTS + 1)
+#define BUS_BUFFERED    (NR_USARTS + 2)
+
+typedef struct {
+    uint8_t bus;
+    spi_sim_reg_t port;
+    uint8_t mask;
+    uint8_t mode;               // SPI mode of a slave on the bit-banged bus
+    spi_sim_slave_fn xfer;
+    spi_sim_release_fn release;
+    void* ctx;
+} slave_t;
+
+/* USART in master SPI mode, or the buffered SPI */
+typedef struct {
+    volatile uint16_t udr;
+    uint8_t buffer;             // transmit buffer
+    uint8_t buffered;
+    uint8_t shifting;
+    uint8_t shift_tx;
+    uint64_t shift_start;
+    uint64_t shift_done;
+    uint8_t fifo[2];            // receive FIFO
+    uint8_t fifo_count;
+} usart_t;
+
+/* Bit-banged bus, pins are masks of their port */
+typedef struct {
+    uint8_t configured;
+    spi_sim_reg_t sck_port;
+    spi_sim_reg_t mosi_port;
+    spi_sim_reg_t miso_pin;
+    uint8_t sck;
+    uint8_t mosi;
+    uint8_t miso;
+    uint8_t bits;               // MOSI bits sampled of the current byte
+    uint8_t shift_in;
+    uint8_t out;                // byte on MISO
+    uint8_t next;               // answer of the slave to the last byte, sent during the next one
+} soft_t;
+
+extern void SPI_STC_vect(void) __attribute__((weak));   // Not linked in builds without the classic SPI
+extern void USART0_RX_vect(void) __attribute__((weak));
+extern void USART1_RX_vect(void) __attribute__((weak));
+extern void SPI0_INT_vect(void) __attribute__((weak));
+
+static void (*const usart_vect[NR_BUFFERED])(void) = { USART0_RX_vect, USART1_RX_vect, SPI0_INT_vect };
+
+uint8_t spi_sim_regs[SIM_NR_REGS];
+static volatile uint16_t spdr;
+
+static const spi_sim_reg_t ports[] = { SIM_PORTA, SIM_PORTB, SIM_PORTC, SIM_PORTD };
+static uint8_t port_shadow[sizeof(ports) / sizeof(ports[0])];
+
+/* LEDs of the <led_lib.h> shim */
+uint8_t sim_leds;
+
+static uint8_t last_reg = NO_REG;
+static uint8_t last_val;
+static uint8_t spif_armed;
+
+static uint8_t sreg_i;
+static uint8_t in_isr;
+
+static uint8_t shifting;
+static uint8_t shift_tx;
+static uint64_t shift_start;
+static uint64_t shift_done;
+static uint8_t rx;
+
+static usart_t usarts[NR_BUFFERED];
+
+static soft_t soft;
+
+static uint64_t cs_released;
+static uint8_t cs_seen;
+static uint8_t started;
+
+static slave_t slaves[MAX_SLAVES];
+static uint8_t nr_slaves;
+
+static spi_sim_stats_t stats;
+
+static void service(void);
+
+static uint8_t reverse(uint8_t b) {
+    b = (uint8_t)((b & 0xF0) >> 4 | (b & 0x0F) << 4);
+    b = (uint8_t)((b & 0xCC) >> 2 | (b & 0x33) << 2);
+    b = (uint8_t)((b & 0xAA) >> 1 | (b & 0x55) << 1);
+    return b;
+}
+
+static uint16_t divider(void) {
+    static const uint16_t div[] = { 4, 16, 64, 128 };
+    uint16_t d = div[spi_sim_regs[SIM_SPCR] & 0x03];
+    return (spi_sim_regs[SIM_SPSR] & (1 << SPI2X)) ? d / 2 : d;
+}
+
+static slave_t* selected(uint8_t bus) {
+    for (uint8_t i = 0; i < nr_slaves; i++) {
+        if (slaves[i].bus == bus && !(spi_sim_regs[slaves[i].port] & slaves[i].mask)) return &slaves[i];
+    }
+    return NULL;
+}
+
+static void tick(uint64_t n) {
+    stats.cycles += n;
+    if (in_isr) stats.isr_cycles += n;
+}
+
+static void shift_start_byte(uint8_t byte) {
+
+    if (!(spi_sim_regs[SIM_SPCR] & (1 << SPE)) || !(spi_sim_regs[SIM_SPCR] & (1 << MSTR))) return;
+
+    if (shifting) {
+        spi_sim_regs[SIM_SPSR] |= (1 << WCOL);
+        stats.write_collisions++;
+        return;
+    }
+
+    if (!started) {
+        stats.first_start = stats.cycles;
+        started = 1;
+    }
+
+    shifting = 1;
+    shift_tx = byte;
+    shift_start = stats.cycles;
+    shift_done = stats.cycles + 8u * divider();
+}
+
+static void shift_finish(void) {
+
+    slave_t* slave = selected(BUS_SPI);
+    uint8_t lsb = spi_sim_regs[SIM_SPCR] & (1 << DORD);
+    uint8_t wire = lsb ? reverse(shift_tx) : shift_tx;
+    uint8_t miso = 0xFF;
+
+    if (slave != NULL && slave->xfer != NULL) miso = slave->xfer(slave->ctx, wire);
+
+    rx = lsb ? reverse(miso) : miso;
+    shifting = 0;
+
+    stats.bytes++;
+    stats.busy_cycles += shift_done - shift_start;
+    stats.last_done = shift_done;
+
+    spi_sim_regs[SIM_SPSR] |= (1 << SPIF);
+    spif_armed = 0;
+}
+
+static spi_sim_reg_t usart_reg(uint8_t n, spi_sim_reg_t reg0) {
+    return (spi_sim_reg_t)(reg0 + n * USART_REGS);
+}
+
+static uint8_t usart_bus(uint8_t n) {
+    return (n == BUFFERED_SPI) ? BUS_BUFFERED : BUS_USART(n);
+}
+
+/* Transmitter enabled in master SPI mode, the buffered SPI also needs BUFEN */
+static uint8_t usart_mspim(uint8_t n) {
+
+    if (n == BUFFERED_SPI) {
+        uint8_t a = spi_sim_regs[SIM_SPI0_CTRLA];
+        return (a & SPI_ENABLE_bm) && (a & SPI_MASTER_bm) && (spi_sim_regs[SIM_SPI0_CTRLB] & SPI_BUFEN_bm);
+    }
+
+    uint8_t c = spi_sim_regs[usart_reg(n, SIM_UCSR0C)];
+
+    return (c & ((1 << UMSEL01) | (1 << UMSEL00))) == ((1 << UMSEL01) | (1 << UMSEL00)) &&
+           (spi_sim_regs[usart_reg(n, SIM_UCSR0B)] & (1 << TXEN0));
+}
+
+static uint8_t usart_lsb(uint8_t n) {
+    if (n == BUFFERED_SPI) return (spi_sim_regs[SIM_SPI0_CTRLA] & SPI_DORD_bm) != 0;
+    return (spi_sim_regs[usart_reg(n, SIM_UCSR0C)] & (1 << UDORD0)) != 0;
+}
+
+static uint8_t usart_receiving(uint8_t n) {
+    if (n == BUFFERED_SPI) return 1;
+    return (spi_sim_regs[usart_reg(n, SIM_UCSR0B)] & (1 << RXEN0)) != 0;
+}
+
+static uint64_t usart_byte_cycles(uint8_t n) {
+
+    if (n == BUFFERED_SPI) {
+        static const uint16_t div[] = { 4, 16, 64, 128 };
+        uint8_t a = spi_sim_regs[SIM_SPI0_CTRLA];
+        uint16_t d = div[(a & SPI_PRESC_gm) >> SPI_PRESC_gp];
+        return 8u * ((a & SPI_CLK2X_bm) ? d / 2 : d);
+    }
+
+    uint16_t ubrr = (uint16_t)(((spi_sim_regs[usart_reg(n, SIM_UBRR0H)] & 0x0F) << 8) | spi_sim_regs[usart_reg(n, SIM_UBRR0L)]);
+
+    return 8u * 2u * (ubrr + 1u);
+}
+
+static void usart_shift(uint8_t n, uint8_t byte, uint64_t at) {
+
+    usart_t* u = &usarts[n];
+
+    if (!started) {
+        stats.first_start = at;
+        started = 1;
+    }
+
+    u->shifting = 1;
+    u->shift_tx = byte;
+    u->shift_start = at;
+    u->shift_done = at + usart_byte_cycles(n);
+}
+
+static void usart_write(uint8_t n, uint8_t byte) {
+
+    usart_t* u = &usarts[n];
+
+    if (!usart_mspim(n)) return;
+
+    if (!u->shifting) {
+        usart_shift(n, byte, stats.cycles);
+    }
+    else if (!u->buffered) {
+        u->buffer = byte;
+        u->buffered = 1;
+    }
+    else {
+        stats.write_collisions++;
+    }
+}
+
+static void usart_finish(uint8_t n) {
+
+    usart_t* u = &usarts[n];
+    slave_t* slave = selected(usart_bus(n));
+    uint8_t lsb = usart_lsb(n);
+    uint8_t wire = lsb ? reverse(u->shift_tx) : u->shift_tx;
+    uint8_t miso = 0xFF;
+
+    if (slave != NULL && slave->xfer != NULL) miso = slave->xfer(slave->ctx, wire);
+
+    if (usart_receiving(n)) {
+        if (u->fifo_count < 2) u->fifo[u->fifo_count++] = lsb ? reverse(miso) : miso;
+        else stats.overruns++;
+    }
+
+    u->shifting = 0;
+
+    stats.bytes++;
+    stats.busy_cycles += u->shift_done - u->shift_start;
+    stats.last_done = u->shift_done;
+
+    /* The buffered byte enters the shifter right away, there is no gap between the two */
+    if (u->buffered) {
+        u->buffered = 0;
+        usart_shift(n, u->buffer, u->shift_done);
+    }
+}
+
+/* Receive complete, transmit buffer empty and transmit complete flags of the buffered SPI */
+static uint8_t spi0_flags(void) {
+
+    usart_t* u = &usarts[BUFFERED_SPI];
+
+    return (uint8_t)((u->fifo_count ? SPI_RXCIF_bm : 0) | (u->buffered ? 0 : SPI_DREIF_bm) |
+                     ((!u->shifting && !u->buffered) ? SPI_TXCIF_bm : 0));
+}
+
+static uint8_t usart_irq(uint8_t n) {
+
+    if (usart_vect[n] == NULL) return 0;
+
+    if (n == BUFFERED_SPI) {
+        uint8_t enabled = spi_sim_regs[SIM_SPI0_INTCTRL] & (SPI_RXCIE_bm | SPI_DREIE_bm | SPI_TXCIE_bm);
+        return (spi_sim_regs[SIM_SPI0_CTRLA] & SPI_ENABLE_bm) && (spi0_flags() & enabled);
+    }
+
+    return usarts[n].fifo_count != 0 && (spi_sim_regs[usart_reg(n, SIM_UCSR0B)] & (1 << RXCIE0));
+}
+
+/* Completes every byte whose shift time has passed, in the order they finish */
+static void finish_due(void) {
+
+    for (;;) {
+
+        uint64_t first = UINT64_MAX;
+        int8_t which = -2;
+
+        if (shifting && shift_done <= stats.cycles) {
+            first = shift_done;
+            which = -1;
+        }
+
+        for (uint8_t n = 0; n < NR_BUFFERED; n++) {
+            if (usarts[n].shifting && usarts[n].shift_done <= stats.cycles && usarts[n].shift_done < first) {
+                first = usarts[n].shift_done;
+                which = (int8_t)n;
+            }
+        }
+
+        if (which == -2) return;
+
+        if (which == -1) shift_finish();
+        else usart_finish((uint8_t)which);
+    }
+}
+
+/* Cycle of the next byte to complete on any bus, UINT64_MAX if all are idle */
+static uint64_t next_done(void) {
+
+    uint64_t next = shifting ? shift_done : UINT64_MAX;
+
+    for (uint8_t n = 0; n < NR_BUFFERED; n++) {
+        if (usarts[n].shifting && usarts[n].shift_done < next) next = usarts[n].shift_done;
+    }
+
+    return next;
+}
+
+static void soft_select(void) {
+    soft.bits = 0;
+    soft.shift_in = 0;
+    soft.out = 0xFF;
+    soft.next = 0xFF;
+}
+
+/* An SCK edge of the bit-banged bus, the selected slave samples MOSI on the edge of its SPI mode */
+static void soft_edge(uint8_t level) {
+
+    slave_t* slave = selected(BUS_SOFT);
+
+    if (slave == NULL) return;
+
+    uint8_t cpol = (slave->mode >> 1) & 1;
+    uint8_t cpha = slave->mode & 1;
+    uint8_t leading = level != cpol;
+
+    /* CPHA = 0 samples on the leading edge, CPHA = 1 on the trailing one */
+    if (leading == cpha) return;
+
+    if (soft.bits == 8) {
+        soft.bits = 0;
+        soft.out = soft.next;
+    }
+
+    soft.shift_in = (uint8_t)(soft.shift_in << 1 | ((spi_sim_regs[soft.mosi_port] & soft.mosi) != 0));
+    soft.bits++;
+
+    if (soft.bits == 8) {
+
+        soft.next = (slave->xfer != NULL) ? slave->xfer(slave->ctx, soft.shift_in) : 0xFF;
+
+        if (!started) {
+            stats.first_start = stats.cycles;
+            started = 1;
+        }
+
+        stats.bytes++;
+        stats.last_done = stats.cycles;
+    }
+}
+
+/* MISO shows the bit of the current byte that belongs to the last sampling edge */
+static void soft_miso(void) {
+
+    uint8_t bit = (soft.bits == 0) ? 0 : soft.bits - 1;
+
+    if (selected(BUS_SOFT) == NULL) return;
+
+    if ((uint8_t)(soft.out << bit) & 0x80) spi_sim_regs[soft.miso_pin] |= soft.miso;
+    else spi_sim_regs[soft.miso_pin] &= (uint8_t)~soft.miso;
+}
+
+static void port_written(spi_sim_reg_t port, uint8_t old, uint8_t val) {
+
+    for (uint8_t i = 0; i < nr_slaves; i++) {
+
+        if (slaves[i].port != port) continue;
+
+        uint8_t mask = slaves[i].mask;
+
+        if ((old & mask) && !(val & mask)) {
+            if (slaves[i].bus == BUS_SOFT) soft_select();
+            stats.cs_asserts++;
+            if (cs_seen) {
+                stats.cs_gap_cycles += stats.cycles - cs_released;
+                stats.cs_gaps++;
+            }
+        }
+        else if (!(old & mask) && (val & mask)) {
+            cs_released = stats.cycles;
+            cs_seen = 1;
+            if (slaves[i].release != NULL) slaves[i].release(slaves[i].ctx);
+        }
+    }
+
+    if (soft.configured && port == soft.sck_port && ((old ^ val) & soft.sck)) soft_edge((val & soft.sck) != 0);
+}
+
+static void scan_ports(void) {
+
+    for (uint8_t i = 0; i < sizeof(ports) / sizeof(ports[0]); i++) {
+        if (spi_sim_regs[ports[i]] != port_shadow[i]) {
+            uint8_t old = port_shadow[i];
+            port_shadow[i] = spi_sim_regs[ports[i]];
+            port_written(ports[i], old, port_shadow[i]);
+        }
+    }
+}
+
+static void commit(void) {
+
+    uint8_t reg = last_reg;
+
+    /* Ports may also be written through a pointer taken once, e.g. a chip select descriptor */
+    scan_ports();
+
+    if (reg == NO_REG) return;
+
+    last_reg = NO_REG;
+
+    if (reg >= SIM_NR_REGS) {
+        usart_t* u = &usarts[reg - SIM_NR_REGS];
+        if (u->udr & SPDR_UNTOUCHED) {
+            /* Read: pop the receive FIFO */
+            if (u->fifo_count != 0) {
+                u->fifo[0] = u->fifo[1];
+                u->fifo_count--;
+            }
+        }
+        else {
+            usart_write((uint8_t)(reg - SIM_NR_REGS), (uint8_t)u->udr);
+        }
+        return;
+    }
+
+    if (reg == SIM_SPDR) {
+        /* Reading SPSR with SPIF set, then accessing SPDR clears SPIF */
+        if (spif_armed) {
+            spi_sim_regs[SIM_SPSR] &= ~((1 << SPIF) | (1 << WCOL));
+            spif_armed = 0;
+        }
+        if (!(spdr & SPDR_UNTOUCHED)) {
+            shift_start_byte((uint8_t)spdr);
+        }
+        return;
+    }
+
+    if (spi_sim_regs[reg] == last_val) return;
+
+    switch (reg) {
+        case SIM_SPSR:
+            /* Only SPI2X is writable */
+            spi_sim_regs[reg] = (uint8_t)((last_val & ~(1 << SPI2X)) | (spi_sim_regs[reg] & (1 << SPI2X)));
+            break;
+        default:
+            break;
+    }
+}
+
+static void dispatch(void (*vect)(void)) {
+
+    struct timespec t0, t1;
+
+    in_isr = 1;
+    sreg_i = 0;
+    if (vect == SPI_STC_vect) spi_sim_regs[SIM_SPSR] &= ~(1 << SPIF);
+
+    tick(SPI_SIM_ISR_ENTRY_CYCLES);
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    vect();
+    commit();
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    tick(SPI_SIM_ISR_EXIT_CYCLES);
+
+    stats.isr_host_ns += (uint64_t)(t1.tv_sec - t0.tv_sec) * 1000000000u + (uint64_t)(t1.tv_nsec - t0.tv_nsec);
+    stats.isr_count++;
+
+    in_isr = 0;
+    sreg_i = 1;
+}
+
+static uint8_t spi_irq(void) {
+
+    if (SPI_STC_vect == NULL) return 0;
+
+    return (spi_sim_regs[SIM_SPSR] & (1 << SPIF)) && (spi_sim_regs[SIM_SPCR] & (1 << SPIE));
+}
+
+static void service(void) {
+
+    finish_due();
+
+    if (in_isr) return;
+
+    for (;;) {
+
+        finish_due();
+
+        if (!sreg_i) return;
+
+        /* Vector order of the ATmega1284P: SPI_STC before USART0_RX before USART1_RX, SPI0_INT comes last */
+        if (spi_irq()) {
+            dispatch(SPI_STC_vect);
+            continue;
+        }
+
+        uint8_t n;
+
+        for (n = 0; n < NR_BUFFERED && !usart_irq(n); n++);
+
+        if (n == NR_BUFFERED) return;
+
+        dispatch(usart_vect[n]);
+    }
+}
+
+volatile uint8_t* spi_sim_io(spi_sim_reg_t reg) {
+
+    commit();
+    tick(SPI_SIM_IO_CYCLES);
+    service();
+
+    switch (reg) {
+        case SIM_PINA: spi_sim_regs[reg] = spi_sim_regs[SIM_PORTA]; break;
+        case SIM_PINB: spi_sim_regs[reg] = spi_sim_regs[SIM_PORTB]; break;
+        case SIM_PINC: spi_sim_regs[reg] = spi_sim_regs[SIM_PORTC]; break;
+        case SIM_PIND: spi_sim_regs[reg] = spi_sim_regs[SIM_PORTD]; break;
+        case SIM_SPSR: if (spi_sim_regs[reg] & (1 << SPIF)) spif_armed = 1; break;
+        case SIM_UCSR0A:
+        case SIM_UCSR1A: {
+            usart_t* u = &usarts[reg == SIM_UCSR1A];
+            spi_sim_regs[reg] = (uint8_t)((u->fifo_count ? (1 << RXC0) : 0) | (u->buffered ? 0 : (1 << UDRE0)) |
+                                  ((!u->shifting && !u->buffered) ? (1 << TXC0) : 0));
+            break;
+        }
+        case SIM_SPI0_INTFLAGS: spi_sim_regs[reg] = spi0_flags(); break;
+        default: break;
+    }
+
+    if (soft.configured && reg == soft.miso_pin) soft_miso();
+
+    last_reg = (uint8_t)reg;
+    last_val = spi_sim_regs[reg];
+
+    return &spi_sim_regs[reg];
+}
+
+volatile uint16_t* spi_sim_spdr(void) {
+
+    commit();
+    tick(SPI_SIM_IO_CYCLES);
+    service();
+
+    spdr = (uint16_t)(SPDR_UNTOUCHED | rx);
+    last_reg = SIM_SPDR;
+
+    return &spdr;
+}
+
+volatile uint16_t* spi_sim_udr(uint8_t usart) {
+
+    usart_t* u = &usarts[usart];
+
+    commit();
+    tick(SPI_SIM_IO_CYCLES);
+    service();
+
+    u->udr = (uint16_t)(SPDR_UNTOUCHED | (u->fifo_count ? u->fifo[0] : 0));
+    last_reg = (uint8_t)(SIM_NR_REGS + usart);
+
+    return &u->udr;
+}
+
+volatile uint16_t* spi_sim_spi0_data(void) {
+    return spi_sim_udr(BUFFERED_SPI);
+}
+
+void spi_sim_reset(void) {
+    memset(spi_sim_regs, 0, sizeof(spi_sim_regs));
+    memset(port_shadow, 0, sizeof(port_shadow));
+    memset(slaves, 0, sizeof(slaves));
+    nr_slaves = 0;
+    last_reg = NO_REG;
+    spif_armed = 0;
+    sreg_i = 0;
+    in_isr = 0;
+    shifting = 0;
+    rx = 0;
+    memset(usarts, 0, sizeof(usarts));
+    memset(&soft, 0, sizeof(soft));
+    spi_sim_stats_reset();
+}
+
+static void attach(uint8_t bus, spi_sim_reg_t port, uint8_t pin, spi_sim_slave_fn xfer, spi_sim_release_fn release, void* ctx) {
+
+    if (nr_slaves == MAX_SLAVES) return;
+
+    slaves[nr_slaves].bus = bus;
+    slaves[nr_slaves].port = port;
+    slaves[nr_slaves].mask = (uint8_t)(1 << pin);
+    slaves[nr_slaves].xfer = xfer;
+    slaves[nr_slaves].release = release;
+    slaves[nr_slaves].ctx = ctx;
+    nr_slaves++;
+}
+
+void spi_sim_attach(spi_sim_reg_t port, uint8_t pin, spi_sim_slave_fn xfer, spi_sim_release_fn release, void* ctx) {
+    attach(BUS_SPI, port, pin, xfer, release, ctx);
+}
+
+void spi_sim_attach_usart(uint8_t usart, spi_sim_reg_t port, uint8_t pin, spi_sim_slave_fn xfer, spi_sim_release_fn release, void* ctx) {
+    attach(BUS_USART(usart), port, pin, xfer, release, ctx);
+}
+
+void spi_sim_attach_buffered(spi_sim_reg_t port, uint8_t pin, spi_sim_slave_fn xfer, spi_sim_release_fn release, void* ctx) {
+    attach(BUS_BUFFERED, port, pin, xfer, release, ctx);
+}
+
+void spi_sim_attach_soft(spi_sim_reg_t port, uint8_t pin, uint8_t mode, spi_sim_slave_fn xfer, spi_sim_release_fn release, void* ctx) {
+
+    attach(BUS_SOFT, port, pin, xfer, release, ctx);
+
+    if (nr_slaves != 0) slaves[nr_slaves - 1].mode = mode;
+}
+
+/* MISO is read through the PIN register of its port, which precedes DDR and PORT */
+void spi_sim_soft_pins(spi_sim_reg_t sck_port, uint8_t sck, spi_sim_reg_t mosi_port, uint8_t mosi, spi_sim_reg_t miso_port, uint8_t miso) {
+    soft.configured = 1;
+    soft.sck_port = sck_port;
+    soft.sck = (uint8_t)(1 << sck);
+    soft.mosi_port = mosi_port;
+    soft.mosi = (uint8_t)(1 << mosi);
+    soft.miso_pin = (spi_sim_reg_t)(miso_port - 2);
+    soft.miso = (uint8_t)(1 << miso);
+    soft_select();
+}
+
+void spi_sim_run(uint64_t cycles) {
+
+    uint64_t end = stats.cycles + cycles;
+
+    commit();
+
+    while (stats.cycles < end) {
+        uint64_t next = next_done();
+        if (next < end && next > stats.cycles) {
+            tick(next - stats.cycles);
+        }
+        else {
+            tick(end - stats.cycles);
+        }
+        service();
+    }
+}
+
+void spi_sim_run_until_idle(void) {
+
+    commit();
+
+    for (;;) {
+        uint64_t next = next_done();
+        if (next != UINT64_MAX) {
+            if (next > stats.cycles) tick(next - stats.cycles);
+            service();
+        }
+        else if (sreg_i && (spi_irq() || usart_irq(0) || usart_irq(1) || usart_irq(BUFFERED_SPI))) {
+            service();
+        }
+        else {
+            return;
+        }
+    }
+}
+
+void spi_sim_sei(void) {
+    commit();
+    sreg_i = 1;
+    service();
+}
+
+void spi_sim_cli(void) {
+    commit();
+    sreg_i = 0;
+}
+
+uint8_t spi_sim_irq_save(void) {
+    uint8_t i = sreg_i;
+    commit();
+    if (i) stats.critical_sections++;
+    sreg_i = 0;
+    return i;
+}
+
+void spi_sim_irq_restore(uint8_t i) {
+    commit();
+    sreg_i = i;
+    if (i) service();
+}
+
+const spi_sim_stats_t* spi_sim_stats(void) {
+    commit();
+    return &stats;
+}
+
+/* Idle sleep: runs to the next byte completion and services the interrupts it raises */
+void spi_sim_sleep(void) {
+
+    commit();
+
+    uint64_t next = next_done();
+
+    if (next == UINT64_MAX) return;
+
+    if (next > stats.cycles) tick(next - stats.cycles);
+
+    service();
+}
+
+/* Current CPU cycle without committing pending register accesses, safe to call from a slave model */
+uint64_t spi_sim_now(void) {
+    return stats.cycles;
+}
+
+void spi_sim_cycles(uint8_t n) {
+    commit();
+    tick(n);
+}
+
+void spi_sim_stats_reset(void) {
+    /* Writes not seen by the model yet belong to the old statistics */
+    commit();
+    uint64_t now = stats.cycles;
+    memset(&stats, 0, sizeof(stats));
+    stats.cycles = now;
+    cs_seen = 0;
+    started = 0;
+}
@@ -0,0 +1,427 @@
+/*************************************************************************
+* Title		: Host-side SPI Register Model
+* Author	: Dimitri Dening
+* Created	: 17.10.2026 09:12:40
+* Software	: GCC (host)
+* Hardware	: Simulated ATmega1284P
+* License	: MIT License
+* Usage		: see Doxygen manual
+*
+*       Copyright (C) 2021 Dimitri Dening
+*
+*       Permission is hereby granted, free of charge, to any person obtaining a copy
+*       of this software and associated documentation files (the "Software"), to deal
+*       in the Software without restriction, including without limitation the rights
+*       to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*       copies of the Software, and to permit persons to whom the Software is
+*       furnished to do so, subject to the following conditions:
+*
+*       The above copyright notice and this permission notice shall be included in all
+*       copies or substantial portions of the Software.
+*
+*       THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*       IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*       FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*       AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*       LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*       OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*       SOFTWARE.
+*
+* NOTES:
+*	This file is pulled in through the <avr/io.h> shim in this directory.
+*	Build the driver with -Isim so that <spi_io.h> resolves to this model.
+*************************************************************************/
+
+/**
+@file spi_sim.h
+@author Dimitri Dening
+@date 17.10.2026
+@copyright (C) 2021 Dimitri Dening, MIT License
+@brief Cycle-accounted model of the ATmega1284P SPI peripheral, both USARTs in master SPI mode and the buffered SPI of the AVR Dx series for host builds.
+
+Every access to a simulated I/O register goes through spi_sim_io(), which charges
+SPI_SIM_IO_CYCLES to the simulated CPU clock, advances the SPI shifter and raises
+SPI_STC_vect once SPIF is set, SPIE is enabled and interrupts are globally enabled.
+The driver itself is compiled unchanged; register names, bit positions and the
+<ISR()> macro are provided by the shims in <sim/avr/>.
+
+Writes are detected when the next register access happens: the model remembers the
+value of the last returned register and compares it on the following access.
+SPDR is modelled as a 16 bit cell whose upper byte marks an untouched read value,
+so a write of the byte that was just received is still seen as a write.
+UDR0 and UDR1 use the same scheme. In master SPI mode (MSPIM) each USART has a transmit
+buffer in front of its shifter, so a byte written while the shifter is busy follows without
+a gap, and a two byte receive FIFO that raises USARTn_RX_vect while RXCIEn is set.
+
+SPI0_CTRLA to SPI0_DATA model the SPI of the AVR Dx and megaAVR 0-series in buffered mode (BUFEN)
+on PORTA4 to PORTA7, the pins it has there. It shares the transmit buffer and the receive FIFO of
+the USART model. SPI0_INT_vect is raised while a flag of SPI0_INTFLAGS is set whose interrupt is
+enabled in SPI0_INTCTRL: RXCIF while the FIFO holds a byte, DREIF while the transmit buffer is
+empty and TXCIF while both the buffer and the shifter are.
+
+Slaves are attached to one bus: spi_sim_attach() for the SPI, spi_sim_attach_usart() for a USART,
+spi_sim_attach_buffered() for the buffered SPI, spi_sim_attach_soft() for a bit-banged bus on the GPIO pins given to spi_sim_soft_pins().
+The bit-banged model samples MOSI on the sampling edge of the SPI mode of the slave and drives
+MISO from the byte the slave returned for the previous byte, 0xFF for the first one after the
+chip select, like a slave that loads its shift register once a byte is complete.
+The statistics sum up all buses.
+
+Built with -DSPI_SIM_DX=1 the model stands for an AVR Dx: SPCR, SPSR and SPDR are not declared
+and the ATmega1284P is not selected, so the driver is compiled without the classic SPI and the
+buffered SPI is its only SPI peripheral.
+
+@note Cycle counts are a model. The driver runs as native host code, so only register
+      accesses, the fixed interrupt entry/exit overhead and the hand-counted instruction
+      cycles the driver reports through SPI_CYCLES() are charged.
+@bug No known bugs.
+*/
+#ifndef SPI_SIM_H_
+#define SPI_SIM_H_
+
+#include <stdint.h>
+
+#ifndef F_CPU
+#define F_CPU 10000000UL
+#endif
+
+/* Set to 1 to leave out the classic SPI registers, like an AVR Dx */
+#ifndef SPI_SIM_DX
+#define SPI_SIM_DX 0
+#endif
+
+/* The simulated part shares the ATmega1284P port layout */
+#if !SPI_SIM_DX && !defined(__AVR_ATmega1284P__)
+#define __AVR_ATmega1284P__
+#endif
+
+/* Cycle model */
+#define SPI_SIM_IO_CYCLES           2   // lds/sts to an I/O register
+#define SPI_SIM_ISR_ENTRY_CYCLES    21  // vector, jmp, prologue (SREG, r0, r1, 8 call-clobbered regs)
+#define SPI_SIM_ISR_EXIT_CYCLES     20  // epilogue, reti
+
+typedef enum {
+    SIM_PINA, SIM_DDRA, SIM_PORTA,
+    SIM_PINB, SIM_DDRB, SIM_PORTB,
+    SIM_PINC, SIM_DDRC, SIM_PORTC,
+    SIM_PIND, SIM_DDRD, SIM_PORTD,
+    SIM_SPCR, SIM_SPSR, SIM_SPDR,
+    SIM_UCSR0A, SIM_UCSR0B, SIM_UCSR0C, SIM_UBRR0L, SIM_UBRR0H,
+    SIM_UCSR1A, SIM_UCSR1B, SIM_UCSR1C, SIM_UBRR1L, SIM_UBRR1H,
+    SIM_SPI0_CTRLA, SIM_SPI0_CTRLB, SIM_SPI0_INTCTRL, SIM_SPI0_INTFLAGS,
+    SIM_NR_REGS
+} spi_sim_reg_t;
+
+/* Slave model: receives the MOSI byte, returns the MISO byte */
+typedef uint8_t (*spi_sim_slave_fn)(void* ctx, uint8_t mosi);
+
+/* Called when the chip select of a slave is released */
+typedef void (*spi_sim_release_fn)(void* ctx);
+
+typedef struct spi_sim_stats_t {
+    uint64_t cycles;            // simulated CPU clock
+    uint64_t first_start;       // cycle of the first SPDR write since reset
+    uint64_t last_done;         // cycle the last byte left the shifter
+    uint64_t busy_cycles;       // cycles the shifter was running
+    uint64_t isr_cycles;        // cycles spent in SPI_STC_vect incl. entry/exit
+    uint64_t isr_host_ns;       // host wall time spent in SPI_STC_vect
+    uint64_t cs_gap_cycles;     // sum of deassert -> assert gaps
+    uint32_t bytes;
+    uint32_t isr_count;
+    uint32_t cs_asserts;
+    uint32_t cs_gaps;
+    uint32_t write_collisions;  // incl. bytes written to a full USART transmit buffer
+    uint32_t overruns;          // bytes lost because a USART or buffered SPI receive FIFO was full
+    uint32_t critical_sections; // ATOMIC_BLOCKs entered with interrupts enabled
+} spi_sim_stats_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Register file behind spi_sim_io(), only for addresses that have to be constants */
+extern uint8_t spi_sim_regs[SIM_NR_REGS];
+
+volatile uint8_t* spi_sim_io(spi_sim_reg_t reg);
+volatile uint16_t* spi_sim_spdr(void);
+volatile uint16_t* spi_sim_udr(uint8_t usart);
+volatile uint16_t* spi_sim_spi0_data(void);
+
+void spi_sim_reset(void);
+void spi_sim_attach(spi_sim_reg_t port, uint8_t pin, spi_sim_slave_fn xfer, spi_sim_release_fn release, void* ctx);
+void spi_sim_attach_usart(uint8_t usart, spi_sim_reg_t port, uint8_t pin, spi_sim_slave_fn xfer, spi_sim_release_fn release, void* ctx);
+void spi_sim_attach_buffered(spi_sim_reg_t port, uint8_t pin, spi_sim_slave_fn xfer, spi_sim_release_fn release, void* ctx);
+void spi_sim_attach_soft(spi_sim_reg_t port, uint8_t pin, uint8_t mode, spi_sim_slave_fn xfer, spi_sim_release_fn release, void* ctx);
+void spi_sim_soft_pins(spi_sim_reg_t sck_port, uint8_t sck, spi_sim_reg_t mosi_port, uint8_t mosi, spi_sim_reg_t miso_port, uint8_t miso);
+void spi_sim_run(uint64_t cycles);
+void spi_sim_run_until_idle(void);
+void spi_sim_sei(void);
+void spi_sim_cli(void);
+uint8_t spi_sim_irq_save(void);
+void spi_sim_irq_restore(uint8_t);
+const spi_sim_stats_t* spi_sim_stats(void);
+void spi_sim_stats_reset(void);
+uint64_t spi_sim_now(void);
+void spi_sim_cycles(uint8_t n);
+void spi_sim_sleep(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+/* Instruction cycles of a driver hot path, see <spi_bus.h> */
+#define SPI_CYCLES(n) spi_sim_cycles(n)
+
+/* Register declarations */
+#define PINA    (*spi_sim_io(SIM_PINA))
+#define DDRA    (*spi_sim_io(SIM_DDRA))
+#define PORTA   (*spi_sim_io(SIM_PORTA))
+#define PINB    (*spi_sim_io(SIM_PINB))
+#define DDRB    (*spi_sim_io(SIM_DDRB))
+#define PORTB   (*spi_sim_io(SIM_PORTB))
+#define PINC    (*spi_sim_io(SIM_PINC))
+#define DDRC    (*spi_sim_io(SIM_DDRC))
+#define PORTC   (*spi_sim_io(SIM_PORTC))
+#define PIND    (*spi_sim_io(SIM_PIND))
+#define DDRD    (*spi_sim_io(SIM_DDRD))
+#define PORTD   (*spi_sim_io(SIM_PORTD))
+#if !SPI_SIM_DX
+#define SPCR    (*spi_sim_io(SIM_SPCR))
+#define SPSR    (*spi_sim_io(SIM_SPSR))
+#define SPDR    (*spi_sim_spdr())
+#endif
+#define UCSR0A  (*spi_sim_io(SIM_UCSR0A))
+#define UCSR0B  (*spi_sim_io(SIM_UCSR0B))
+#define UCSR0C  (*spi_sim_io(SIM_UCSR0C))
+#define UBRR0L  (*spi_sim_io(SIM_UBRR0L))
+#define UBRR0H  (*spi_sim_io(SIM_UBRR0H))
+#define UDR0    (*spi_sim_udr(0))
+#define UCSR1A  (*spi_sim_io(SIM_UCSR1A))
+#define UCSR1B  (*spi_sim_io(SIM_UCSR1B))
+#define UCSR1C  (*spi_sim_io(SIM_UCSR1C))
+#define UBRR1L  (*spi_sim_io(SIM_UBRR1L))
+#define UBRR1H  (*spi_sim_io(SIM_UBRR1H))
+#define UDR1    (*spi_sim_udr(1))
+#define SPI0_CTRLA      (*spi_sim_io(SIM_SPI0_CTRLA))
+#define SPI0_CTRLB      (*spi_sim_io(SIM_SPI0_CTRLB))
+#define SPI0_INTCTRL    (*spi_sim_io(SIM_SPI0_INTCTRL))
+#define SPI0_INTFLAGS   (*spi_sim_io(SIM_SPI0_INTFLAGS))
+#define SPI0_DATA       (*spi_sim_spi0_data())
+#define TCNT1   ((uint16_t)(spi_sim_now() >> 3))   // Timer1 running freely at F_CPU / 8, read only
+
+/* Output register of a port as an address constant, for the static initializer of SPI_DEVICE() */
+#define SPI_PORT_ADDRESS(port_letter) ((volatile uint8_t*)&spi_sim_regs[SIM_PORT##port_letter])
+
+/* SPCR */
+#define SPIE    7
+#define SPE     6
+#define DORD    5
+#define MSTR    4
+#define CPOL    3
+#define CPHA    2
+#define SPR1    1
+#define SPR0    0
+
+/* SPSR */
+#define SPIF    7
+#define WCOL    6
+#define SPI2X   0
+
+/* UCSRnA */
+#define RXC0    7
+#define TXC0    6
+#define UDRE0   5
+#define RXC1    7
+#define TXC1    6
+#define UDRE1   5
+
+/* UCSRnB */
+#define RXCIE0  7
+#define TXCIE0  6
+#define UDRIE0  5
+#define RXEN0   4
+#define TXEN0   3
+#define RXCIE1  7
+#define TXCIE1  6
+#define UDRIE1  5
+#define RXEN1   4
+#define TXEN1   3
+
+/* UCSRnC in master SPI mode */
+#define UMSEL01 7
+#define UMSEL00 6
+#define UDORD0  2
+#define UCPHA0  1
+#define UCPOL0  0
+#define UMSEL11 7
+#define UMSEL10 6
+#define UDORD1  2
+#define UCPHA1  1
+#define UCPOL1  0
+
+/* SPI0_CTRLA */
+#define SPI_DORD_bm     0x40
+#define SPI_MASTER_bm   0x20
+#define SPI_CLK2X_bm    0x10
+#define SPI_PRESC_gm    0x06
+#define SPI_PRESC_gp    1
+#define SPI_ENABLE_bm   0x01
+
+/* SPI0_CTRLB */
+#define SPI_BUFEN_bm    0x80
+#define SPI_BUFWR_bm    0x40
+#define SPI_SSD_bm      0x04
+#define SPI_MODE_gm     0x03
+#define SPI_MODE_gp     0
+
+/* SPI0_INTCTRL */
+#define SPI_RXCIE_bm    0x80
+#define SPI_TXCIE_bm    0x40
+#define SPI_DREIE_bm    0x20
+#define SPI_SSIE_bm     0x10
+#define SPI_IE_bm       0x01
+
+/* SPI0_INTFLAGS in buffered mode */
+#define SPI_RXCIF_bm    0x80
+#define SPI_TXCIF_bm    0x40
+#define SPI_DREIF_bm    0x20
+#define SPI_SSIF_bm     0x10
+#define SPI_BUFOVF_bm   0x01
+
+/* Pins of the buffered SPI, PORTA on the AVR Dx series */
+#define SPI_BUFFERED_MOSI       PORTA4
+#define SPI_BUFFERED_MISO       PORTA5
+#define SPI_BUFFERED_SCK        PORTA6
+#define SPI_BUFFERED_SS         PORTA7
+#define SPI_BUFFERED_PORT       PORTA
+
+/* Port bits */
+#define PORTB0 0
+#define PORTB1 1
+#define PORTB2 2
+#define PORTB3 3
+#define PORTB4 4
+#define PORTB5 5
+#define PORTB6 6
+#define PORTB7 7
+#define PB0 0
+#define PB1 1
+#define PB2 2
+#define PB3 3
+#define PB4 4
+#define PB5 5
+#define PB6 6
+#define PB7 7
+#define DDB0 0
+#define DDB1 1
+#define DDB2 2
+#define DDB3 3
+#define DDB4 4
+#define DDB5 5
+#define DDB6 6
+#define DDB7 7
+#define PINB0 0
+#define PINB1 1
+#define PINB2 2
+#define PINB3 3
+#define PINB4 4
+#define PINB5 5
+#define PINB6 6
+#define PINB7 7
+#define PORTA0 0
+#define PORTA1 1
+#define PORTA2 2
+#define PORTA3 3
+#define PORTA4 4
+#define PORTA5 5
+#define PORTA6 6
+#define PORTA7 7
+#define PA0 0
+#define PA1 1
+#define PA2 2
+#define PA3 3
+#define PA4 4
+#define PA5 5
+#define PA6 6
+#define PA7 7
+#define DDA0 0
+#define DDA1 1
+#define DDA2 2
+#define DDA3 3
+#define DDA4 4
+#define DDA5 5
+#define DDA6 6
+#define DDA7 7
+#define PINA0 0
+#define PINA1 1
+#define PINA2 2
+#define PINA3 3
+#define PINA4 4
+#define PINA5 5
+#define PINA6 6
+#define PINA7 7
+#define PORTC0 0
+#define PORTC1 1
+#define PORTC2 2
+#define PORTC3 3
+#define PORTC4 4
+#define PORTC5 5
+#define PORTC6 6
+#define PORTC7 7
+#define PC0 0
+#define PC1 1
+#define PC2 2
+#define PC3 3
+#define PC4 4
+#define PC5 5
+#define PC6 6
+#define PC7 7
+#define DDC0 0
+#define DDC1 1
+#define DDC2 2
+#define DDC3 3
+#define DDC4 4
+#define DDC5 5
+#define DDC6 6
+#define DDC7 7
+#define PINC0 0
+#define PINC1 1
+#define PINC2 2
+#define PINC3 3
+#define PINC4 4
+#define PINC5 5
+#define PINC6 6
+#define PINC7 7
+#define PORTD0 0
+#define PORTD1 1
+#define PORTD2 2
+#define PORTD3 3
+#define PORTD4 4
+#define PORTD5 5
+#define PORTD6 6
+#define PORTD7 7
+#define PD0 0
+#define PD1 1
+#define PD2 2
+#define PD3 3
+#define PD4 4
+#define PD5 5
+#define PD6 6
+#define PD7 7
+#define DDD0 0
+#define DDD1 1
+#define DDD2 2
+#define DDD3 3
+#define DDD4 4
+#define DDD5 5
+#define DDD6 6
+#define DDD7 7
+#define PIND0 0
+#define PIND1 1
+#define PIND2 2
+#define PIND3 3
+#define PIND4 4
+#define PIND5 5
+#define PIND6 6
+#define PIND7 7
+
+#endif /* SPI_SIM_H_ */
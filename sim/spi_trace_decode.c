@@ -0,0 +1,299 @@
+/*************************************************************************
+* Title     : SPI Trace Decoder
+* Author    : Dimitri Dening
+* Created   : 17.10.2026 20:46:30
+* Software  : GCC (host)
+* Hardware  : -
+
+DESCRIPTION:
+    Turns dumps of <spi_trace.h> into a timeline and latency histograms.
+USAGE:
+    Reads the "[spi trace]:" hex lines of spi_trace_report() from a UART
+    log, or with -b the raw frames of spi_trace_dump():
+
+        gcc -std=c99 -O2 -I. sim/spi_trace_decode.c -o spi_trace_decode
+        ./spi_trace_decode uart.log
+        ./spi_trace_decode -b dump.bin
+
+    Prints every event with its time and the ticks since the previous one,
+    then per device the histograms from submission to chip select and from
+    chip select to release, in power of two buckets of SPI_TRACE_TIME() ticks.
+NOTES:
+    Includes <spi_trace.h> on its own for the event codes and the frame
+    layout, the tool does not link against the driver. The 16 bit stamps
+    are unwrapped assuming that consecutive events are less than one timer
+    period apart. Every frame starts a new timeline. Submissions are paired
+    with chip selects in order per device, transactions of one device that
+    overtake each other by priority are paired in submission order.
+*************************************************************************/
+
+/* General libraries */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+/* User defined libraries */
+#include "spi_trace.h"
+
+#define HEADER_BYTES    6
+#define ENTRY_BYTES     5
+#define DEVICES         256
+#define PENDING         64      // Submissions per device waiting for their chip select
+#define BUCKETS         18      // 0, 1, 2..3, ... 65536 and above
+#define BAR_WIDTH       40
+
+typedef struct {
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t sum;
+    uint32_t buckets[BUCKETS];
+} histogram_t;
+
+typedef struct {
+    uint32_t submitted[PENDING];
+    uint8_t head;
+    uint8_t tail;
+    uint32_t asserted;
+    uint8_t busy;
+    histogram_t wait;           // Submission to chip select
+    histogram_t active;         // Chip select to release
+} device_log_t;
+
+static device_log_t devices[DEVICES];
+
+static const char* const event_names[] = {
+    "submit", "cs_assert", "segment", "cs_release", "done", "error", "mark"
+};
+
+static uint8_t* data;
+static size_t length;
+static size_t capacity;
+
+static void append(uint8_t byte) {
+
+    if (length == capacity) {
+        capacity = capacity ? 2 * capacity : 1024;
+        data = realloc(data, capacity);
+        if (data == NULL) {
+            fprintf(stderr, "out of memory\n");
+            exit(1);
+        }
+    }
+
+    data[length++] = byte;
+}
+
+static int hex_digit(int c) {
+
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+
+    return -1;
+}
+
+/* Collects the hex digits behind every "[spi trace]:" tag, other lines of the log are skipped */
+static void read_text(FILE* file) {
+
+    static const char tag[] = "[spi trace]:";
+    char line[512];
+
+    while (fgets(line, sizeof(line), file) != NULL) {
+
+        char* hex = strstr(line, tag);
+
+        if (hex == NULL) continue;
+
+        hex += sizeof(tag) - 1;
+
+        while (isspace((unsigned char)*hex)) hex++;
+
+        while (hex_digit(hex[0]) >= 0 && hex_digit(hex[1]) >= 0) {
+            append((uint8_t)(hex_digit(hex[0]) << 4 | hex_digit(hex[1])));
+            hex += 2;
+        }
+    }
+}
+
+static void read_binary(FILE* file) {
+
+    int c;
+
+    while ((c = fgetc(file)) != EOF) append((uint8_t)c);
+}
+
+static void histogram_add(histogram_t* histogram, uint32_t ticks) {
+
+    uint8_t bucket = 0;
+
+    while (bucket < BUCKETS - 1 && ticks >= (1UL << bucket)) bucket++;
+
+    if (histogram->count == 0 || ticks < histogram->min) histogram->min = ticks;
+    if (ticks > histogram->max) histogram->max = ticks;
+
+    histogram->count++;
+    histogram->sum += ticks;
+    histogram->buckets[bucket]++;
+}
+
+static void histogram_print(unsigned device, const char* name, const histogram_t* histogram) {
+
+    uint32_t peak = 0;
+
+    if (histogram->count == 0) return;
+
+    printf("latency dev=%u %s n=%lu min=%lu mean=%lu max=%lu\n", device, name,
+        (unsigned long)histogram->count, (unsigned long)histogram->min,
+        (unsigned long)(histogram->sum / histogram->count), (unsigned long)histogram->max);
+
+    for (uint8_t i = 0; i < BUCKETS; i++) {
+        if (histogram->buckets[i] > peak) peak = histogram->buckets[i];
+    }
+
+    for (uint8_t i = 0; i < BUCKETS; i++) {
+
+        if (histogram->buckets[i] == 0) continue;
+
+        unsigned long low = (i == 0) ? 0 : 1UL << (i - 1);
+        unsigned bar = (unsigned)((histogram->buckets[i] * BAR_WIDTH + peak - 1) / peak);
+
+        if (i == BUCKETS - 1) printf("  %8lu.. %8s", low, "");
+        else printf("  %8lu.. %8lu", low, (1UL << i) - 1);
+        printf(" %6lu ", (unsigned long)histogram->buckets[i]);
+
+        for (unsigned j = 0; j < bar; j++) putchar('#');
+
+        putchar('\n');
+    }
+}
+
+static void pair(uint8_t event, uint8_t device, uint32_t time) {
+
+    device_log_t* log = &devices[device];
+
+    switch (event) {
+
+        case SPI_TRACE_SUBMIT:
+            /* A full queue of a device drops its oldest submission */
+            if ((uint8_t)(log->head - log->tail) == PENDING) log->tail++;
+            log->submitted[log->head++ % PENDING] = time;
+            break;
+
+        case SPI_TRACE_CS_ASSERT:
+            if (log->head != log->tail) histogram_add(&log->wait, time - log->submitted[log->tail++ % PENDING]);
+            log->asserted = time;
+            log->busy = 1;
+            break;
+
+        case SPI_TRACE_CS_RELEASE:
+            if (log->busy) histogram_add(&log->active, time - log->asserted);
+            log->busy = 0;
+            break;
+
+        default:
+            break;
+    }
+}
+
+/* Decodes one frame, returns the bytes it took or 0 if there is no complete frame at the position */
+static size_t decode_frame(const uint8_t* frame, size_t available) {
+
+    if (available < HEADER_BYTES || frame[0] != 'S' || frame[1] != 'T') return 0;
+
+    uint8_t count = frame[3];
+    unsigned lost = frame[4] | frame[5] << 8;
+
+    if (frame[2] != SPI_TRACE_VERSION) {
+        fprintf(stderr, "unknown trace version %u\n", frame[2]);
+        return 0;
+    }
+
+    if (available < HEADER_BYTES + (size_t)count * ENTRY_BYTES) return 0;
+
+    printf("frame entries=%u lost=%u\n", count, lost);
+    printf("%10s %8s %4s %-10s %s\n", "time", "delta", "dev", "event", "arg");
+
+    /* Pending submissions don't carry over, the gap between two dumps is unknown */
+    for (unsigned i = 0; i < DEVICES; i++) {
+        devices[i].head = devices[i].tail = 0;
+        devices[i].busy = 0;
+    }
+
+    uint32_t time = 0;
+    uint16_t last = 0;
+
+    for (uint8_t i = 0; i < count; i++) {
+
+        const uint8_t* entry = frame + HEADER_BYTES + (size_t)i * ENTRY_BYTES;
+        uint16_t stamp = (uint16_t)(entry[0] | entry[1] << 8);
+        uint8_t event = entry[2];
+        uint8_t device = entry[3];
+        uint8_t arg = entry[4];
+        uint16_t delta = (i == 0) ? 0 : (uint16_t)(stamp - last);
+
+        time += delta;
+        last = stamp;
+
+        printf("%10lu %8u ", (unsigned long)time, delta);
+
+        if (device == SPI_TRACE_NO_DEVICE) printf("%4s ", "-");
+        else printf("%4u ", device);
+
+        if (event < sizeof(event_names) / sizeof(event_names[0])) printf("%-10s %u\n", event_names[event], arg);
+        else printf("%-10u %u\n", event, arg);
+
+        pair(event, device, time);
+    }
+
+    return HEADER_BYTES + (size_t)count * ENTRY_BYTES;
+}
+
+int main(int argc, char** argv) {
+
+    int binary = 0;
+    const char* path = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-b") == 0) binary = 1;
+        else path = argv[i];
+    }
+
+    FILE* file = (path == NULL) ? stdin : fopen(path, binary ? "rb" : "r");
+
+    if (file == NULL) {
+        fprintf(stderr, "can't open %s\n", path);
+        return 1;
+    }
+
+    if (binary) read_binary(file);
+    else read_text(file);
+
+    if (file != stdin) fclose(file);
+
+    size_t position = 0;
+    unsigned frames = 0;
+
+    while (position < length) {
+
+        size_t used = decode_frame(data + position, length - position);
+
+        if (used == 0) {
+            fprintf(stderr, "no trace frame at byte %lu\n", (unsigned long)position);
+            break;
+        }
+
+        position += used;
+        frames++;
+    }
+
+    for (unsigned i = 0; i < DEVICES; i++) {
+        histogram_print(i, "submit_to_cs", &devices[i].wait);
+        histogram_print(i, "cs_to_release", &devices[i].active);
+    }
+
+    free(data);
+
+    return frames == 0;
+}
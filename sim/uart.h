@@ -0,0 +1,20 @@
+/*************************************************************************
+* Title		: <uart.h> shim for host builds
+* Author	: Dimitri Dening
+* Created	: 17.10.2026 09:12:40
+* Software	: GCC (host)
+* Hardware	: Simulated ATmega1284P
+* License	: MIT License
+*
+* NOTES:
+*	Stands in for the libAVR UART driver and prints to stdout.
+*************************************************************************/
+#ifndef SIM_UART_H_
+#define SIM_UART_H_
+
+#include <stdio.h>
+
+#define uart_init()         ((void)0)
+#define uart_put(fmt, ...)  printf(fmt "\r\n", ##__VA_ARGS__)
+
+#endif /* SIM_UART_H_ */
@@ -0,0 +1,25 @@
+/*************************************************************************
+* Title		: <util/atomic.h> shim for host builds
+* Author	: Dimitri Dening
+* Created	: 17.10.2026 11:31:09
+* Software	: GCC (host)
+* Hardware	: Simulated ATmega1284P
+* License	: MIT License
+*
+* NOTES:
+*	ATOMIC_BLOCK() saves and clears the simulated global interrupt flag
+*	and restores it when the block is left.
+*************************************************************************/
+#ifndef SIM_UTIL_ATOMIC_H_
+#define SIM_UTIL_ATOMIC_H_
+
+#include "../spi_sim.h"
+
+#define ATOMIC_RESTORESTATE 0
+#define ATOMIC_FORCEON      1
+
+#define ATOMIC_BLOCK(type)                                                              \
+    for (uint8_t _sreg_save = spi_sim_irq_save(), _todo = 1; _todo;                     \
+         spi_sim_irq_restore((type) == ATOMIC_FORCEON ? 1 : _sreg_save), _todo = 0)
+
+#endif /* SIM_UTIL_ATOMIC_H_ */
@@ -0,0 +1,21 @@
+/*************************************************************************
+* Title		: <util/delay.h> shim for host builds
+* Author	: Dimitri Dening
+* Created	: 17.10.2026 09:12:40
+* Software	: GCC (host)
+* Hardware	: Simulated ATmega1284P
+* License	: MIT License
+*
+* NOTES:
+*	Delays advance the simulated clock, so pending SPI interrupts are
+*	serviced while the caller waits.
+*************************************************************************/
+#ifndef SIM_UTIL_DELAY_H_
+#define SIM_UTIL_DELAY_H_
+
+#include "../spi_sim.h"
+
+#define _delay_ms(ms)   spi_sim_run((uint64_t)((ms) * (F_CPU / 1000UL)))
+#define _delay_us(us)   spi_sim_run((uint64_t)((us) * (F_CPU / 1000000UL)))
+
+#endif /* SIM_UTIL_DELAY_H_ */
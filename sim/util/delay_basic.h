@@ -0,0 +1,20 @@
+/*************************************************************************
+* Title		: <util/delay_basic.h> shim for host builds
+* Author	: Dimitri Dening
+* Created	: 17.10.2026 22:58:36
+* Software	: GCC (host)
+* Hardware	: Simulated ATmega1284P
+* License	: MIT License
+*
+* NOTES:
+*	A delay loop iteration takes three cycles, a count of 0 runs 256
+*	iterations like on the target. Interrupts are serviced meanwhile.
+*************************************************************************/
+#ifndef SIM_UTIL_DELAY_BASIC_H_
+#define SIM_UTIL_DELAY_BASIC_H_
+
+#include "../spi_sim.h"
+
+#define _delay_loop_1(count)    spi_sim_run(3u * ((count) ? (uint16_t)(count) : 256u))
+
+#endif /* SIM_UTIL_DELAY_BASIC_H_ */
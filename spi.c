@@ -15,257 +15,993 @@ NOTES:
 
 /* General libraries */
 #include <avr/interrupt.h>
+#include <util/atomic.h>
 
 /* User defined libraries */
 #include "spi.h"
+#include "spi_bus.h"
+
+#if SPI_NATIVE
 
 #define SPI_ENABLE() (SPCR = (1 << SPE))
 #define SPI_DISABLE() (SPCR &= ~(1 << SPE))
-#define SPI_ISR_ENABLE() (SPCR = (1 << SPIE))
+#define SPI_ISR_ENABLE() (SPCR |= (1 << SPIE))
 #define SPI_ISR_DISABLE() (SPCR &= ~(1 << SPIE))
+#define SPI_CS_ASSERT(dev) (*(dev)->port &= ~(dev)->mask)   /* Pull down := active */
+#define SPI_CS_RELEASE(dev) (*(dev)->port |= (dev)->mask)   /* Pull up := inactive */
+#define SPI_WAIT() while (!(SPSR & (1 << SPIF)))
+
+/* Fill byte the native SPI shifts out, a constant with SPI_FIXED_FILL */
+#if SPI_FIXED_FILL
+#define SPI_NATIVE_FILL(bus) SPI_FILL_BYTE
+#else
+#define SPI_NATIVE_FILL(bus) ((bus)->fill)
+#endif
+
+static void spi_native_init(spi_bus_t*, const device_t*);
+static uint8_t spi_native_pin_used(volatile uint8_t*, uint8_t);
+static uint16_t spi_native_configure(device_t*, data_order_t, spi_mode_t, uint32_t);
+static uint8_t spi_native_start(spi_bus_t*);
+static void spi_native_poll(spi_bus_t*, spi_transaction_t*);
 
-typedef enum {
-    SPI_ACTIVE,
-    SPI_INACTIVE
-} SPI_STATE_T;
+static const spi_bus_ops_t spi_native_ops = {
+    .init = spi_native_init,
+    .pin_used = spi_native_pin_used,
+    .configure = spi_native_configure,
+    .start = spi_native_start,
+    .poll = spi_native_poll
+};
 
-static SPI_STATE_T SPI_STATE;
+/* The native SPI bus */
+static spi_bus_t spi0 = { .ops = &spi_native_ops };
 
-static queue_t q;
+#endif /* SPI_NATIVE */
 
-static queue_t* queue = NULL;
+/* The native SPI as the only bus is called directly, which lets the compiler inline its operations */
+#if !SPI_NATIVE || SPI_MSPIM_USART0 || SPI_MSPIM_USART1 || SPI_SOFT || SPI_BUFFERED
+#define SPI_BUS_OPS(bus) ((bus)->ops)
+#else
+#define SPI_BUS_OPS(bus) (&spi_native_ops)
+#endif
 
-static payload_t* payload = NULL;
+spi_config_t spi_config = {
+    .data_order = SPI_DEFAULT_DATA_ORDER,
+    .mode = SPI_DEFAULT_MODE,
+    .clockrate = SPI_DEFAULT_CLOCK_RATE,
+    .poll_threshold = SPI_POLL_THRESHOLD,
+    .fill_byte = SPI_FILL_BYTE
+};
 
-static device_t* device = NULL;
+/* Initialized buses by spi_bus_id_t */
+static spi_bus_t* buses[SPI_NR_BUSES];
 
+static device_t devices[SPI_MAX_DEVICES];
+
+#if SPI_NATIVE
 static uint8_t dump;
-  
-spi_error_t spi_init(spi_config_t* config){
+#endif
+
+/* SCK divider per clock_rate_t */
+static const uint8_t clock_divider[] = { 4, 16, 64, 128, 2, 8, 32, 64 };
+
+#if SPI_NATIVE
+
+/* Clock rates ordered from fastest to slowest */
+static const clock_rate_t clock_rates[] = {
+    SPI_CLOCK_DIV2, SPI_CLOCK_DIV4, SPI_CLOCK_DIV8, SPI_CLOCK_DIV16,
+    SPI_CLOCK_DIV32, SPI_CLOCK_DIV64, SPI_CLOCK_DIV128
+};
+
+/* Fastest clock rate whose SCK does not exceed max_frequency */
+static clock_rate_t spi_clock_rate(uint32_t max_frequency){
+    
+    for (uint8_t i = 0; i < sizeof(clock_rates) / sizeof(clock_rates[0]); i++) {
+        if (F_CPU / clock_divider[clock_rates[i]] <= max_frequency) return clock_rates[i];
+    }
+    
+    return SPI_CLOCK_DIV128;
+}
+
+#endif /* SPI_NATIVE */
+
+/* Longest transfer in bytes that is sent polled on a bus with the given byte time, see SPI_POLL_THRESHOLD */
+static uint8_t spi_poll_policy(const spi_bus_t* bus, uint16_t byte_cycles){
+    
+    if (bus->defaults.poll_threshold == 0) return 0;
+    
+    if (bus->defaults.poll_threshold == UINT32_MAX) return UINT8_MAX;
+    
+    /* Longest transfer that blocks for at most the threshold */
+    uint32_t max_bytes = bus->defaults.poll_threshold / byte_cycles;
+    
+    /* Longest transfer whose bus time stays below the cost of the interrupt engine */
+    if (byte_cycles > SPI_POLL_BYTE_CYCLES) {
+        
+        uint32_t cheaper = SPI_POLL_START_CYCLES / (byte_cycles - SPI_POLL_BYTE_CYCLES);
         
+        if (cheaper < max_bytes) max_bytes = cheaper;
+    }
+    
+    return (max_bytes >= UINT8_MAX) ? UINT8_MAX : (uint8_t)max_bytes;
+}
+
+#if SPI_NATIVE
+
+/* Resolves a device to its SPCR/SPSR values, the same ones SPI_DEVICE() folds at compile time */
+static uint16_t spi_native_configure(device_t* _device, data_order_t data_order, spi_mode_t mode, uint32_t frequency){
+    
+    clock_rate_t clockrate = spi_clock_rate(frequency);
+    
+    _device->ctrl = SPI_NATIVE_CTRL(data_order, mode, clockrate);
+    _device->rate = SPI_NATIVE_RATE(clockrate);
+    
+    return 8 * clock_divider[clockrate];
+}
+
+static uint8_t spi_native_pin_used(volatile uint8_t* port, uint8_t pin){
+    return port == &SPI_PORT && (pin == SPI_SCK || pin == SPI_MOSI || pin == SPI_MISO);
+}
+
+static void spi_native_init(spi_bus_t* bus, const device_t* defaults){
+    
     /* Set MOSI and SCK output, all others input */
     SPI_DDR = (1 << SPI_SCK) | (1 << SPI_MOSI);
     
     /* Make sure the MISO pin is input */
     SPI_DDR &= ~(1 << SPI_MISO);
-       
-    /* Enable SPI Interrupt Flag, SPI, Data Order, Master Mode, SPI Mode */	
-    SPCR = (1 << SPIE) | (1 << SPE) | (config->data_order << DORD) | (1 << MSTR) | (config->mode << CPHA);
-    
-    /* Set Clock Rate */
-    switch (config->clockrate){
-        case SPI_CLOCK_DIV4:
-        case SPI_CLOCK_DIV16:
-        case SPI_CLOCK_DIV64:
-        case SPI_CLOCK_DIV128:
-            SPCR |= (config->clockrate << SPR0);
-            SPSR &= ~(1 << SPI2X);
-            break;
-        case SPI_CLOCK_DIV2:
-        case SPI_CLOCK_DIV8:
-        case SPI_CLOCK_DIV32:
-        case SPI_CLOCK_DIV64X:
-            SPCR |= ((config->clockrate - 0x04) << SPR0);
-            SPSR |= (1 << SPI2X);
-            break;
-     }
     
-    SPI_STATE = SPI_INACTIVE;
+    bus->ctrl = defaults->ctrl;
+    bus->rate = defaults->rate;
     
-    queue = queue_init(&q);
-
-    // sei(); // global interrupt enable
-    
-    return SPI_NO_ERROR;
+    SPCR = bus->ctrl;
+    SPSR = (uint8_t)bus->rate;
 }
 
-static spi_error_t spi_enable_device(device_t* _device){
+static void spi_native_enable(spi_bus_t* bus, device_t* _device){
     
-    if (_device->port == device->port) return SPI_NO_ERROR;
+    if (!spi_bus_select(bus, _device)) return;
     
-    device = _device;
+    /* Only touch the registers if mode, bit order or clock rate actually change */
+    if (_device->ctrl != bus->ctrl) {
+        bus->ctrl = _device->ctrl;
+        SPCR = bus->ctrl;
+    }
     
-    /* Pin configuration for the new device */
-    SPI_DDR  |= (1 << device->ddr);  // @Output
-    SPI_PORT |= (1 << device->port); // Pull up := inactive
+    if (_device->rate != bus->rate) {
+        bus->rate = _device->rate;
+        SPSR = (uint8_t)bus->rate;
+    }
     
     /* Re-enable Master Mode again if it got reset by setting a device pin as input by accident. */
     if (!(SPCR & (1 << MSTR))) SPCR |= (1 << MSTR); 
+}
+
+#endif /* SPI_NATIVE */
 
+static spi_bus_t* spi_bus_of(spi_bus_id_t id){
+    
+#if SPI_NATIVE
+    if (id == SPI_BUS_SPI) return &spi0;
+#endif
+    
+#if SPI_SOFT
+    if (id == SPI_BUS_SOFT) return spi_soft_bus();
+#endif
+    
+#if SPI_BUFFERED
+    if (id == SPI_BUS_BUFFERED) return spi_buffered_bus();
+#endif
+    
+#if SPI_MSPIM_USART0 || SPI_MSPIM_USART1
+    if (id < SPI_NR_BUSES) return spi_mspim_bus(id);
+#endif
+    
+    return NULL;
+}
+
+spi_error_t spi_bus_init(spi_bus_id_t id, spi_config_t* config){
+    
+    spi_bus_t* bus = spi_bus_of(id);
+    device_t defaults;
+    
+    if (bus == NULL) return error_handler(SPI_ERR_INVALID_PORT);
+    
+#if SPI_NATIVE && SPI_FIXED_FILL
+    if (bus == &spi0 && config->fill_byte != SPI_FILL_BYTE) return error_handler(SPI_ERR_INVALID_PORT);
+#endif
+    
+    bus->defaults = *config;
+    bus->device = NULL;
+    bus->transaction = NULL;
+    bus->state = SPI_INACTIVE;
+    
+    spi_queue_init(&bus->queue);
+    
+#if SPI_STATS
+    memset(&bus->stats, 0, sizeof(bus->stats));
+    bus->stats_time = SPI_STATS_TIME();
+    bus->stats_busy = 0;
+#endif
+    
+    SPI_BUS_OPS(bus)->configure(&defaults, config->data_order, config->mode, F_CPU / clock_divider[config->clockrate]);
+    SPI_BUS_OPS(bus)->init(bus, &defaults);
+    
+    buses[id] = bus;
+    
     return SPI_NO_ERROR;
 }
+  
+spi_error_t spi_init(spi_config_t* config){
+    
+    spi_payload_pool_init();
+    
+    spi_completion_init();
+    
+    // sei(); // global interrupt enable
+    
+    return spi_bus_init(SPI_BUS_SPI, config);
+}
 
-device_t* spi_create_device(uint8_t pin, uint8_t port, uint8_t ddr){
+device_t* spi_create_device(volatile uint8_t* port, uint8_t pin, const spi_device_config_t* config){
+    
+    spi_bus_id_t id = (config == NULL) ? SPI_BUS_SPI : config->bus;
+    
+    if (id >= SPI_NR_BUSES || buses[id] == NULL) return NULL;
+    
+    spi_bus_t* bus = buses[id];
+    
+#if SPI_NATIVE && SPI_FIXED_FILL
+    if (bus == &spi0 && config != NULL && config->fill_byte != SPI_FILL_BYTE) return NULL;
+#endif
     
-    if (port == SPI_SCK || port == SPI_MOSI || port == SPI_MISO) {
-        return NULL;
+    /* The pins of every bus in use are reserved */
+    for (uint8_t i = 0; i < SPI_NR_BUSES; i++) {
+        if (buses[i] != NULL && SPI_BUS_OPS(buses[i])->pin_used(port, pin)) return NULL;
     }
     
-    device_t* device = (device_t*) malloc(sizeof(device_t));
+    device_t* _device = NULL;
     
-    device->pin = pin;
-    device->port = port;
-    device->ddr = ddr;
+    for (uint8_t i = 0; i < SPI_MAX_DEVICES; i++) {
+        if (devices[i].port == NULL) {
+            _device = &devices[i];
+#if SPI_TRACE
+            _device->id = i;
+#endif
+            break;
+        }
+    }
+    
+    if (_device == NULL) return NULL;
+    
+    _device->port = port;
+    _device->mask = (1 << pin);
+    _device->bus = bus;
     
-    SPI_PORT |= (1 << port); // Pull up := inactive
-    SPI_DDR  |= (1 << ddr);  // @Output
+#if SPI_STATS
+    memset(&_device->stats, 0, sizeof(_device->stats));
+#endif
+    
+    uint16_t byte_cycles;
+    
+    if (config == NULL) {
+        byte_cycles = SPI_BUS_OPS(bus)->configure(_device, bus->defaults.data_order, bus->defaults.mode, F_CPU / clock_divider[bus->defaults.clockrate]);
+        _device->fill = bus->defaults.fill_byte;
+    }
+    else if (config->max_frequency == 0) {
+        byte_cycles = SPI_BUS_OPS(bus)->configure(_device, config->data_order, config->mode, F_CPU / clock_divider[bus->defaults.clockrate]);
+        _device->fill = config->fill_byte;
+    }
+    else {
+        byte_cycles = SPI_BUS_OPS(bus)->configure(_device, config->data_order, config->mode, config->max_frequency);
+        _device->fill = config->fill_byte;
+    }
+    
+    _device->poll_max_bytes = spi_poll_policy(bus, byte_cycles);
+    
+    *port |= _device->mask;             // Pull up := inactive
+    *SPI_DDR_OF(port) |= _device->mask; // @Output
         
-    return device;
+    return _device;
+}
+
+spi_error_t spi_add_device(device_t* _device){
+    
+#if SPI_NATIVE
+    spi_bus_t* bus = buses[SPI_BUS_SPI];
+    
+    if (bus == NULL || _device == NULL || _device->port == NULL) return error_handler(SPI_ERR_INVALID_PORT);
+    
+#if SPI_FIXED_FILL
+    if (_device->fill != SPI_FILL_BYTE) return error_handler(SPI_ERR_INVALID_PORT);
+#endif
+    
+    volatile uint8_t* port = _device->port;
+    
+    _device->bus = bus;
+    
+#if SPI_STATS
+    memset(&_device->stats, 0, sizeof(_device->stats));
+#endif
+    
+#if SPI_TRACE
+    /* Devices outside of the table are numbered after it */
+    static uint8_t added;
+    _device->id = SPI_MAX_DEVICES + added++;
+#endif
+    
+    clock_rate_t clockrate = ((_device->ctrl >> SPR0) & 0x03) | ((_device->rate & (1 << SPI2X)) ? 0x04 : 0);
+    
+    _device->poll_max_bytes = spi_poll_policy(bus, 8 * clock_divider[clockrate]);
+    
+    *port |= _device->mask;             // Pull up := inactive
+    *SPI_DDR_OF(port) |= _device->mask; // @Output
+    
+    return SPI_NO_ERROR;
+#else
+    /* Devices of SPI_DEVICE() belong to the native SPI */
+    (void)_device;
+    
+    return error_handler(SPI_ERR_INVALID_PORT);
+#endif
 }
 
 spi_error_t spi_free_device(device_t* _device){
     
-    free(_device);
+    if (_device->bus != NULL && _device->bus->device == _device) _device->bus->device = NULL;
+    
+    _device->bus = NULL;
     
-    device = NULL;
+    /* Gives the table entry back, devices of SPI_DEVICE() keep their port for spi_add_device() */
+    if (_device >= devices && _device < devices + SPI_MAX_DEVICES) _device->port = NULL;
     
     return SPI_NO_ERROR;
 }
 
-static spi_error_t _spi(void) {
+#if SPI_NATIVE
+
+static void spi_poll_write(const uint8_t* data, uint8_t number_of_bytes){
+    
+    uint8_t a, b;
+    
+    SPDR = *data++;
+    number_of_bytes--;
+    
+    while (number_of_bytes >= 2) {
+        a = *data++;
+        b = *data++;
+        SPI_WAIT();
+        SPDR = a;
+        SPI_WAIT();
+        SPDR = b;
+        number_of_bytes -= 2;
+    }
+    
+    if (number_of_bytes) {
+        a = *data;
+        SPI_WAIT();
+        SPDR = a;
+    }
+    
+    SPI_WAIT();
+    dump = SPDR; // Clears SPIF before the interrupt is enabled again
+}
+
+static void spi_poll_duplex(const uint8_t* data, uint8_t* container, uint8_t number_of_bytes){
+    
+    uint8_t a, b;
+    
+    SPDR = *data++;
+    number_of_bytes--;
+    
+    /* The receive buffer holds the previous byte until the next one is complete, so SPDR is reloaded first */
+    while (number_of_bytes >= 2) {
+        a = *data++;
+        b = *data++;
+        SPI_WAIT();
+        SPDR = a;
+        *container++ = SPDR;
+        SPI_WAIT();
+        SPDR = b;
+        *container++ = SPDR;
+        number_of_bytes -= 2;
+    }
+    
+    if (number_of_bytes) {
+        a = *data;
+        SPI_WAIT();
+        SPDR = a;
+        *container++ = SPDR;
+    }
+    
+    SPI_WAIT();
+    *container = SPDR;
+}
+
+/* Clocks out the fill byte without touching a tx buffer */
+static void spi_poll_receive(uint8_t* container, uint8_t number_of_bytes){
+    
+    uint8_t fill = SPI_NATIVE_FILL(&spi0);
+    
+    SPDR = fill;
+    
+    while (--number_of_bytes) {
+        SPI_WAIT();
+        SPDR = fill;
+        *container++ = SPDR;
+    }
+    
+    SPI_WAIT();
+    *container = SPDR;
+}
+
+static void spi_poll_fill(uint8_t number_of_bytes){
+    
+    uint8_t fill = SPI_NATIVE_FILL(&spi0);
+    
+    SPDR = fill;
+    
+    while (--number_of_bytes) {
+        SPI_WAIT();
+        SPDR = fill;
+    }
+    
+    SPI_WAIT();
+    dump = SPDR;
+}
+
+/* Polled transactions are at most poll_max_bytes long, so every segment fits the 8 bit loops */
+static void spi_poll_segment(const spi_segment_t* _segment){
+    
+    uint8_t number_of_bytes = (uint8_t)_segment->length;
+    
+    if (number_of_bytes == 0) return;
+    
+    if (_segment->tx != NULL) {
+        if (_segment->rx != NULL) spi_poll_duplex(_segment->tx, _segment->rx, number_of_bytes);
+        else spi_poll_write(_segment->tx, number_of_bytes);
+    }
+    else {
+        if (_segment->rx != NULL) spi_poll_receive(_segment->rx, number_of_bytes);
+        else spi_poll_fill(number_of_bytes);
+    }
+}
+
+static void spi_native_poll(spi_bus_t* bus, spi_transaction_t* _transaction){
+    
+    spi_native_enable(bus, _transaction->device);
+    
+    SPI_ISR_DISABLE();
+    
+    SPI_CS_ASSERT(bus->device);
+    
+    spi_trace(SPI_TRACE_CS_ASSERT, _transaction->device, 1);
+    
+    for (uint8_t i = 0; i < _transaction->nr_segments; i++) {
+        spi_poll_segment(&_transaction->segments[i]);
+    }
+    
+    SPI_CS_RELEASE(bus->device);
+    
+    spi_trace(SPI_TRACE_CS_RELEASE, _transaction->device, 0);
+    
+    SPI_ISR_ENABLE();
+    
+    spi_transaction_done(_transaction, SPI_NO_ERROR);
+}
+
+/* Shifts out the next byte of the current segment */
+static void spi_native_send(spi_bus_t* bus){
+    
+    bus->tx.remaining--;
+    
+    SPDR = (bus->tx.tx != NULL) ? *bus->tx.tx++ : SPI_NATIVE_FILL(bus);
+}
+
+static uint8_t spi_native_start(spi_bus_t* bus){
+    
+    if (!spi_bus_dequeue(bus)) return 0;
+    
+    spi_native_enable(bus, bus->transaction->device);
+    
+    SPI_CS_ASSERT(bus->device);
+    
+    spi_native_send(bus);
+    
+    spi_trace(SPI_TRACE_CS_ASSERT, bus->device, 0);
+    
+    return 1;
+}
+
+#endif /* SPI_NATIVE */
+
+/* Bus bytes of a transaction, saturated at UINT8_MAX + 1 since only the poll policy needs it */
+static uint16_t spi_transaction_length(const spi_transaction_t* _transaction){
+    
+    uint16_t number_of_bytes = 0;
+    
+    for (uint8_t i = 0; i < _transaction->nr_segments && number_of_bytes <= UINT8_MAX; i++) {
+        
+#if SPI_LENGTH_BITS > 8
+        if (_transaction->segments[i].length > UINT8_MAX) return UINT8_MAX + 1;
+#endif
+        
+        number_of_bytes += (uint16_t)_transaction->segments[i].length;
+    }
+    
+    return number_of_bytes;
+}
+
+/* Transactions are polled if nothing is in flight on their bus and the bus time stays below the interrupt overhead */
+static uint8_t spi_poll_eligible(spi_bus_t* bus, const spi_transaction_t* _transaction){
+    return bus->state == SPI_INACTIVE && spi_queue_empty(&bus->queue) && spi_transaction_length(_transaction) <= _transaction->device->poll_max_bytes;
+}
+
+/* 
+ * The state hands the consumer side of the queue over: an inactive bus is consumed here, an
+ * active one by its interrupt, which only turns it inactive after it found the queue empty.
+ * The transaction was published before the state is read, so either the interrupt still sees it
+ * or the bus is inactive and it is started here. No interrupt has to be masked for this.
+ */
+static void _spi(spi_bus_t* bus) {
        
-    /* If the SPI is not active right now, it is save to transmit the next dataword from the queue. */
-    if (SPI_STATE == SPI_INACTIVE) {
-              
-        payload = queue_dequeue(queue);
+    if (bus->state == SPI_INACTIVE) {
+        
+        bus->state = SPI_ACTIVE;
+        
+        if (!SPI_BUS_OPS(bus)->start(bus)) bus->state = SPI_INACTIVE;
+    }
+}
+
+spi_handle_t spi_transfer(spi_transaction_t* _transaction){
+    
+    /* A pooled transaction can be reused as soon as it completed, so the handle is kept here */
+    spi_handle_t handle = spi_completion_acquire();
+    
+    _transaction->handle = handle;
+    
+    /* Nobody could wait for an untracked transaction, so it is not queued */
+    if (handle == SPI_HANDLE_NONE) {
+        spi_transaction_done(_transaction, error_handler(SPI_ERR_BUFFER_OVERFLOW));
+        return handle;
+    }
+    
+    if (_transaction->device == NULL || _transaction->device->bus == NULL) {
+        spi_transaction_done(_transaction, error_handler(SPI_ERR_INVALID_PORT));
+        return handle;
+    }
+    
+    spi_bus_t* bus = _transaction->device->bus;
+    
+    spi_stats_submit(_transaction);
+    
+    spi_trace(SPI_TRACE_SUBMIT, _transaction->device, _transaction->priority);
+    
+    if (spi_poll_eligible(bus, _transaction)) {
+        spi_stats_start(bus, _transaction);
+        SPI_BUS_OPS(bus)->poll(bus, _transaction);
+        spi_stats_done(bus);
+        return handle;
+    }
+    
+    if (spi_queue_enqueue(&bus->queue, _transaction) != SPI_NO_ERROR) {
+        spi_transaction_done(_transaction, error_handler(SPI_ERR_BUFFER_OVERFLOW));
+        return handle;
+    }
+    
+    spi_stats_queued(bus);
+    
+    _spi(bus);
+    
+    return handle;
+}
+
+spi_error_t spi_submit_batch(spi_transaction_t* const transactions[], uint8_t count, spi_handle_t* handles){
+    
+    spi_error_t err = SPI_NO_ERROR;
+    
+    /* 
+     * The batch is checked and pushed as a whole with interrupts disabled, so a running bus can't
+     * dequeue the first transactions before the last ones are queued. Its interrupt only freed
+     * entries before, so space that was there at the check is still there at the push.
+     */
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        
+        for (uint8_t i = 0; i < count; i++) {
+            
+            transactions[i]->handle = spi_completion_acquire();
+            
+            if (handles != NULL) handles[i] = transactions[i]->handle;
+            
+            if (transactions[i]->handle == SPI_HANDLE_NONE) err = SPI_ERR_BUFFER_OVERFLOW;
+            else if (transactions[i]->device == NULL || transactions[i]->device->bus == NULL) err = SPI_ERR_INVALID_PORT;
+        }
+        
+        /* Every transaction needs a free entry besides those taken by the batch before it on the same level */
+        for (uint8_t i = 0; i < count && err == SPI_NO_ERROR; i++) {
+            
+            spi_queue_t* queue = &transactions[i]->device->bus->queue;
+            uint8_t needed = 1;
+            
+            for (uint8_t j = 0; j < i; j++) {
+                if (&transactions[j]->device->bus->queue == queue && transactions[j]->priority == transactions[i]->priority) needed++;
+            }
+            
+            if (spi_queue_space(queue, transactions[i]) < needed) err = SPI_ERR_BUFFER_OVERFLOW;
+        }
         
-        if (payload->spi.device == NULL) {
-            payload_free_spi(payload);
-            return SPI_ERR_INVALID_PORT;
+        if (err == SPI_NO_ERROR) {
+            for (uint8_t i = 0; i < count; i++) {
+                spi_stats_submit(transactions[i]);
+                spi_trace(SPI_TRACE_SUBMIT, transactions[i]->device, transactions[i]->priority);
+                spi_queue_push(&transactions[i]->device->bus->queue, transactions[i]);
+                spi_stats_queued(transactions[i]->device->bus);
+            }
         }
+    }
+    
+    if (err != SPI_NO_ERROR) {
         
-        spi_enable_device(payload->spi.device);
+        /* Nothing was queued, the whole batch completes with the error */
+        for (uint8_t i = 0; i < count; i++) {
+            spi_transaction_done(transactions[i], err);
+        }
         
-        payload->spi.number_of_bytes--;
+        return error_handler(err);
+    }
+    
+    /* One start per bus, the interrupt chains the rest of the batch */
+    for (uint8_t i = 0; i < count; i++) {
         
-        SPI_STATE = SPI_ACTIVE;
-              
-        SPI_PORT &= ~(1 << device->port);  /* Pull down := active */
+        spi_bus_t* bus = transactions[i]->device->bus;
+        uint8_t started = 0;
         
-        SPDR = *(payload->spi.data);
+        for (uint8_t j = 0; j < i; j++) {
+            if (transactions[j]->device->bus == bus) started = 1;
+        }
+        
+        if (!started) _spi(bus);
     }
     
     return SPI_NO_ERROR;
 }
 
-spi_error_t spi_write(payload_t* _payload){
-        
-    spi_error_t err;
-       
-    _payload->spi.mode = WRITE;
+spi_handle_t spi_write(payload_t* _payload){
     
-    err = queue_enqueue(queue, _payload);
-       
-    if (err != SPI_NO_ERROR) return error_handler(SPI_ERR_BUFFER_OVERFLOW);
+    _payload->segments[0].rx = NULL;
+    _payload->transaction.nr_segments = 1;
+    
+    return spi_transfer(&_payload->transaction);
+}
+
+spi_handle_t spi_read(payload_t* _payload, uint8_t* container){
+    
+    _payload->segments[0].rx = container;
+    _payload->transaction.nr_segments = 1;
+    
+    return spi_transfer(&_payload->transaction);
+}
+
+spi_handle_t spi_read_write(payload_t* payload_write, payload_t* payload_read, uint8_t* container) {
+    
+    /* Both phases become the two segments of the write payload, so the chip select stays asserted in between */
+    payload_write->segments[0].rx = NULL;
+    payload_write->segments[1].length = payload_read->segments[0].length;
+    payload_write->segments[1].tx = payload_read->segments[0].tx;
+    payload_write->segments[1].rx = container;
+    payload_write->transaction.nr_segments = 2;
+    
+    if (payload_read->transaction.callback != NULL) {
+        payload_write->transaction.callback = payload_read->transaction.callback;
+        payload_write->transaction.ctx = payload_read->transaction.ctx;
+    }
+    
+    payload_free_spi(payload_read);
+    
+    return spi_transfer(&payload_write->transaction);
+}
+
+spi_handle_t spi_stream_start(spi_stream_t* stream){
+    
+    spi_transaction_t* _transaction = &stream->transaction;
+    spi_handle_t handle = spi_completion_acquire();
+    
+    _transaction->handle = handle;
+    
+    stream->stop = 0;
+    stream->half = SPI_STREAM_COMMAND;
+    
+    if (handle == SPI_HANDLE_NONE) {
+        spi_transaction_done(_transaction, error_handler(SPI_ERR_BUFFER_OVERFLOW));
+        return handle;
+    }
+    
+#if SPI_NATIVE
+    uint8_t busy = 0;
+    
+    /* Streams are driven by ISR(SPI_STC_vect) */
+    if (_transaction->device == NULL || _transaction->device->bus != &spi0) {
+        spi_transaction_done(_transaction, error_handler(SPI_ERR_INVALID_PORT));
+        return handle;
+    }
+    
+    if (stream->buffers == NULL || stream->nr_buffers == 0 || stream->nr_buffers > UINT8_MAX / 2 || stream->length < 2) {
+        spi_transaction_done(_transaction, error_handler(SPI_ERR_NOT_DEFINED));
+        return handle;
+    }
+    
+    /* The interrupt may start the stream as soon as it is published */
+    spi_stats_submit(_transaction);
+    
+    spi_trace(SPI_TRACE_SUBMIT, _transaction->device, _transaction->priority);
+    
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        if (spi0.stream != NULL) busy = 1;
+        else spi0.stream = stream;
+    }
     
-    err = _spi();
+    if (busy) {
+        spi_transaction_done(_transaction, error_handler(SPI_ERR_RECV_BUSY));
+        return handle;
+    }
     
-    if (err != SPI_NO_ERROR) return error_handler(err);
+    _spi(&spi0);
+#else
+    /* Streams are driven by ISR(SPI_STC_vect), which this MCU lacks */
+    spi_transaction_done(_transaction, error_handler(SPI_ERR_INVALID_PORT));
+#endif
     
-    return SPI_NO_ERROR;   
+    return handle;
 }
 
-spi_error_t spi_read(payload_t* _payload, uint8_t* container){
+spi_error_t spi_stream_stop(spi_stream_t* stream){
     
-    spi_error_t err;
+#if SPI_NATIVE
+    uint8_t pending = 0;
     
-    _payload->spi.mode = READ;
-    _payload->spi.container = container;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        
+        stream->stop = 1;
+        
+        /* A stream that did not start yet is removed right away */
+        if (spi0.stream == stream && spi0.transaction != &stream->transaction) {
+            spi0.stream = NULL;
+            pending = 1;
+        }
+    }
     
-    err = queue_enqueue(queue, _payload);
+    if (pending) spi_transaction_done(&stream->transaction, SPI_NO_ERROR);
     
-    if (err != SPI_NO_ERROR) return error_handler(SPI_ERR_BUFFER_OVERFLOW);
+    return SPI_NO_ERROR;
+#else
+    /* No stream can have been started */
+    (void)stream;
     
-    err = _spi();
+    return error_handler(SPI_ERR_INVALID_PORT);
+#endif
+}
+
+spi_error_t spi_flush(void){
     
-    if (err != SPI_NO_ERROR) return error_handler(err);
+    for (uint8_t i = 0; i < SPI_NR_BUSES; i++) {
+        if (buses[i] != NULL && buses[i]->state == SPI_ACTIVE) return error_handler(SPI_ERR_FLUSH_FAILED);
+    }
+    
+    /* Complete all pending transactions and return their payloads to the pool */
+    for (uint8_t i = 0; i < SPI_NR_BUSES; i++) {
+        if (buses[i] == NULL) continue;
+        while (!spi_queue_empty(&buses[i]->queue)) {
+            spi_transaction_done(spi_queue_dequeue(&buses[i]->queue), SPI_ERR_FLUSH_FAILED);
+        }
+    }
     
     return SPI_NO_ERROR;
 }
 
-spi_error_t spi_read_write(payload_t* payload_write, payload_t* payload_read, uint8_t* container) {
+static uint8_t spi_idle(void* ctx){
     
-    spi_error_t err;
+    (void)ctx;
     
-    payload_write->spi.mode = READ_WRITE;
-    payload_read->spi.mode  = READ;
-    payload_read->spi.container = container;
-       
-    err = queue_enqueue(queue, payload_write);
-    err = queue_enqueue(queue, payload_read);
+    for (uint8_t i = 0; i < SPI_NR_BUSES; i++) {
+        if (buses[i] != NULL && buses[i]->state == SPI_ACTIVE) return 0;
+    }
     
-    if (err != SPI_NO_ERROR) return error_handler(SPI_ERR_BUFFER_OVERFLOW);
+    return 1;
+}
+
+spi_error_t spi_wait_idle(void){
     
-    err = _spi();
+#if SPI_NATIVE
+    /* A running stream keeps its bus until it is stopped */
+    if (spi0.stream != NULL && !spi0.stream->stop) return error_handler(SPI_ERR_RECV_BUSY);
+#endif
     
-    if (err != SPI_NO_ERROR) return error_handler(err);
+    spi_sleep_until(spi_idle, NULL);
     
     return SPI_NO_ERROR;
 }
 
-spi_error_t spi_flush(queue_t* _queue){
+void spi_get_stats(spi_stats_t* stats){
+    
+    memset(stats, 0, sizeof(*stats));
     
-    if (SPI_STATE == SPI_ACTIVE) return error_handler(SPI_ERR_FLUSH_FAILED);
+#if SPI_STATS
+    for (uint8_t i = 0; i < SPI_NR_BUSES; i++) {
+        
+        if (buses[i] == NULL) continue;
         
-    queue_flush(_queue);
+        /* The interrupt of the bus updates the counters as well */
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+            spi_stats_clock(buses[i]);
+            stats->bus[i] = buses[i]->stats;
+        }
+    }
+#endif
     
-    return SPI_NO_ERROR;
+    spi_sleep_stats(&stats->sleep);
+    spi_error_stats(&stats->errors);
 }
 
-ISR(SPI_STC_vect){
-                         
-    if (payload->spi.container != NULL && payload->spi.mode == READ) {
-        *(payload->spi.container) = SPDR;   
-        (payload->spi.container)++;   
-    } 
-    else {
-        dump = SPDR;
+spi_error_t spi_get_device_stats(const device_t* _device, spi_device_stats_t* stats){
+    
+    if (_device == NULL || _device->port == NULL) return error_handler(SPI_ERR_INVALID_PORT);
+    
+#if SPI_STATS
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        *stats = _device->stats;
     }
+#else
+    memset(stats, 0, sizeof(*stats));
+#endif
+    
+    return SPI_NO_ERROR;
+}
 
-    (payload->spi.data)++;       
- 
-    if (payload->spi.number_of_bytes != 0){
-               
-        payload->spi.number_of_bytes--;
-        
-        SPDR = *(payload->spi.data); 
-    } 
-    else {
+void spi_reset_stats(void){
+    
+#if SPI_STATS
+    for (uint8_t i = 0; i < SPI_NR_BUSES; i++) {
         
-        // Task finished
+        if (buses[i] == NULL) continue;
         
-        if (payload->spi.callback != NULL) {
-            payload->spi.callback(NULL);
-            payload->spi.callback = NULL;
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+            memset(&buses[i]->stats, 0, sizeof(buses[i]->stats));
+            buses[i]->stats_time = SPI_STATS_TIME();
         }
-              
-        if (queue_empty(queue)) {   
-            payload_free_spi(payload);                    
-            SPI_PORT |= (1 << device->port); // Pull up := inactive   
-            SPI_STATE = SPI_INACTIVE;      
-        } 
-        else {
-            
-            // Load next task
-            
-            if (payload->spi.mode == READ_WRITE) {
-                // Do nothing.
-            } 
-            else {
-                SPI_PORT |= (1 << device->port); // Pull up := inactive
-            }
-            
-            payload_free_spi(payload);
-                     
-            payload = queue_dequeue(queue);
-            
-            spi_enable_device(payload->spi.device);
-                       
-            payload->spi.number_of_bytes--;           
-            
-            SPI_PORT &= ~(1 << device->port);  /* Pull down := active */
-            
-            SPDR = *(payload->spi.data);
+    }
+    
+    for (uint8_t i = 0; i < SPI_MAX_DEVICES; i++) {
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+            memset(&devices[i].stats, 0, sizeof(devices[i].stats));
         }
     }
-}
\ No newline at end of file
+    
+    spi_sleep_stats_reset();
+#endif
+}
+
+#if SPI_NATIVE
+
+/* 
+ * Cold path of the interrupt, once per chunk of up to 255 bytes: stores the last byte of the
+ * chunk and either moves on to the next chunk or segment, or ends the transaction and starts
+ * the next one.
+ */
+static void __attribute__((noinline)) spi_native_segment_end(uint8_t data){
+    
+    const spi_segment_t* segment = spi0.tx.segment;
+    
+    if (spi0.tx.rx != NULL) *spi0.tx.rx++ = data;
+    
+    /* First byte of the next chunk or segment under the same chip select */
+    if (spi_cursor_next(&spi0.tx)) {
+        spi_native_send(&spi0);
+        spi_trace_segment(&spi0, &spi0.tx, segment);
+        return;
+    }
+    
+    spi_stream_t* stream = spi0.stream;
+    
+    if (stream != NULL && !stream->stop) {
+        
+        uint8_t half = stream->half;
+        
+        /* The next half is shifting while the callback runs */
+        spi_stream_next(stream, &spi0.tx);
+        spi_native_send(&spi0);
+        
+        spi_stats_stream(&spi0, stream);
+        
+        spi_stream_signal(stream, half);
+        return;
+    }
+    
+    // Transaction finished
+    
+    SPI_CS_RELEASE(spi0.device);
+    
+    spi_stats_done(&spi0);
+    
+    spi_trace(SPI_TRACE_CS_RELEASE, spi0.device, 0);
+    
+    if (stream != NULL) {
+        spi0.stream = NULL;
+        spi_stream_signal(stream, stream->half);
+    }
+    
+    spi_transaction_done(spi0.transaction, SPI_NO_ERROR);
+    
+    // Load next transaction
+    
+    if (!spi_native_start(&spi0)) spi0.state = SPI_INACTIVE;
+}
+
+/* 
+ * Hot path, once per byte. The next byte goes to SPDR right after the received one has been
+ * read, so the store of the received byte overlaps the shift of the next one. The cursor is
+ * only written back, never re-read, and the segment and transaction work is left to
+ * spi_native_segment_end().
+ *
+ * Hand-counted cycles of a byte in the middle of a segment, held against SPI_ISR_BYTE_BUDGET:
+ *
+ *      vector, jmp, prologue                               21
+ *      in SPDR, lds/tst remaining                           5
+ *      lds/test tx, ld tx+ (or lds fill)                 9 (6)
+ *      out SPDR                                             1
+ *      sts tx, dec/sts remaining                         7 (3)
+ *      lds/test rx, st rx+, sts rx                      13 (8)
+ *      epilogue, reti                                      20
+ *                                                   ---------
+ *      full-duplex 76, write 71, receive 69, fill 64
+ *
+ * With SPI_FIXED_FILL the fill byte is an ldi instead of an lds, one cycle less for receive
+ * and fill bytes.
+ *
+ * The count is a model of the intended instruction sequence. Recount it from the avr-objdump -d
+ * listing of SPI_STC_vect after changing this function or the compiler. The host simulation
+ * charges 2 cycles per register access, SPI_CYCLES() adds the rest of the table, so the bench
+ * replays the table and can't detect a grown ISR.
+ */
+ISR(SPI_STC_vect){
+    
+    uint8_t data = SPDR;
+    uint8_t remaining = spi0.tx.remaining;
+    
+    if (remaining == 0) {
+        spi_native_segment_end(data);
+        return;
+    }
+    
+    const uint8_t* tx = spi0.tx.tx;
+    
+    if (tx != NULL) {
+        SPI_CYCLES(12);
+        SPDR = *tx++;
+        spi0.tx.tx = tx;
+        SPI_CYCLES(6);
+    }
+    else {
+#if SPI_FIXED_FILL
+        SPI_CYCLES(8);
+        SPDR = SPI_FILL_BYTE;
+#else
+        SPI_CYCLES(9);
+        SPDR = spi0.fill;
+#endif
+        SPI_CYCLES(2);
+    }
+    
+    spi0.tx.remaining = remaining - 1;
+    
+    uint8_t* rx = spi0.tx.rx;
+    
+    if (rx != NULL) {
+        *rx++ = data;
+        spi0.tx.rx = rx;
+        SPI_CYCLES(13);
+    }
+    else {
+        SPI_CYCLES(8);
+    }
+}
+
+#endif /* SPI_NATIVE */
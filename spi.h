@@ -38,6 +38,31 @@
 @note Modify the <spi_io.h> port declaration if using another MCU.
 @note Connect the error led (see <led_lib.h>) on the STK600 to monitor possible error codes.
       Occuring errors are described in <spi_error_handler.h>
+@note Payloads come from a static pool (see <spi_payload.h>). Once passed to spi_write(), spi_read()
+      or spi_read_write() they belong to the driver and are released after the transfer.
+@note spi_init() sets up the native SPI. A USART enabled as SPI master in <spi_config.h> is set up with
+      spi_bus_init() and selected per device through spi_device_config_t. Every bus has its own queue
+      and interrupt, so transfers on different buses run concurrently. The bit-banged bus of SPI_SOFT
+      has no interrupt and runs its queue to the end inside the submitting call. SPI_BUFFERED adds the
+      SPI of the AVR Dx series in buffered mode as SPI_BUS_BUFFERED (see <spi_buffered.c>). On parts
+      without the classic SPI spi_init() still sets up the pool and returns SPI_ERR_INVALID_PORT.
+@note Every submission returns a completion handle (see <spi_completion.h>). Errors at submission are
+      reported through the handle and the transaction callback as well.
+@note spi_wait() and spi_wait_idle() wait in idle sleep instead of spinning, spi_wait_idle() until every
+      bus ran out of transactions. With a running stream it returns SPI_ERR_RECV_BUSY right away.
+@note spi_transfer() sends a caller-owned transaction of several segments under one chip select
+      assertion (see <spi_transaction.h>). spi_read_write() is a two segment transaction.
+@note spi_submit_batch() queues several transactions in one critical section and starts each bus once, so
+      a running bus can't take the first ones before the last are queued. Either all of them
+      are queued or, if a queue level has no room for the whole batch, none of them is and all complete
+      with SPI_ERR_BUFFER_OVERFLOW. Batches are never polled.
+@note The queues are lock-free single-producer rings (see <spi_queue.h>). Submit from the main loop
+      only, not from an interrupt or a transaction callback.
+@note spi_get_stats() returns a snapshot of the counters enabled with SPI_STATS (see <spi_stats.h>).
+@note With SPI_TRACE the driver records its events into a ring that spi_trace_dump() drains (see <spi_trace.h>).
+@note SPI_DEVICE() and spi_add_device() set up native SPI devices whose settings are checked and folded
+      into register values at compile time (see <spi_static.h>), <spi.hpp> wraps them for C++.
+@note spi_stream_start() reads a device continuously into a ring of buffers (see <spi_stream.h>).
 @usage The following code shows typical usage of this library.
 
 @code
@@ -49,16 +74,18 @@
 		
 		sei();
 		
-		spi_init();
+		spi_init(&spi_config);
     
-		device_t* spi_device = spi_create_device(PINB4, PORTB4, DDB4);
+		device_t* spi_device = spi_create_device(&PORTB, PORTB4, NULL);
     
 		uint8_t* container = (uint8_t*)malloc(sizeof(uint8_t) * ARRAY_LEN(flash_send)); 
     
 		payload_t* payload1 = payload_create_spi(PRIORITY_LOW, spi_device, flash_send, ARRAY_LEN(flash_send), NULL);
 		payload_t* payload2 = payload_create_spi(PRIORITY_LOW, spi_device, flash_send, ARRAY_LEN(flash_send), NULL);
       
-		spi_error_t err = spi_read_write(payload1, payload2, container);
+		spi_handle_t handle = spi_read_write(payload1, payload2, container);
+		
+		spi_error_t err = spi_wait(handle);
  
 		for(;;);
     }
@@ -76,29 +103,63 @@
 #include "spi_io.h"
 #include "spi_config.h"
 #include "spi_error_handler.h"
-#include "ringbuffer.h"
+#include "spi_stats.h"
+#include "spi_trace.h"
 
-/* Describes a spi device */
+/* Describes a spi device by the chip select port and pin mask and its bus settings, resolved once in spi_create_device() */
 typedef struct device_t {
-    uint8_t pin;
-    uint8_t port;
-    uint8_t ddr;
+    volatile uint8_t* port;
+    uint8_t mask;
+    uint8_t ctrl;               // SPCR or UCSRnC
+    uint16_t rate;              // SPSR or UBRRn
+    uint8_t poll_max_bytes;
+    uint8_t fill;
+    struct spi_bus_t* bus;
+#if SPI_STATS
+    spi_device_stats_t stats;
+#endif
+#if SPI_TRACE
+    uint8_t id;                 // Index in the device table, identifies the device in the trace
+#endif
 } device_t;
 
+#include "spi_completion.h"
+#include "spi_transaction.h"
+#include "spi_payload.h"
+#include "spi_queue.h"
+#include "spi_stream.h"
+#include "spi_static.h"
+
 spi_error_t spi_init(spi_config_t*);
 
-device_t* spi_create_device(uint8_t pin, uint8_t port, uint8_t ddr);
+spi_error_t spi_bus_init(spi_bus_id_t, spi_config_t*);
+
+device_t* spi_create_device(volatile uint8_t* port, uint8_t pin, const spi_device_config_t* config);
 
 spi_error_t spi_free_device(device_t*);
 
-spi_error_t spi_write(payload_t*);
+spi_handle_t spi_write(payload_t*);
+
+spi_handle_t spi_read(payload_t*, uint8_t*);
+
+spi_handle_t spi_read_write(payload_t*, payload_t*, uint8_t*);
+
+spi_handle_t spi_transfer(spi_transaction_t*);
+
+spi_error_t spi_submit_batch(spi_transaction_t* const transactions[], uint8_t count, spi_handle_t* handles);
+
+spi_error_t spi_flush(void);
+
+spi_error_t spi_wait_idle(void);
+
+spi_handle_t spi_stream_start(spi_stream_t*);
 
-spi_error_t spi_read(payload_t*, uint8_t*);
+spi_error_t spi_stream_stop(spi_stream_t*);
 
-spi_error_t spi_read_write(payload_t*, payload_t*, uint8_t*);
+void spi_get_stats(spi_stats_t*);
 
-spi_error_t spi_flush(queue_t*);
+spi_error_t spi_get_device_stats(const device_t*, spi_device_stats_t*);
 
-extern payload_t* payload_create_spi(priority_t priority, device_t* device, uint8_t* data, uint8_t number_of_bytes, callback_fn callback);
+void spi_reset_stats(void);
 
 #endif /* SPI_H_ */
\ No newline at end of file
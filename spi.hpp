@@ -0,0 +1,219 @@
+/*************************************************************************
+* Title		: SPI C++ Wrapper
+* Author	: Dimitri Dening
+* Created	: 17.10.2026 22:05:17
+* Software	: Microchip Studio V7
+* Hardware	: Atmega1284P
+* License	: MIT License
+* Usage		: see Doxygen manual
+*
+*       Copyright (C) 2021 Dimitri Dening
+*
+*       Permission is hereby granted, free of charge, to any person obtaining a copy
+*       of this software and associated documentation files (the "Software"), to deal
+*       in the Software without restriction, including without limitation the rights
+*       to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*       copies of the Software, and to permit persons to whom the Software is
+*       furnished to do so, subject to the following conditions:
+*
+*       The above copyright notice and this permission notice shall be included in all
+*       copies or substantial portions of the Software.
+*
+*       THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*       IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*       FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*       AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*       LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*       OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*       SOFTWARE.
+*
+* NOTES:
+*	Header only, include it instead of <spi.h> from C++ code.
+*************************************************************************/
+
+
+/**
+@file spi.hpp
+@author Dimitri Dening
+@date 17.10.2026
+@copyright (C) 2021 Dimitri Dening, MIT License
+@brief Compile-time configured native SPI bus and devices for C++.
+
+A bus is a type parameterised on its settings and the set of its devices. Every register value
+is a constant of the type, and a divider the SPI can't generate, a chip select pin that is SCK,
+MOSI or MISO or two devices on the same pin are rejected by static_assert. The types have no
+state of their own, a device is a statically allocated device_t of <spi_static.h> that is passed
+to the C functions of <spi.h> as usual.
+
+@code
+    #include "spi.hpp"
+
+    typedef spi::device<spi::port::B, PORTB4, spi::settings<SPI_MSB, SPI_MODE3, 16, 0xFF>> flash;
+    typedef spi::device<spi::port::D, PORTD5, spi::settings<SPI_MSB, SPI_MODE0, 4>> dac;
+    typedef spi::bus<spi::settings<SPI_MSB, SPI_MODE3, 2>, flash, dac> bus;
+
+    int main(void){
+
+        sei();
+
+        bus::init();
+
+        payload_t* payload = payload_create_spi(PRIORITY_LOW, flash::get(), flash_send, 3, NULL);
+        spi_wait(spi_write(payload));
+    }
+@endcode
+
+@note Needs C++11, the wrapper does not use the standard library.
+@note sim/bench_hpp.cpp builds a bus of two devices against the host simulation.
+@bug No known bugs.
+*/
+#ifndef SPI_HPP_
+#define SPI_HPP_
+
+extern "C" {
+#include "spi.h"
+}
+
+namespace spi {
+
+enum class port : uint8_t {
+    A = SPI_PORT_ID_A, B = SPI_PORT_ID_B, C = SPI_PORT_ID_C, D = SPI_PORT_ID_D,
+    E = SPI_PORT_ID_E, F = SPI_PORT_ID_F, G = SPI_PORT_ID_G, H = SPI_PORT_ID_H,
+    J = SPI_PORT_ID_J, K = SPI_PORT_ID_K, L = SPI_PORT_ID_L
+};
+
+/* Output register of a port, only the ports of the MCU are defined */
+template <port Port> volatile uint8_t* port_register();
+
+#define SPI_PORT_REGISTER(letter) \
+    template <> inline volatile uint8_t* port_register<port::letter>() { return &PORT##letter; }
+
+#ifdef PORTA
+SPI_PORT_REGISTER(A)
+#endif
+#ifdef PORTB
+SPI_PORT_REGISTER(B)
+#endif
+#ifdef PORTC
+SPI_PORT_REGISTER(C)
+#endif
+#ifdef PORTD
+SPI_PORT_REGISTER(D)
+#endif
+#ifdef PORTE
+SPI_PORT_REGISTER(E)
+#endif
+#ifdef PORTF
+SPI_PORT_REGISTER(F)
+#endif
+#ifdef PORTG
+SPI_PORT_REGISTER(G)
+#endif
+#ifdef PORTH
+SPI_PORT_REGISTER(H)
+#endif
+#ifdef PORTJ
+SPI_PORT_REGISTER(J)
+#endif
+#ifdef PORTK
+SPI_PORT_REGISTER(K)
+#endif
+#ifdef PORTL
+SPI_PORT_REGISTER(L)
+#endif
+
+#undef SPI_PORT_REGISTER
+
+/* Bit order, mode, SCK divider and fill byte of a bus or device, folded into SPCR/SPSR values */
+template <data_order_t DataOrder, spi_mode_t Mode, unsigned Divider, uint8_t Fill = SPI_FILL_BYTE>
+struct settings {
+    static_assert(SPI_CLOCK_RATE(Divider) != SPI_CLOCK_INVALID, "the SPI divides F_CPU by 2, 4, 8, 16, 32, 64 or 128 only");
+    static_assert(!SPI_FIXED_FILL || Fill == SPI_FILL_BYTE, "SPI_FIXED_FILL needs SPI_FILL_BYTE as fill byte");
+
+    static constexpr data_order_t data_order = DataOrder;
+    static constexpr spi_mode_t mode = Mode;
+    static constexpr clock_rate_t clockrate = static_cast<clock_rate_t>(SPI_CLOCK_RATE(Divider));
+    static constexpr uint8_t ctrl = SPI_NATIVE_CTRL(DataOrder, Mode, SPI_CLOCK_RATE(Divider));
+    static constexpr uint8_t rate = SPI_NATIVE_RATE(SPI_CLOCK_RATE(Divider));
+    static constexpr uint8_t fill = Fill;
+};
+
+/* A device on the native SPI selected by a pin of a port */
+template <port Port, uint8_t Pin, typename Settings>
+struct device {
+    static_assert(Pin < 8, "a port has 8 pins");
+    static_assert(!(static_cast<uint8_t>(Port) == SPI_PORT_ID && (Pin == SPI_SCK || Pin == SPI_MOSI || Pin == SPI_MISO)),
+        "the chip select pin is SCK, MOSI or MISO of the SPI");
+
+    static constexpr port port_id = Port;
+    static constexpr uint8_t pin = Pin;
+
+    /* The device_t passed to <spi.h>, set up by bus::init() */
+    static device_t* get() { return &instance; }
+
+    /* Sets the folded register values and attaches the device to the bus, called by bus::init() */
+    static spi_error_t add() {
+        instance.mask = static_cast<uint8_t>(1 << Pin);
+        instance.ctrl = Settings::ctrl;
+        instance.rate = Settings::rate;
+        instance.fill = Settings::fill;
+        instance.port = port_register<Port>();
+        return spi_add_device(&instance);
+    }
+
+private:
+    static device_t instance;
+};
+
+/* Value-initialized, so the optional statistics and trace members need no initializer */
+template <port Port, uint8_t Pin, typename Settings>
+device_t device<Port, Pin, Settings>::instance = device_t();
+
+namespace detail {
+
+/* True if the first device shares its chip select with one of the others */
+template <typename Device, typename... Others>
+struct shares_pin {
+    static constexpr bool value = false;
+};
+
+template <typename Device, typename Other, typename... Others>
+struct shares_pin<Device, Other, Others...> {
+    static constexpr bool value = (Device::port_id == Other::port_id && Device::pin == Other::pin)
+        || shares_pin<Device, Others...>::value;
+};
+
+template <typename... Devices>
+struct devices {
+    static constexpr bool distinct = true;
+    static spi_error_t add() { return SPI_NO_ERROR; }
+};
+
+template <typename Device, typename... Others>
+struct devices<Device, Others...> {
+    static constexpr bool distinct = !shares_pin<Device, Others...>::value && devices<Others...>::distinct;
+
+    static spi_error_t add() {
+        spi_error_t error = Device::add();
+        return (error != SPI_NO_ERROR) ? error : devices<Others...>::add();
+    }
+};
+
+} // namespace detail
+
+/* The native SPI with its default settings and the devices it serves */
+template <typename Settings, typename... Devices>
+struct bus {
+    static_assert(detail::devices<Devices...>::distinct, "two devices share a chip select pin");
+
+    /* Sets up the driver and the bus and attaches every device */
+    static spi_error_t init(uint32_t poll_threshold = SPI_POLL_THRESHOLD) {
+        spi_config_t config = { Settings::data_order, Settings::mode, Settings::clockrate, poll_threshold, Settings::fill };
+        spi_error_t error = spi_init(&config);
+        return (error != SPI_NO_ERROR) ? error : detail::devices<Devices...>::add();
+    }
+};
+
+} // namespace spi
+
+#endif /* SPI_HPP_ */
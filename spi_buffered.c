@@ -0,0 +1,270 @@
+/*************************************************************************
+* Title     : SPI Master in Buffered Mode (AVR Dx)
+* Author    : Dimitri Dening
+* Created   : 17.10.2026 23:52:16
+* Software  : Microchip Studio V7
+* Hardware  : AVR128DA48
+
+DESCRIPTION:
+    Runs SPI0 of the AVR Dx and megaAVR 0-series in buffered mode as a bus
+    with its own queue and ISR(SPI0_INT_vect).
+USAGE:
+    Set SPI_BUFFERED to 1 in <spi_config.h>, call spi_init() for the
+    payload pool and the handles, then spi_bus_init(SPI_BUS_BUFFERED, &config)
+    and create devices with spi_device_config_t.bus = SPI_BUS_BUFFERED.
+    Everything else is <spi.h>. Without the classic SPI (SPI_NATIVE is 0)
+    spi_init() returns SPI_ERR_INVALID_PORT after the setup, as do
+    spi_add_device() and spi_stream_start(), which only serve SPI_BUS_SPI.
+NOTES:
+    In buffered mode a byte written while the shifter is busy waits in the
+    transmit buffer and follows without a gap, and received bytes go into
+    a two byte FIFO. The buffer is refilled from the data register empty
+    interrupt (DREIF), which fires as soon as the waiting byte moved into
+    the shifter. The interrupt empties the receive FIFO before it refills,
+    so at most two bytes are in flight and the FIFO can't overflow even if
+    the interrupt comes late. Once the last byte is written only the
+    receive complete interrupt (RXCIF) stays enabled, for the tail.
+    The chip select is a GPIO of the device, SSD keeps the SS pin from
+    switching the peripheral to slave mode.
+*************************************************************************/
+
+/* General libraries */
+#include <avr/interrupt.h>
+
+/* User defined libraries */
+#include "spi.h"
+#include "spi_bus.h"
+
+#if SPI_BUFFERED
+
+#if !defined(SPI_BUFFERED_SCK)
+#  error "Buffered SPI pins not defined in <spi_io.h>"
+#endif
+
+#define BUFFERED_ISR_DISABLE() (SPI0_INTCTRL = 0)
+#define BUFFERED_ISR_RECEIVE() (SPI0_INTCTRL = SPI_RXCIE_bm)
+#define BUFFERED_ISR_SEND() (SPI0_INTCTRL = SPI_RXCIE_bm | SPI_DREIE_bm)
+#define BUFFERED_CS_ASSERT(dev) (*(dev)->port &= ~(dev)->mask)   /* Pull down := active */
+#define BUFFERED_CS_RELEASE(dev) (*(dev)->port |= (dev)->mask)   /* Pull up := inactive */
+
+/* SCK dividers from fastest to slowest and their SPI0_CTRLA bits, PRESC and CLK2X */
+static const uint8_t dividers[] = { 2, 4, 8, 16, 32, 64, 128 };
+
+static const uint8_t prescalers[] = {
+    (0 << SPI_PRESC_gp) | SPI_CLK2X_bm,
+    (0 << SPI_PRESC_gp),
+    (1 << SPI_PRESC_gp) | SPI_CLK2X_bm,
+    (1 << SPI_PRESC_gp),
+    (2 << SPI_PRESC_gp) | SPI_CLK2X_bm,
+    (2 << SPI_PRESC_gp),
+    (3 << SPI_PRESC_gp)
+};
+
+/* Resolves a device to its SPI0_CTRLA/SPI0_CTRLB values */
+static uint16_t spi_buffered_configure(device_t* _device, data_order_t data_order, spi_mode_t mode, uint32_t frequency){
+    
+    uint8_t i = 0;
+    
+    /* Fastest SCK that does not exceed the frequency, the slowest one otherwise */
+    while (i < sizeof(dividers) - 1 && F_CPU / dividers[i] > frequency) i++;
+    
+    _device->ctrl = (data_order ? SPI_DORD_bm : 0) | SPI_MASTER_bm | prescalers[i] | SPI_ENABLE_bm;
+    
+    /* Buffered mode, the first byte goes straight into the shifter, SS pin ignored */
+    _device->rate = SPI_BUFEN_bm | SPI_BUFWR_bm | SPI_SSD_bm | (mode << SPI_MODE_gp);
+    
+    return 8 * dividers[i];
+}
+
+static uint8_t spi_buffered_pin_used(volatile uint8_t* port, uint8_t pin){
+#ifdef SPI_BUFFERED_PORT_ALIAS
+    /* The same pins through the full port registers */
+    if (port == &SPI_BUFFERED_PORT_ALIAS) port = &SPI_BUFFERED_PORT;
+#endif
+    return port == &SPI_BUFFERED_PORT && (pin == SPI_BUFFERED_SCK || pin == SPI_BUFFERED_MOSI || pin == SPI_BUFFERED_MISO);
+}
+
+static void spi_buffered_init(spi_bus_t* bus, const device_t* defaults){
+    
+    /* Set MOSI and SCK output, MISO input */
+    *SPI_DDR_OF(&SPI_BUFFERED_PORT) |= (1 << SPI_BUFFERED_SCK) | (1 << SPI_BUFFERED_MOSI);
+    *SPI_DDR_OF(&SPI_BUFFERED_PORT) &= ~(1 << SPI_BUFFERED_MISO);
+    
+    bus->ctrl = defaults->ctrl;
+    bus->rate = defaults->rate;
+    
+    /* The buffer mode is set before the peripheral is enabled */
+    SPI0_CTRLB = (uint8_t)bus->rate;
+    SPI0_CTRLA = bus->ctrl;
+    
+    BUFFERED_ISR_RECEIVE();
+}
+
+static void spi_buffered_enable(spi_bus_t* bus, device_t* _device){
+    
+    if (!spi_bus_select(bus, _device)) return;
+    
+    /* The shifter is idle between transactions, so the registers can change */
+    if (_device->rate != bus->rate) {
+        bus->rate = _device->rate;
+        SPI0_CTRLB = (uint8_t)bus->rate;
+    }
+    
+    if (_device->ctrl != bus->ctrl) {
+        bus->ctrl = _device->ctrl;
+        SPI0_CTRLA = bus->ctrl;
+    }
+}
+
+/* Writes the next byte of the send cursor into the transmit buffer */
+static inline void spi_buffered_send(spi_bus_t* bus){
+    
+    bus->tx.remaining--;
+    
+    SPI0_DATA = (bus->tx.tx != NULL) ? *bus->tx.tx++ : bus->fill;
+}
+
+/* Returns 1 if the send cursor has another byte */
+static inline uint8_t spi_buffered_pending(spi_bus_t* bus){
+    return bus->tx.remaining != 0 || spi_cursor_next(&bus->tx);
+}
+
+static uint8_t spi_buffered_start(spi_bus_t* bus){
+    
+    if (!spi_bus_dequeue(bus)) return 0;
+    
+    spi_buffered_enable(bus, bus->transaction->device);
+    
+    BUFFERED_CS_ASSERT(bus->device);
+    
+    /* Both cursors start at the first byte */
+    bus->rx = bus->tx;
+    
+    spi_buffered_send(bus);
+    
+    /* The second byte waits in the transmit buffer and follows without a gap */
+    if (spi_buffered_pending(bus)) spi_buffered_send(bus);
+    
+    if (spi_buffered_pending(bus)) BUFFERED_ISR_SEND();
+    
+    spi_trace(SPI_TRACE_CS_ASSERT, bus->device, 0);
+    
+    return 1;
+}
+
+static void spi_buffered_poll(spi_bus_t* bus, spi_transaction_t* _transaction){
+    
+    spi_buffered_enable(bus, _transaction->device);
+    
+    BUFFERED_ISR_DISABLE();
+    
+    BUFFERED_CS_ASSERT(bus->device);
+    
+    spi_trace(SPI_TRACE_CS_ASSERT, _transaction->device, 1);
+    
+    spi_cursor_load(&bus->tx, _transaction);
+    
+    if (spi_cursor_next(&bus->tx)) {
+        
+        uint8_t sending = 1;
+        
+        bus->rx = bus->tx;
+        
+        for (;;) {
+            
+            uint8_t flags = SPI0_INTFLAGS;
+            
+            /* Receive before sending, like the interrupt, so at most two bytes are in flight */
+            if (flags & SPI_RXCIF_bm) {
+                
+                uint8_t data = SPI0_DATA;
+                
+                if (bus->rx.rx != NULL) *bus->rx.rx++ = data;
+                
+                if (--bus->rx.remaining == 0 && !spi_cursor_next(&bus->rx)) break;
+            }
+            
+            /* Keep the transmit buffer filled */
+            if (sending && (flags & SPI_DREIF_bm)) {
+                spi_buffered_send(bus);
+                sending = spi_buffered_pending(bus);
+            }
+        }
+    }
+    
+    BUFFERED_CS_RELEASE(bus->device);
+    
+    spi_trace(SPI_TRACE_CS_RELEASE, _transaction->device, 0);
+    
+    BUFFERED_ISR_RECEIVE();
+    
+    spi_transaction_done(_transaction, SPI_NO_ERROR);
+}
+
+static const spi_bus_ops_t spi_buffered_ops = {
+    .init = spi_buffered_init,
+    .pin_used = spi_buffered_pin_used,
+    .configure = spi_buffered_configure,
+    .start = spi_buffered_start,
+    .poll = spi_buffered_poll
+};
+
+static spi_bus_t buffered = { .ops = &spi_buffered_ops };
+
+spi_bus_t* spi_buffered_bus(void){
+    return &buffered;
+}
+
+ISR(SPI0_INT_vect){
+    
+    uint8_t flags = SPI0_INTFLAGS;
+    
+    /* Empty the receive FIFO first, every byte taken out makes room for one more in flight */
+    while (flags & SPI_RXCIF_bm) {
+        
+        uint8_t data = SPI0_DATA;
+        
+        if (buffered.rx.rx != NULL) *buffered.rx.rx++ = data;
+        
+        if (--buffered.rx.remaining == 0) {
+            
+            const spi_segment_t* segment = buffered.rx.segment;
+            
+            if (!spi_cursor_next(&buffered.rx)) {
+                
+                // Transaction finished
+                
+                BUFFERED_CS_RELEASE(buffered.device);
+                
+                spi_stats_done(&buffered);
+                
+                spi_trace(SPI_TRACE_CS_RELEASE, buffered.device, 0);
+                
+                spi_transaction_done(buffered.transaction, SPI_NO_ERROR);
+                
+                // Load next transaction
+                
+                BUFFERED_ISR_RECEIVE();
+                
+                if (!spi_buffered_start(&buffered)) buffered.state = SPI_INACTIVE;
+                
+                return;
+            }
+            
+            spi_trace_segment(&buffered, &buffered.rx, segment);
+        }
+        
+        flags = SPI0_INTFLAGS;
+    }
+    
+    /* The waiting byte moved into the shifter, the next one takes its place */
+    if ((flags & SPI_DREIF_bm) && spi_buffered_pending(&buffered)) {
+        
+        spi_buffered_send(&buffered);
+        
+        /* The rest of the transaction only has to be received */
+        if (!spi_buffered_pending(&buffered)) BUFFERED_ISR_RECEIVE();
+    }
+}
+
+#endif /* SPI_BUFFERED */
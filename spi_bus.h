@@ -0,0 +1,380 @@
+/*************************************************************************
+* Title		: SPI Bus Instances
+* Author	: Dimitri Dening
+* Created	: 17.10.2026 14:52:07
+* Software	: Microchip Studio V7
+* Hardware	: Atmega1284P
+* License	: MIT License
+* Usage		: see Doxygen manual
+*
+*       Copyright (C) 2021 Dimitri Dening
+*
+*       Permission is hereby granted, free of charge, to any person obtaining a copy
+*       of this software and associated documentation files (the "Software"), to deal
+*       in the Software without restriction, including without limitation the rights
+*       to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*       copies of the Software, and to permit persons to whom the Software is
+*       furnished to do so, subject to the following conditions:
+*
+*       The above copyright notice and this permission notice shall be included in all
+*       copies or substantial portions of the Software.
+*
+*       THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*       IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*       FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*       AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*       LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*       OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*       SOFTWARE.
+*
+* NOTES:
+*	Internal header of the driver, shared by <spi.c> and the bus backends.
+*	Applications only include <spi.h>.
+*************************************************************************/
+
+/**
+@file spi_bus.h
+@author Dimitri Dening
+@date 17.10.2026
+@copyright (C) 2021 Dimitri Dening, MIT License
+@brief State of a single SPI master bus and the helpers every backend shares.
+
+Each bus owns its queue, the transaction on the wire, the programmed device and a cursor into
+the transaction. The backend behind a bus only provides the hardware specific parts through
+spi_bus_ops_t. Those are called from the main loop, the interrupt of each backend works on its
+bus directly.
+
+A bus whose transmitter is double-buffered keeps a second cursor for the receive side, because
+the byte being received belongs to an earlier position of the transaction than the byte being sent.
+
+@note Internal header, only included by the driver sources.
+@bug No known bugs.
+*/
+#ifndef SPI_BUS_H_
+#define SPI_BUS_H_
+
+#include "spi.h"
+
+typedef enum {
+    SPI_ACTIVE,
+    SPI_INACTIVE
+} SPI_STATE_T;
+
+/* 
+ * Hand-counted instruction cycles of a hot path besides its register accesses. Empty on the
+ * target, the host simulation charges them to its CPU clock to model where in the interrupt
+ * the data register is written.
+ */
+#ifndef SPI_CYCLES
+#define SPI_CYCLES(n)
+#endif
+
+/* 
+ * CPU cycles ISR(SPI_STC_vect) may spend on a byte in the middle of a segment, entry and
+ * exit included. The hand count next to the interrupt in <spi.c> is held against it, the
+ * compiled code has to be checked in its avr-objdump -d listing.
+ */
+#define SPI_ISR_BYTE_BUDGET 80
+
+/* Position inside a transaction */
+typedef struct spi_cursor_t {
+    const spi_segment_t* segment;   // Next segment to load
+    const uint8_t* tx;
+    uint8_t* rx;
+    uint8_t segments_left;
+    uint8_t remaining;              // Bytes of the loaded chunk not handled yet
+#if SPI_LENGTH_BITS > 8
+    spi_length_t above;             // Bytes of the loaded segment behind the chunk
+#endif
+} spi_cursor_t;
+
+struct spi_bus_t;
+
+/* Hardware specific part of a bus, only called from the main loop */
+typedef struct spi_bus_ops_t {
+    /* Configures the pins and registers of the bus with the register values of its defaults */
+    void (*init)(struct spi_bus_t*, const device_t*);
+    /* Returns 1 if the pin is used by the bus and can't be a chip select */
+    uint8_t (*pin_used)(volatile uint8_t* port, uint8_t pin);
+    /* Resolves the register values of a device. Returns the CPU cycles per byte. */
+    uint16_t (*configure)(device_t*, data_order_t, spi_mode_t, uint32_t frequency);
+    /* Starts the next queued transaction. Returns 0 if the queue is empty. */
+    uint8_t (*start)(struct spi_bus_t*);
+    /* Sends a transaction polled */
+    void (*poll)(struct spi_bus_t*, spi_transaction_t*);
+} spi_bus_ops_t;
+
+typedef struct spi_bus_t {
+    spi_queue_t queue;
+    volatile SPI_STATE_T state;
+    spi_transaction_t* transaction;
+    spi_stream_t* stream;           // Pending or running stream, it goes before the queue
+    device_t* device;               // Device the registers are programmed for
+    spi_cursor_t tx;                // Next byte to send
+    spi_cursor_t rx;                // Next byte to receive, only used by double-buffered backends
+    uint8_t fill;                   // Fill byte of the programmed device
+    uint8_t ctrl;                   // Programmed register values, see device_t
+    uint16_t rate;
+    spi_config_t defaults;
+    const spi_bus_ops_t* ops;
+#if SPI_STATS
+    spi_bus_stats_t stats;
+    uint16_t stats_time;            // SPI_STATS_TIME() the elapsed and busy time were last advanced to
+    uint8_t stats_busy;             // A chip select is asserted
+#endif
+} spi_bus_t;
+
+/* Points the cursor at the first segment of a transaction, spi_cursor_next() loads it */
+static inline void spi_cursor_load(spi_cursor_t* cursor, const spi_transaction_t* transaction){
+    cursor->segment = transaction->segments;
+    cursor->segments_left = transaction->nr_segments;
+    cursor->remaining = 0;
+#if SPI_LENGTH_BITS > 8
+    cursor->above = 0;
+#endif
+}
+
+/* 
+ * Segments are handled in chunks of at most UINT8_MAX bytes, so the per-byte paths only count
+ * down an 8 bit remainder. Loads the next chunk of the segment, keeping the buffer positions.
+ */
+static inline uint8_t spi_cursor_chunk(spi_cursor_t* cursor){
+    
+#if SPI_LENGTH_BITS > 8
+    if (cursor->above != 0) {
+        cursor->remaining = (cursor->above > UINT8_MAX) ? UINT8_MAX : (uint8_t)cursor->above;
+        cursor->above -= cursor->remaining;
+        return 1;
+    }
+#endif
+    
+    (void)cursor;
+    
+    return 0;
+}
+
+/* Loads the first chunk of a buffer range, the length must not be 0 */
+static inline void spi_cursor_set(spi_cursor_t* cursor, const uint8_t* tx, uint8_t* rx, spi_length_t length){
+    
+#if SPI_LENGTH_BITS > 8
+    cursor->remaining = (length > UINT8_MAX) ? UINT8_MAX : (uint8_t)length;
+    cursor->above = length - cursor->remaining;
+#else
+    cursor->remaining = length;
+#endif
+    cursor->tx = tx;
+    cursor->rx = rx;
+}
+
+/* Loads the next chunk or the next non-empty segment. Returns 0 once the transaction is complete. */
+static inline uint8_t spi_cursor_next(spi_cursor_t* cursor){
+    
+    if (spi_cursor_chunk(cursor)) return 1;
+    
+    while (cursor->segments_left != 0) {
+        
+        const spi_segment_t* segment = cursor->segment++;
+        
+        cursor->segments_left--;
+        
+        if (segment->length == 0) continue;
+        
+        spi_cursor_set(cursor, segment->tx, segment->rx, segment->length);
+        
+        return 1;
+    }
+    
+    return 0;
+}
+
+/* Loads the current half buffer of a stream into the cursor */
+static inline void spi_stream_load(spi_stream_t* stream, spi_cursor_t* cursor){
+    
+    uint8_t* buffer = stream->buffers[stream->half >> 1];
+    spi_length_t first = stream->length / 2;
+    
+    if (stream->half & 1) spi_cursor_set(cursor, NULL, buffer + first, stream->length - first);
+    else spi_cursor_set(cursor, NULL, buffer, first);
+}
+
+/* Moves the stream to its next half buffer, the first one follows the command */
+static inline void spi_stream_next(spi_stream_t* stream, spi_cursor_t* cursor){
+    
+    if (stream->half == SPI_STREAM_COMMAND || stream->half + 1 == 2 * stream->nr_buffers) stream->half = 0;
+    else stream->half++;
+    
+    spi_stream_load(stream, cursor);
+}
+
+/* Reports a received half buffer to the watermark callback */
+static inline void spi_stream_signal(spi_stream_t* stream, uint8_t half){
+    
+    if (half != SPI_STREAM_COMMAND && stream->watermark != NULL) {
+        stream->watermark(stream->transaction.ctx, stream->buffers[half >> 1], (half & 1) ? SPI_STREAM_FULL : SPI_STREAM_HALF);
+    }
+}
+
+#if SPI_STATS
+/* Advances the elapsed and busy time of a bus to now */
+static inline void spi_stats_clock(spi_bus_t* bus){
+    
+    uint16_t now = SPI_STATS_TIME();
+    uint16_t delta = now - bus->stats_time;
+    
+    bus->stats_time = now;
+    bus->stats.elapsed += delta;
+    
+    if (bus->stats_busy) bus->stats.busy += delta;
+}
+
+/* Stamps a transaction before it is queued or sent polled */
+static inline void spi_stats_submit(spi_transaction_t* transaction){
+    transaction->submitted = SPI_STATS_TIME();
+}
+
+/* Keeps the deepest queue of a bus, producer only */
+static inline void spi_stats_queued(spi_bus_t* bus){
+    
+    uint16_t depth = spi_queue_depth(&bus->queue);
+    
+    if (depth > bus->stats.queue_peak) bus->stats.queue_peak = depth;
+}
+
+/* Counts bytes clocked for the device of the transaction on the bus */
+static inline void spi_stats_bytes(spi_bus_t* bus, device_t* device, spi_length_t length){
+    bus->stats.bytes += length;
+    device->stats.bytes += length;
+}
+
+/* Counts a transaction whose chip select is asserted next, once per transaction */
+static inline void spi_stats_start(spi_bus_t* bus, spi_transaction_t* transaction){
+    
+    spi_stats_clock(bus);
+    
+    uint16_t latency = bus->stats_time - transaction->submitted;
+    
+    if (latency > bus->stats.max_latency) bus->stats.max_latency = latency;
+    
+    bus->stats_busy = 1;
+    bus->stats.cs_asserts++;
+    transaction->device->stats.transactions++;
+    
+    for (uint8_t i = 0; i < transaction->nr_segments; i++) {
+        spi_stats_bytes(bus, transaction->device, transaction->segments[i].length);
+    }
+}
+
+/* Counts the half buffer a stream moved on to */
+static inline void spi_stats_stream(spi_bus_t* bus, spi_stream_t* stream){
+    
+    spi_length_t first = stream->length / 2;
+    
+    spi_stats_bytes(bus, stream->transaction.device, (stream->half & 1) ? stream->length - first : first);
+}
+
+/* Ends the busy time of a bus once the chip select is released */
+static inline void spi_stats_done(spi_bus_t* bus){
+    spi_stats_clock(bus);
+    bus->stats_busy = 0;
+}
+#else
+#define spi_stats_submit(transaction)
+#define spi_stats_queued(bus)
+#define spi_stats_start(bus, transaction)
+#define spi_stats_stream(bus, stream)
+#define spi_stats_done(bus)
+#endif
+
+#if SPI_TRACE
+/* Records an event of a transaction with the index of its device */
+static inline void spi_trace(spi_trace_event_t event, const device_t* device, uint8_t arg){
+    spi_trace_record(event, (device != NULL) ? device->id : SPI_TRACE_NO_DEVICE, arg);
+}
+
+/* Records a segment switch, the cursor moved on from the previous segment pointer */
+static inline void spi_trace_segment(const spi_bus_t* bus, const spi_cursor_t* cursor, const spi_segment_t* previous){
+    if (cursor->segment != previous) {
+        spi_trace(SPI_TRACE_SEGMENT, bus->transaction->device, (uint8_t)(cursor->segment - bus->transaction->segments - 1));
+    }
+}
+#else
+#define spi_trace(event, device, arg)
+#define spi_trace_segment(bus, cursor, previous) ((void)(previous))
+#endif
+
+/* Hands a finished transaction back to its owner */
+static inline void spi_transaction_done(spi_transaction_t* transaction, spi_error_t status){
+    
+    spi_trace(SPI_TRACE_DONE, transaction->device, status);
+    
+    if (transaction->callback != NULL) {
+        transaction->callback(transaction->ctx, status);
+    }
+    
+    spi_completion_signal(transaction->handle, status);
+    
+    /* Transactions that are not part of the payload pool belong to the caller and are ignored */
+    payload_free_spi((payload_t*)transaction);
+}
+
+/* 
+ * Starts a pending stream, or dequeues the next transaction of the bus and loads its first segment into the tx cursor.
+ * Transactions without a single byte complete right away. Returns 0 if the queue ran empty.
+ */
+static inline uint8_t spi_bus_dequeue(spi_bus_t* bus){
+    
+    spi_transaction_t* transaction;
+    spi_stream_t* stream = bus->stream;
+    
+    /* A pending stream keeps the bus until it is stopped */
+    if (stream != NULL) {
+        stream->half = SPI_STREAM_COMMAND;
+        spi_cursor_load(&bus->tx, &stream->transaction);
+        if (!spi_cursor_next(&bus->tx)) {
+            spi_stream_next(stream, &bus->tx);
+            spi_stats_stream(bus, stream);
+        }
+        bus->transaction = &stream->transaction;
+        spi_stats_start(bus, bus->transaction);
+        return 1;
+    }
+    
+    while ((transaction = spi_queue_dequeue(&bus->queue)) != NULL) {
+        
+        spi_cursor_load(&bus->tx, transaction);
+        
+        if (spi_cursor_next(&bus->tx)) {
+            bus->transaction = transaction;
+            spi_stats_start(bus, transaction);
+            return 1;
+        }
+        
+        spi_transaction_done(transaction, SPI_NO_ERROR);
+    }
+    
+    bus->transaction = NULL;
+    
+    return 0;
+}
+
+/* Makes a device the programmed device of its bus. Returns 0 if it already was. */
+static inline uint8_t spi_bus_select(spi_bus_t* bus, device_t* device){
+    
+    if (bus->device == device) return 0;
+    
+    bus->device = device;
+    bus->fill = device->fill;
+    
+    return 1;
+}
+
+/* Buses of <spi_mspim.c>, NULL if the USART is not enabled in <spi_config.h> */
+spi_bus_t* spi_mspim_bus(spi_bus_id_t);
+
+/* Bus of <spi_soft.c>, only defined if SPI_SOFT is set in <spi_config.h> */
+spi_bus_t* spi_soft_bus(void);
+
+/* Bus of <spi_buffered.c>, only defined if SPI_BUFFERED is set in <spi_config.h> */
+spi_bus_t* spi_buffered_bus(void);
+
+#endif /* SPI_BUS_H_ */
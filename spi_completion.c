@@ -0,0 +1,200 @@
+/*************************************************************************
+* Title     : SPI Completion Handles
+* Author    : Dimitri Dening
+* Created   : 17.10.2026 15:24:08
+* Software  : Microchip Studio V7
+* Hardware  : Atmega1284P
+
+DESCRIPTION:
+    Static table of completion slots addressed by spi_handle_t.
+USAGE:
+    see <spi_completion.h>
+NOTES:
+    Slots are taken round robin, so the slot that completed longest ago
+    is reused first. Signal runs in ISR or main loop context, acquire and
+    poll update the table inside an ATOMIC_BLOCK. The sleep counters are
+    only written by the waits in the main loop.
+*************************************************************************/
+
+/* General libraries */
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+#include <util/atomic.h>
+
+/* User defined libraries */
+#include "spi.h"
+
+#define SPI_HANDLE_SLOT(handle) ((handle) & 0x0F)
+#define SPI_HANDLE_GENERATION(handle) ((handle) >> 4)
+
+static uint8_t generation[SPI_HANDLES];
+
+static volatile uint8_t pending[SPI_HANDLES];
+
+static volatile spi_error_t status[SPI_HANDLES];
+
+static uint8_t next_slot;
+
+#if SPI_STATS
+static spi_sleep_stats_t sleep_stats;
+#endif
+
+void spi_completion_init(void){
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+
+        for (uint8_t i = 0; i < SPI_HANDLES; i++) {
+            generation[i] = 0;
+            pending[i] = 0;
+            status[i] = SPI_NO_ERROR;
+        }
+
+        next_slot = 0;
+    }
+}
+
+spi_handle_t spi_completion_acquire(void){
+
+    spi_handle_t handle = SPI_HANDLE_NONE;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+
+        for (uint8_t n = 0; n < SPI_HANDLES; n++) {
+
+            uint8_t slot = (next_slot + n) % SPI_HANDLES;
+
+            if (pending[slot]) continue;
+
+            /* Generation 0 is never used, so no handle equals SPI_HANDLE_NONE */
+            generation[slot] = generation[slot] % 15 + 1;
+            pending[slot] = 1;
+            next_slot = (slot + 1) % SPI_HANDLES;
+
+            handle = (spi_handle_t)(generation[slot] << 4 | slot);
+            break;
+        }
+    }
+
+    return handle;
+}
+
+void spi_completion_signal(spi_handle_t handle, spi_error_t error){
+
+    if (handle == SPI_HANDLE_NONE) return;
+
+    uint8_t slot = SPI_HANDLE_SLOT(handle);
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        if (generation[slot] == SPI_HANDLE_GENERATION(handle)) {
+            status[slot] = error;
+            pending[slot] = 0;
+        }
+    }
+}
+
+uint8_t spi_poll(spi_handle_t handle, spi_error_t* error){
+
+    uint8_t done = 1;
+
+    /* Submissions without a free slot were refused */
+    *error = (handle == SPI_HANDLE_NONE) ? SPI_ERR_BUFFER_OVERFLOW : SPI_ERR_NOT_DEFINED;
+
+    if (handle == SPI_HANDLE_NONE || SPI_HANDLE_SLOT(handle) >= SPI_HANDLES) return done;
+
+    uint8_t slot = SPI_HANDLE_SLOT(handle);
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        /* A reused slot means the transaction completed long ago */
+        if (generation[slot] == SPI_HANDLE_GENERATION(handle)) {
+            done = !pending[slot];
+            *error = status[slot];
+        }
+    }
+
+    return done;
+}
+
+/* 
+ * Any interrupt ends the idle sleep, so the condition is checked again after each one. Every
+ * pass is shorter than a period of SPI_STATS_TIME(), the wait as a whole may be longer.
+ */
+void spi_sleep_until(uint8_t (*done)(void*), void* ctx){
+    
+#if SPI_STATS
+    uint16_t last = SPI_STATS_TIME();
+    
+    sleep_stats.waits++;
+#endif
+    
+    set_sleep_mode(SLEEP_MODE_IDLE);
+    
+    for (;;) {
+        
+        cli();
+        
+        if (done(ctx)) break;
+        
+#if SPI_STATS
+        uint16_t now = SPI_STATS_TIME();
+        
+        sleep_stats.awake += (uint16_t)(now - last);
+        last = now;
+#endif
+        
+        /* sei() delays interrupts by one instruction, so no completion is missed before the sleep */
+        sleep_enable();
+        sei();
+        sleep_cpu();
+        sleep_disable();
+        
+#if SPI_STATS
+        now = SPI_STATS_TIME();
+        
+        sleep_stats.slept += (uint16_t)(now - last);
+        sleep_stats.sleeps++;
+        last = now;
+#endif
+    }
+    
+#if SPI_STATS
+    sleep_stats.awake += (uint16_t)(SPI_STATS_TIME() - last);
+#endif
+    
+    sei();
+}
+
+/* Handle and final status of spi_wait() */
+typedef struct {
+    spi_handle_t handle;
+    spi_error_t error;
+} spi_wait_t;
+
+static uint8_t spi_wait_done(void* ctx){
+    
+    spi_wait_t* wait = ctx;
+    
+    return spi_poll(wait->handle, &wait->error);
+}
+
+spi_error_t spi_wait(spi_handle_t handle){
+    
+    spi_wait_t wait = { .handle = handle };
+    
+    spi_sleep_until(spi_wait_done, &wait);
+    
+    return wait.error;
+}
+
+void spi_sleep_stats(spi_sleep_stats_t* stats){
+#if SPI_STATS
+    *stats = sleep_stats;
+#else
+    memset(stats, 0, sizeof(*stats));
+#endif
+}
+
+void spi_sleep_stats_reset(void){
+#if SPI_STATS
+    memset(&sleep_stats, 0, sizeof(sleep_stats));
+#endif
+}
@@ -0,0 +1,114 @@
+/*************************************************************************
+* Title		: SPI Completion Handles
+* Author	: Dimitri Dening
+* Created	: 17.10.2026 15:24:08
+* Software	: Microchip Studio V7
+* Hardware	: Atmega1284P
+* License	: MIT License
+* Usage		: see Doxygen manual
+*
+*       Copyright (C) 2021 Dimitri Dening
+*
+*       Permission is hereby granted, free of charge, to any person obtaining a copy
+*       of this software and associated documentation files (the "Software"), to deal
+*       in the Software without restriction, including without limitation the rights
+*       to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*       copies of the Software, and to permit persons to whom the Software is
+*       furnished to do so, subject to the following conditions:
+*
+*       The above copyright notice and this permission notice shall be included in all
+*       copies or substantial portions of the Software.
+*
+*       THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*       IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*       FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*       AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*       LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*       OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*       SOFTWARE.
+*
+* NOTES:
+*	This file should only be included from <spi.h>, never directly.
+*************************************************************************/
+
+/**
+@file spi_completion.h
+@author Dimitri Dening
+@date 17.10.2026
+@copyright (C) 2021 Dimitri Dening, MIT License
+@brief Completion handles returned by spi_transfer(), spi_write(), spi_read() and spi_read_write().
+
+A handle names one submitted transaction. It can be polled with spi_poll() or waited on with
+spi_wait(), which puts the CPU into idle sleep until the transaction completed. Both report
+the final spi_error_t, including errors that already occurred at submission.
+The transaction callback is called with the ctx pointer of the transaction and the same status,
+right before the handle completes. spi_wait_idle() sleeps until every bus ran out of transactions.
+
+@code
+    spi_handle_t handle = spi_read(payload, container);
+
+    // ... other work while the bus is busy
+
+    if (spi_wait(handle) != SPI_NO_ERROR) {
+        // container is not valid
+    }
+@endcode
+
+Handles are a slot number and a generation in one byte, the slots live in a static table of
+SPI_HANDLES entries. A slot is reused once its transaction completed, so a handle stays valid
+until SPI_HANDLES further transactions have completed. After that SPI_ERR_NOT_DEFINED is reported.
+The generation counts 1 to 15 and wraps, so once a slot was reused 15 times an old handle names
+it again and reports the status of whichever transaction holds the slot now. Poll or wait for a
+handle before SPI_HANDLES * 15 further submissions.
+With SPI_HANDLES transactions in flight a submission is refused: the transaction is not queued,
+its callback is called with SPI_ERR_BUFFER_OVERFLOW and SPI_HANDLE_NONE is returned, for which
+spi_poll() and spi_wait() report SPI_ERR_BUFFER_OVERFLOW at once. A transaction is therefore
+never in flight without a handle that spi_wait() returns for only after it completed.
+
+Every interrupt wakes the CPU, on an interrupt driven bus that is once per byte. The wait checks
+its condition and goes back to sleep until the interrupt that completes the transaction, or the one
+that finds the queue empty, is the last. With SPI_STATS the waits count the ticks of SPI_STATS_TIME()
+they slept and the ticks they were awake, see spi_sleep_stats_t. The interrupt that ends a sleep
+runs before the CPU returns from it and is counted as sleep.
+
+@note This file should only be included from <spi.h>, never directly.
+@bug No known bugs.
+*/
+#ifndef SPI_COMPLETION_H_
+#define SPI_COMPLETION_H_
+
+#include <stdint.h>
+
+#if SPI_HANDLES < 1 || SPI_HANDLES > 16
+#error "SPI_HANDLES has to be between 1 and 16"
+#endif
+
+/* Slot in the low nibble, generation 1 to 15 in the high nibble */
+typedef uint8_t spi_handle_t;
+
+/* No slot was free at submission, the transaction was not queued */
+#define SPI_HANDLE_NONE 0
+
+void spi_completion_init(void);
+
+/* Takes a free slot for a new transaction, called by the driver on submission */
+spi_handle_t spi_completion_acquire(void);
+
+/* Completes a handle with the final status, called by the driver from any context */
+void spi_completion_signal(spi_handle_t, spi_error_t);
+
+/* Returns 1 and stores the final status once the transaction completed, 0 while it is pending */
+uint8_t spi_poll(spi_handle_t, spi_error_t* status);
+
+/* Sleeps until the transaction completed and returns its final status. Enables interrupts. */
+spi_error_t spi_wait(spi_handle_t);
+
+/* Sleeps in idle mode until done(ctx) returns 1, done is called with interrupts disabled. Enables interrupts. */
+void spi_sleep_until(uint8_t (*done)(void*), void* ctx);
+
+/* Copies the sleep counters of the waits, zero without SPI_STATS */
+void spi_sleep_stats(spi_sleep_stats_t*);
+
+void spi_sleep_stats_reset(void);
+
+#endif /* SPI_COMPLETION_H_ */
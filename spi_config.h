@@ -33,17 +33,196 @@
 #ifndef SPI_CONFIG_H_
 #define SPI_CONFIG_H_
 
+/* CPU frequency in Hz, used to derive clock rates, baud rates and the poll policy. Define it for the whole build. */
+#ifndef F_CPU
+#error "F_CPU has to be defined before <spi.h> is included, e.g. -DF_CPU=10000000UL"
+#endif
+
+/* Number of payloads in the static payload pool */
+#ifndef SPI_PAYLOAD_POOL_SIZE
+#define SPI_PAYLOAD_POOL_SIZE 8
+#endif
+
+/* Number of entries in the static device table */
+#ifndef SPI_MAX_DEVICES
+#define SPI_MAX_DEVICES 8
+#endif
+
+/* Number of transactions that can be queued at the same time per priority level, a power of two */
+#ifndef SPI_QUEUE_SIZE
+#define SPI_QUEUE_SIZE SPI_PAYLOAD_POOL_SIZE
+#endif
+
+/* Number of completion handles that can be tracked at the same time, at most 16 */
+#ifndef SPI_HANDLES
+#define SPI_HANDLES 8
+#endif
+
+/* A lower priority level is served after being passed over this many times, 0 disables aging */
+#ifndef SPI_QUEUE_AGING
+#define SPI_QUEUE_AGING 4
+#endif
+
+/* 
+ * CPU cycles the interrupt engine spends per byte of a transfer. A byte shifted out in less
+ * time keeps the CPU busier interrupt driven than polled.
+ */
+#ifndef SPI_POLL_BYTE_CYCLES
+#define SPI_POLL_BYTE_CYCLES 32
+#endif
+
+/* 
+ * CPU cycles the interrupt engine spends per transfer on top of its bytes: queueing, the start,
+ * the end of the last segment and the completion. Estimated for the C code on the ATmega1284P,
+ * the host simulation charges no cycles for C code and can't measure it.
+ */
+#ifndef SPI_POLL_START_CYCLES
+#define SPI_POLL_START_CYCLES 160
+#endif
+
+/* 
+ * Transfers are sent polled while their bus time is at most SPI_POLL_START_CYCLES plus
+ * SPI_POLL_BYTE_CYCLES per byte, what the interrupt engine would cost, and at most this many
+ * CPU cycles. The first bound depends on the length: the longer a transfer, the less its
+ * overhead weighs and the slower clocks stop polling after fewer bytes. The second one bounds
+ * the time a polled transfer blocks the main loop and the queue on fast clocks. 0 disables polling,
+ * UINT32_MAX polls every transfer of up to 255 bytes.
+ */
+#ifndef SPI_POLL_THRESHOLD
+#define SPI_POLL_THRESHOLD (8 * SPI_POLL_START_CYCLES)
+#endif
+
+/* Set to 1 to run USART0 or USART1 as an additional SPI master bus (MSPIM), see <spi_mspim.c> */
+#ifndef SPI_MSPIM_USART0
+#define SPI_MSPIM_USART0 0
+#endif
+
+#ifndef SPI_MSPIM_USART1
+#define SPI_MSPIM_USART1 0
+#endif
+
+/* Set to 1 to run the SPI of an AVR Dx or megaAVR 0-series part in buffered mode as a bus, see <spi_buffered.c> */
+#ifndef SPI_BUFFERED
+#define SPI_BUFFERED 0
+#endif
+
+/* Set to 1 to run a bit-banged SPI master on the SPI_SOFT_* pins as an additional bus, see <spi_soft.c> */
+#ifndef SPI_SOFT
+#define SPI_SOFT 0
+#endif
+
+/* Pins of the bit-banged bus, any GPIO outside of the other buses. MISO is read from SPI_SOFT_MISO_PIN. */
+#ifndef SPI_SOFT_SCK_PORT
+#define SPI_SOFT_SCK_PORT PORTA
+#define SPI_SOFT_SCK PORTA0
+#endif
+
+#ifndef SPI_SOFT_MOSI_PORT
+#define SPI_SOFT_MOSI_PORT PORTA
+#define SPI_SOFT_MOSI PORTA1
+#endif
+
+#ifndef SPI_SOFT_MISO_PORT
+#define SPI_SOFT_MISO_PORT PORTA
+#define SPI_SOFT_MISO_PIN PINA
+#define SPI_SOFT_MISO PORTA2
+#endif
+
+/* 
+ * Width of segment and payload lengths: 8, 16 or 32 bit. Longer segments are clocked in chunks of
+ * up to 255 bytes, so the interrupt keeps counting a single byte either way. An AT45DB page does
+ * not fit 8 bit, leave at45db.c and at45db_cache.c out of such builds.
+ */
+#ifndef SPI_LENGTH_BITS
+#define SPI_LENGTH_BITS 16
+#endif
+
+/* Number of entries in the error log, a power of two. The oldest entry is overwritten when it is full. */
+#ifndef SPI_ERROR_LOG_SIZE
+#define SPI_ERROR_LOG_SIZE 8
+#endif
+
+/* Period in ms of the timer interrupt that calls spi_error_tick() */
+#ifndef SPI_ERROR_TICK_MS
+#define SPI_ERROR_TICK_MS 10
+#endif
+
+/* Set to 1 to show logged errors as LED sequences on LED_ERROR of <led_lib.h> */
+#ifndef SPI_ERROR_LED
+#define SPI_ERROR_LED 0
+#endif
+
+/* Set to 1 to count transactions, bytes, busy time and latencies per bus and device, see <spi_stats.h> */
+#ifndef SPI_STATS
+#define SPI_STATS 0
+#endif
+
+/* 
+ * Free-running 16 bit time base of the statistics. Its 16 bit read is not atomic against interrupts
+ * that read it as well, which only skews a single measurement.
+ */
+#ifndef SPI_STATS_TIME
+#define SPI_STATS_TIME() TCNT1
+#endif
+
+/* Set to 1 to record driver events into a ring of timestamped entries, see <spi_trace.h> */
+#ifndef SPI_TRACE
+#define SPI_TRACE 0
+#endif
+
+/* Number of entries in the trace ring, a power of two. The oldest entry is overwritten when it is full. */
+#ifndef SPI_TRACE_SIZE
+#define SPI_TRACE_SIZE 64
+#endif
+
+/* Time base of the trace entries */
+#ifndef SPI_TRACE_TIME
+#define SPI_TRACE_TIME() SPI_STATS_TIME()
+#endif
+
+/* Default byte shifted out by segments without a tx buffer */
+#ifndef SPI_FILL_BYTE
+#define SPI_FILL_BYTE 0x00
+#endif
+
+/* 
+ * Set to 1 if every device of the native SPI sends SPI_FILL_BYTE, e.g. when all of them come from
+ * SPI_DEVICE(). Its interrupt and polled loops then shift out a constant instead of loading the
+ * fill byte of the device, and native devices with another fill byte are rejected.
+ */
+#ifndef SPI_FIXED_FILL
+#define SPI_FIXED_FILL 0
+#endif
+
+/* Bus settings of spi_config, the defaults passed to spi_init() */
+#ifndef SPI_DEFAULT_DATA_ORDER
+#define SPI_DEFAULT_DATA_ORDER SPI_MSB
+#endif
+
+#ifndef SPI_DEFAULT_MODE
+#define SPI_DEFAULT_MODE SPI_MODE3
+#endif
+
+#ifndef SPI_DEFAULT_CLOCK_RATE
+#define SPI_DEFAULT_CLOCK_RATE SPI_CLOCK_DIV2
+#endif
+
 typedef enum {
     SPI_MSB = 0x00,
     SPI_LSB = 0x01
 } data_order_t;
 
-typedef enum mode_t {
+typedef enum {
     SPI_MODE0 = 0x00, // CPOL = 0, CPHA = 0
     SPI_MODE1 = 0x01, // CPOL = 0, CPHA = 1
     SPI_MODE2 = 0x02, // CPOL = 1, CPHA = 0
     SPI_MODE3 = 0x03  // CPOL = 1, CPHA = 1
-} mode_t;
+} spi_mode_t;
+
+/* Former name, kept for C code only since C++ hosts declare the POSIX mode_t */
+#ifndef __cplusplus
+typedef spi_mode_t mode_t;
+#endif
 
 typedef enum {
     SPI_CLOCK_DIV2 = 0x04,
@@ -56,16 +235,37 @@ typedef enum {
     SPI_CLOCK_DIV128 = 0x03
 } clock_rate_t;
 
+/* Hardware that clocks a bus. Every bus has its own queue and interrupt. */
+typedef enum {
+    SPI_BUS_SPI,        // Native SPI
+    SPI_BUS_USART0,     // USART0 in master SPI mode
+    SPI_BUS_USART1,     // USART1 in master SPI mode
+    SPI_BUS_SOFT,       // Bit-banged on the SPI_SOFT_* pins
+    SPI_BUS_BUFFERED,   // SPI0 of the AVR Dx series in buffered mode
+    SPI_NR_BUSES
+} spi_bus_id_t;
+
 typedef struct spi_config_t {
     data_order_t data_order;
-    mode_t mode;
+    spi_mode_t mode;
     clock_rate_t clockrate;
+    uint32_t poll_threshold;
+    uint8_t fill_byte;
 } spi_config_t;
 
-static spi_config_t spi_config = {
-    .data_order = SPI_MSB,
-    .mode = SPI_MODE3,
-    .clockrate = SPI_CLOCK_DIV2
-};
+/* 
+ * Bus settings of a single device. A max_frequency of 0 keeps the clock rate the bus was initialized with.
+ * The fill byte is sent while only receiving, e.g. 0xFF for SD cards.
+ */
+typedef struct spi_device_config_t {
+    spi_bus_id_t bus;
+    data_order_t data_order;
+    spi_mode_t mode;
+    uint32_t max_frequency;
+    uint8_t fill_byte;
+} spi_device_config_t;
+
+/* Bus settings of spi_config, defined once in <spi.c> */
+extern spi_config_t spi_config;
 
 #endif /* SPI_CONFIG_H_ */
\ No newline at end of file
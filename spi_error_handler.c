@@ -9,88 +9,222 @@ USAGE:
     see <spi_error_handler.h>
 
 NOTES:
-
+    error_handler() runs in ISR and main loop context and only records the
+    error inside an ATOMIC_BLOCK. Printing and the LED sequence happen later,
+    in spi_error_report() and spi_error_tick().
 *************************************************************************/
 /* General libraries */
-#include <util/delay.h>
+#include <avr/pgmspace.h>
+#include <util/atomic.h>
 
 /* User defined libraries */
-#include "spi_error_handler.h"
+#include "spi.h"
 
-#define LED_DEBUG_OUTPUT  0
 #define UART_DEBUG_OUTPUT 1
 
 #if UART_DEBUG_OUTPUT
     #include "uart.h"
 #endif
 
-#if LED_DEBUG_OUTPUT
+#if SPI_ERROR_LED
     #include "led_lib.h"
 #endif
 
+#if (SPI_ERROR_LOG_SIZE & (SPI_ERROR_LOG_SIZE - 1)) != 0 || SPI_ERROR_LOG_SIZE == 0 || SPI_ERROR_LOG_SIZE > 128
+# error "SPI_ERROR_LOG_SIZE has to be a power of two between 1 and 128"
+#endif
+
+#define SECOND      (1000 / SPI_ERROR_TICK_MS)  // Ticks per second
+
 #define SHORT_PULSE 1	// 1s
 #define LONG_PULSE  3	// 3s
 #define SEQ_LEN		3
 #define REPEAT		2
 #define DELAY		4	// 4s
 
+#define NR_ERRORS   (SPI_ERR_NOT_DEFINED + 1)
+
+/* On, off after every pulse and the pause at the end of a repetition */
+#define STEPS       (REPEAT * (2 * SEQ_LEN + 1))
+
 typedef struct {
-    spi_error_t err;
-    uint16_t sequence[SEQ_LEN];
-    char* error_string;
+    uint8_t sequence[SEQ_LEN];
+    PGM_P error_string;
 } table_t;
 
-table_t error_table[] = {
-    //         ERROR                                        SEQUENCE								   ERROR STRING
-    //           |                                             |											|
-    //           |                                             |											|
-    //           |                                             |											|
-    //-------------------------------------------------------------------------------------------------------------------------------
-    {   SPI_NO_ERROR					,   {                                               }	,	"SPI_NO_ERROR"					},
-    {   SPI_ERR_BUFFER_OVERFLOW         ,   { SHORT_PULSE ,   SHORT_PULSE   ,   SHORT_PULSE }   ,	"SPI_ERR_BUFFER_OVERFLOW"       },
-    {   SPI_ERR_BUFFER_DATA_OVERWRITE   ,   { SHORT_PULSE ,   SHORT_PULSE   ,   LONG_PULSE  }   ,	"SPI_ERR_BUFFER_DATA_OVERWRITE" },
-    {   SPI_ERR_DATA_OVERFLOW           ,   { SHORT_PULSE ,   LONG_PULSE    ,   SHORT_PULSE }   ,	"SPI_ERR_DATA_OVERFLOW"			},
-    {   SPI_ERR_INVALID_PORT            ,   { SHORT_PULSE ,   LONG_PULSE    ,   LONG_PULSE  }   ,	"SPI_ERR_INVALID_PORT"			},
-    {   SPI_ERR_WRITE_COLLISION         ,   { LONG_PULSE  ,   SHORT_PULSE   ,   SHORT_PULSE }   ,	"SPI_ERR_WRITE_COLLISION"		},
-    {   SPI_ERR_FLUSH_FAILED            ,   { LONG_PULSE  ,   SHORT_PULSE   ,   LONG_PULSE  }   ,	"SPI_ERR_FLUSH_FAILED"			},
-    {   SPI_ERR_RECV_BUSY               ,   { LONG_PULSE  ,   LONG_PULSE    ,   SHORT_PULSE }   ,	"SPI_ERR_RECV_BUSY"				},
-    {   SPI_ERR_NOT_DEFINED             ,   { LONG_PULSE  ,   LONG_PULSE    ,   LONG_PULSE  }   ,	"SPI_ERR_NOT_DEFINED"			}
+static const char str_no_error[] PROGMEM            = "SPI_NO_ERROR";
+static const char str_buffer_overflow[] PROGMEM     = "SPI_ERR_BUFFER_OVERFLOW";
+static const char str_data_overwrite[] PROGMEM      = "SPI_ERR_BUFFER_DATA_OVERWRITE";
+static const char str_data_overflow[] PROGMEM       = "SPI_ERR_DATA_OVERFLOW";
+static const char str_invalid_port[] PROGMEM        = "SPI_ERR_INVALID_PORT";
+static const char str_write_collision[] PROGMEM     = "SPI_ERR_WRITE_COLLISION";
+static const char str_flush_failed[] PROGMEM        = "SPI_ERR_FLUSH_FAILED";
+static const char str_recv_busy[] PROGMEM           = "SPI_ERR_RECV_BUSY";
+static const char str_not_defined[] PROGMEM         = "SPI_ERR_NOT_DEFINED";
+
+/* Indexed by spi_error_t */
+static const table_t error_table[NR_ERRORS] PROGMEM = {
+    //                    SEQUENCE								   ERROR STRING
+    //                       |											|
+    //                       |											|
+    //-------------------------------------------------------------------------------------------
+    {   { 0                                             }	,	str_no_error			},
+    {   { SHORT_PULSE ,   SHORT_PULSE   ,   SHORT_PULSE }   ,	str_buffer_overflow		},
+    {   { SHORT_PULSE ,   SHORT_PULSE   ,   LONG_PULSE  }   ,	str_data_overwrite		},
+    {   { SHORT_PULSE ,   LONG_PULSE    ,   SHORT_PULSE }   ,	str_data_overflow		},
+    {   { SHORT_PULSE ,   LONG_PULSE    ,   LONG_PULSE  }   ,	str_invalid_port		},
+    {   { LONG_PULSE  ,   SHORT_PULSE   ,   SHORT_PULSE }   ,	str_write_collision		},
+    {   { LONG_PULSE  ,   SHORT_PULSE   ,   LONG_PULSE  }   ,	str_flush_failed		},
+    {   { LONG_PULSE  ,   LONG_PULSE    ,   SHORT_PULSE }   ,	str_recv_busy			},
+    {   { LONG_PULSE  ,   LONG_PULSE    ,   LONG_PULSE  }   ,	str_not_defined			}
 };
 
-static void delay(int t) {
-    while (t--) _delay_ms(1000);
-}
+static spi_error_entry_t error_log[SPI_ERROR_LOG_SIZE];
+static uint8_t log_head;                // Next entry to write
+static uint8_t log_tail;                // Oldest unread entry
+static uint16_t log_lost;               // Entries overwritten before they were read
 
-static void error_led(spi_error_t error) {
+static uint16_t counters[NR_ERRORS];
 
-#if UART_DEBUG_OUTPUT
-    uart_put("%s %s (%d)", "[spi error]:", error_table[error].error_string, error);
+static volatile uint32_t ticks;
 
+#if SPI_ERROR_LED
+/* LED sequence, only touched by spi_error_tick() and error_handler() */
+static uint8_t led_error;               // Error being shown, SPI_NO_ERROR while idle
+static uint8_t led_next;                // Latest error logged while a sequence was running
+static uint8_t led_step;
+static uint16_t led_left;               // Ticks left in the current step
 #endif
 
-#if LED_DEBUG_OUTPUT
-    for (int loop = 0; loop < REPEAT; loop++) {
-        for (uint8_t seq = 0; seq < SEQ_LEN; seq++) {
-            led_toggle(LED_ERROR); delay(error_table[error].sequence[seq]);
-            led_toggle(LED_ERROR); delay(1);
+spi_error_t error_handler(spi_error_t error) {
+
+    if (error == SPI_NO_ERROR) return SPI_NO_ERROR;
+
+    if (error >= NR_ERRORS) error = SPI_ERR_NOT_DEFINED;
+
+#if SPI_TRACE
+    spi_trace_record(SPI_TRACE_ERROR, SPI_TRACE_NO_DEVICE, error);
+#endif
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+
+        /* A full log drops its oldest entry */
+        if ((uint8_t)(log_head - log_tail) == SPI_ERROR_LOG_SIZE) {
+            log_tail++;
+            if (log_lost != UINT16_MAX) log_lost++;
+        }
+
+        error_log[log_head % SPI_ERROR_LOG_SIZE].tick = ticks;
+        error_log[log_head % SPI_ERROR_LOG_SIZE].error = error;
+        log_head++;
+
+        if (counters[error] != UINT16_MAX) counters[error]++;
+
+#if SPI_ERROR_LED
+        if (led_error == SPI_NO_ERROR) {
+            led_error = error;
+            led_step = 0;
+            led_left = 0;
+        }
+        else {
+            led_next = error;
         }
-        delay(DELAY);
+#endif
     }
+
+    return error;
+}
+
+#if SPI_ERROR_LED
+/* Duration of a step in ticks, the LED is toggled when a step starts except for the pause */
+static uint16_t led_duration(uint8_t error, uint8_t step) {
+
+    uint8_t phase = step % (2 * SEQ_LEN + 1);
+
+    if (phase == 2 * SEQ_LEN) return DELAY * SECOND;
+    if (phase & 1) return SECOND;
+
+    return pgm_read_byte(&error_table[error].sequence[phase / 2]) * SECOND;
+}
 #endif
 
-    return;
+void spi_error_tick(void) {
+
+    ticks++;
+
+#if SPI_ERROR_LED
+    if (led_error == SPI_NO_ERROR) return;
+
+    if (led_left != 0 && --led_left != 0) return;
+
+    /* The previous step is over */
+    if (led_step == STEPS) {
+        led_error = led_next;
+        led_next = SPI_NO_ERROR;
+        led_step = 0;
+        if (led_error == SPI_NO_ERROR) return;
+    }
+
+    if (led_step % (2 * SEQ_LEN + 1) != 2 * SEQ_LEN) led_toggle(LED_ERROR);
+
+    led_left = led_duration(led_error, led_step);
+    led_step++;
+#endif
 }
 
-spi_error_t error_handler(spi_error_t error) {
-    switch (error) {
-    case SPI_NO_ERROR:                                      return SPI_NO_ERROR;                    break;
-    case SPI_ERR_BUFFER_OVERFLOW:       error_led(error);	return SPI_ERR_BUFFER_OVERFLOW;         break;
-    case SPI_ERR_BUFFER_DATA_OVERWRITE: error_led(error);	return SPI_ERR_BUFFER_DATA_OVERWRITE;   break;
-    case SPI_ERR_DATA_OVERFLOW:         error_led(error);	return SPI_ERR_DATA_OVERFLOW;           break;
-    case SPI_ERR_INVALID_PORT:          error_led(error);	return SPI_ERR_INVALID_PORT;            break;
-    case SPI_ERR_WRITE_COLLISION:       error_led(error);	return SPI_ERR_WRITE_COLLISION;         break;
-    case SPI_ERR_FLUSH_FAILED:          error_led(error);	return SPI_ERR_FLUSH_FAILED;            break;
-    case SPI_ERR_RECV_BUSY:             error_led(error);	return SPI_ERR_RECV_BUSY;               break;
-    default:                            error_led(error);	return SPI_ERR_NOT_DEFINED;
+uint8_t spi_error_log_read(spi_error_entry_t* entry) {
+
+    uint8_t read = 0;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        if (log_tail != log_head) {
+            *entry = error_log[log_tail % SPI_ERROR_LOG_SIZE];
+            log_tail++;
+            read = 1;
+        }
     }
-}
\ No newline at end of file
+
+    return read;
+}
+
+void spi_error_stats(spi_error_stats_t* stats) {
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        for (uint8_t i = 0; i < NR_ERRORS; i++) stats->count[i] = counters[i];
+        stats->lost = log_lost;
+        stats->ticks = ticks;
+    }
+}
+
+void spi_error_clear(void) {
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        for (uint8_t i = 0; i < NR_ERRORS; i++) counters[i] = 0;
+        log_tail = log_head;
+        log_lost = 0;
+    }
+}
+
+void spi_error_name(spi_error_t error, char* buffer, uint8_t size) {
+
+    if (size == 0) return;
+
+    if (error >= NR_ERRORS) error = SPI_ERR_NOT_DEFINED;
+
+    strncpy_P(buffer, (PGM_P)pgm_read_ptr(&error_table[error].error_string), size - 1);
+
+    buffer[size - 1] = '\0';
+}
+
+void spi_error_report(void) {
+
+#if UART_DEBUG_OUTPUT
+    spi_error_entry_t entry;
+    char name[32];
+
+    while (spi_error_log_read(&entry)) {
+        spi_error_name(entry.error, name, sizeof(name));
+        uart_put("%s %s (%d) %s %lu", "[spi error]:", name, entry.error, "tick", (unsigned long)entry.tick);
+    }
+#endif
+}
@@ -48,10 +48,10 @@
 * ERRORS
 *
 *   SPI_BUFFER_OVERFLOW:
-*       1.  More data written to the buffer than allowed.
-*           Change TX_BUFFER_SIZE in the <spi_buffer.h> if needed.
-*       2.  More bytes requested than the rx_buffer can store.
-*           Change RX_BUFFER_SIZE in the <spi_buffer.h> if needed.
+*       1.  More payloads queued than allowed.
+*           Change SPI_QUEUE_SIZE in the <spi_config.h> if needed.
+*       2.  No free payload left in the pool.
+*           Change SPI_PAYLOAD_POOL_SIZE in the <spi_config.h> if needed.
 *
 *   SPI_BUFFER_DATA_OVERWRITE:
 *       If tasks are created faster than the MCU can process current tasks in the buffer, 
@@ -73,10 +73,12 @@
 *
 *   SPI_FLUSH_FAILED:
 *       The flush command was executed while the SPI was still active.
+*       Also the final status of transactions discarded by a flush.
 *
 *   SPI_RECV_BUSY:
 *       The SPI is currently busy sending other data and
 *       can't initiate another receive command.
+*       Also reported if a stream is started while another one is pending or running.
 *
 *   SPI_NOT_DEFINED:
 *       Errors that are either not defined yet or are general errors (e.g. memory allocation failure).
@@ -89,17 +91,37 @@
 @copyright (C) 2021 Dimitri Dening, MIT License
 @brief Error handler for SPI.
 
-Indicates the defined SPI errors on the STK600 by a unique led sequence.
-The selected <ERROR_LED> can be changed in the <led_lib.h>.
+error_handler() never blocks. It records the error with the current tick in a ring log of
+SPI_ERROR_LOG_SIZE entries and counts it per error code, then returns. A full log overwrites
+its oldest entry and counts it as lost.
+
+The log is read with spi_error_log_read(), or printed over the UART from the main loop
+with spi_error_report(). The error names are kept in flash.
+
+With SPI_ERROR_LED set in <spi_config.h>, logged errors are shown on the STK600 by a unique
+led sequence. The selected <ERROR_LED> can be changed in the <led_lib.h>. The sequence is
+stepped by spi_error_tick(), which the application calls from a timer interrupt every
+SPI_ERROR_TICK_MS ms. An error logged while a sequence is running is shown next, and only
+the latest such error is kept.
+
+@code
+    ISR(TIMER0_COMPA_vect) {
+        spi_error_tick();
+    }
+
+    for (;;) {
+        spi_error_report();
+        // ...
+    }
+@endcode
 
 @bug No known bugs.
-@warning The led sequence is produced by using the <util/delay.h> library. This could have 
-an effect on other peripherals used at the same time, which are not depended on the SPI.
-@todo Implement an interrupt based delay with e.g. timer8.
 */
 #ifndef SPI_ERROR_HANDLER_H_
 #define SPI_ERROR_HANDLER_H_
 
+#include <stdint.h>
+
 /* Describes possible error states */
 typedef enum spi_error_t {
     SPI_NO_ERROR,
@@ -113,13 +135,42 @@ typedef enum spi_error_t {
     SPI_ERR_NOT_DEFINED
 } spi_error_t;
 
+typedef struct spi_error_entry_t {
+    uint32_t tick;              // spi_error_tick() calls before the error occurred
+    spi_error_t error;
+} spi_error_entry_t;
+
+/* Snapshot of the error counters */
+typedef struct spi_error_stats_t {
+    uint16_t count[SPI_ERR_NOT_DEFINED + 1];    // Indexed by spi_error_t, saturating
+    uint16_t lost;                              // Log entries overwritten before they were read
+    uint32_t ticks;
+} spi_error_stats_t;
+
 /**
  * @brief   Prototype of an error handler.
  *
- * If an error occurs, a specific led sequence is shown on the STK600.
+ * Logs and counts the error, safe in interrupt context.
  *
  * @return  Returns an error code.
  */
 spi_error_t error_handler(spi_error_t error);
 
+/* Advances the log time and the led sequence, call from a timer interrupt every SPI_ERROR_TICK_MS ms */
+void spi_error_tick(void);
+
+/* Takes the oldest entry from the log. Returns 0 if the log is empty. */
+uint8_t spi_error_log_read(spi_error_entry_t*);
+
+void spi_error_stats(spi_error_stats_t*);
+
+/* Resets the counters and empties the log */
+void spi_error_clear(void);
+
+/* Copies the name of an error from flash */
+void spi_error_name(spi_error_t, char* buffer, uint8_t size);
+
+/* Prints and removes every entry of the log over the UART, main loop only */
+void spi_error_report(void);
+
 #endif /* SPI_ERROR_HANDLER_H_ */
\ No newline at end of file
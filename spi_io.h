@@ -36,10 +36,11 @@
 @author Dimitri Dening
 @date 05.11.2021
 @copyright (C) 2021 Dimitri Dening, MIT License
-@brief Port declaration for the ATmega1284P.
+@brief Port declarations of the SPI and USART pins per MCU.
 
-This file provides the required port delcarations to use the built-in SPI.
-Extend this file according to the datasheet of your MCU.
+This file provides the port declarations of the classic SPI for the ATmega1284P, ATmega16 and
+ATmega2560, of the USARTs in master SPI mode for the ATmega1284P and of SPI0 in buffered mode
+for the AVR Dx and megaAVR 0-series. Extend this file according to the datasheet of your MCU.
 
 @note This file should only be included from <spi.h>, never directly.
 @bug No known bugs.
@@ -49,6 +50,18 @@ Extend this file according to the datasheet of your MCU.
 
 #include <avr/io.h>
 
+/* SPI of the AVR Dx and megaAVR 0-series in buffered mode Port Declaration, see <spi_buffered.c> */
+#if defined(__AVR_AVR128DA28__) || defined(__AVR_AVR128DA32__) || defined(__AVR_AVR128DA48__) || defined(__AVR_AVR128DA64__) || \
+    defined(__AVR_AVR128DB28__) || defined(__AVR_AVR128DB32__) || defined(__AVR_AVR128DB48__) || defined(__AVR_AVR128DB64__) || \
+    defined(__AVR_ATmega4809__) || defined(__AVR_ATmega4808__)
+#	define SPI_BUFFERED_MOSI	PIN4_bp
+#	define SPI_BUFFERED_MISO	PIN5_bp
+#	define SPI_BUFFERED_SCK	PIN6_bp
+#	define SPI_BUFFERED_SS	PIN7_bp
+#	define SPI_BUFFERED_PORT	VPORTA_OUT
+#	define SPI_BUFFERED_PORT_ALIAS	PORTA_OUT
+#endif
+
 /* SPI Port Declaration */
 #if defined(__AVR_ATmega1284P__) || defined(__AVR_ATmega16__)
 #	define SPI_SCK		PORTB7
@@ -57,6 +70,7 @@ Extend this file according to the datasheet of your MCU.
 #	define SPI_SS		PORTB4
 #	define SPI_PORT		PORTB
 #	define SPI_DDR		DDRB
+#	define SPI_PORT_ID	SPI_PORT_ID_B
 # elif defined(__AVR_ATmega2560__)
 #	define SPI_SCK		PB1
 #	define SPI_MOSI		PB2
@@ -64,10 +78,60 @@ Extend this file according to the datasheet of your MCU.
 #	define SPI_SS		PB0
 #	define SPI_PORT		PORTB
 #	define SPI_DDR		DDRB
+#	define SPI_PORT_ID	SPI_PORT_ID_B
 #else
-#  if !defined(__COMPILING_AVR_LIBC__)
+#  if !defined(__COMPILING_AVR_LIBC__) && !defined(SPI_BUFFERED_SCK)
 #    warning "Microcontroller not defined in <spi_io.h>"
 #  endif
 #endif
 
+/* 1 if the MCU has the classic SPI (SPCR, SPSR, SPDR), which runs as SPI_BUS_SPI */
+#ifndef SPI_NATIVE
+#  if defined(SPCR)
+#    define SPI_NATIVE 1
+#  else
+#    define SPI_NATIVE 0
+#  endif
+#endif
+
+/* USART in master SPI mode (MSPIM) Port Declaration */
+#if defined(__AVR_ATmega1284P__)
+#	define SPI_MSPIM0_XCK	PORTB0
+#	define SPI_MSPIM0_XCK_PORT	PORTB
+#	define SPI_MSPIM0_TXD	PORTD1
+#	define SPI_MSPIM0_RXD	PORTD0
+#	define SPI_MSPIM0_PORT	PORTD
+#	define SPI_MSPIM1_XCK	PORTD4
+#	define SPI_MSPIM1_XCK_PORT	PORTD
+#	define SPI_MSPIM1_TXD	PORTD3
+#	define SPI_MSPIM1_RXD	PORTD2
+#	define SPI_MSPIM1_PORT	PORTD
+#endif
+
+/* Port letters as numbers, so that pins can be checked at compile time (see <spi_static.h>) */
+#define SPI_PORT_ID_A	0
+#define SPI_PORT_ID_B	1
+#define SPI_PORT_ID_C	2
+#define SPI_PORT_ID_D	3
+#define SPI_PORT_ID_E	4
+#define SPI_PORT_ID_F	5
+#define SPI_PORT_ID_G	6
+#define SPI_PORT_ID_H	7
+#define SPI_PORT_ID_J	8
+#define SPI_PORT_ID_K	9
+#define SPI_PORT_ID_L	10
+
+/* Data direction register of an output register */
+#if defined(VPORTA)
+/* AVR Dx and megaAVR 0-series: VPORTx.DIR directly precedes VPORTx.OUT, PORTx.OUT is preceded by DIRSET, DIRCLR and DIRTGL */
+#	include <stddef.h>
+#	include <stdint.h>
+#	define SPI_DDR_OF(port)	((uintptr_t)(port) < (uintptr_t)&PORTA \
+									? (port) - (offsetof(VPORT_t, OUT) - offsetof(VPORT_t, DIR)) \
+									: (port) - (offsetof(PORT_t, OUT) - offsetof(PORT_t, DIR)))
+#else
+/* Classic AVR: the registers of a port are laid out as PINx, DDRx, PORTx */
+#	define SPI_DDR_OF(port)	((port) - 1)
+#endif
+
 #endif /* SPI_IO_H_ */
\ No newline at end of file
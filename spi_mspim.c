@@ -0,0 +1,303 @@
+/*************************************************************************
+* Title     : SPI Master on USART (MSPIM)
+* Author    : Dimitri Dening
+* Created   : 17.10.2026 15:34:18
+* Software  : Microchip Studio V7
+* Hardware  : Atmega1284P
+        
+DESCRIPTION:
+    Runs USART0 and USART1 in master SPI mode as additional buses with
+    their own queue and ISR(USARTn_RX_vect).
+USAGE:
+    Set SPI_MSPIM_USART0 or SPI_MSPIM_USART1 to 1 in <spi_config.h>, call
+    spi_bus_init(SPI_BUS_USARTn, &config) and create devices with
+    spi_device_config_t.bus = SPI_BUS_USARTn. Everything else is <spi.h>.
+NOTES:
+    The transmitter is double-buffered: while one byte is shifted out the
+    next one already waits in UDRn, so bytes follow without a gap. The send
+    side runs one byte ahead of the receive side, which is why the bus keeps
+    a separate receive cursor. One interrupt per received byte refills UDRn.
+    The channel number is a constant in every call, so the register
+    selection below folds to direct I/O accesses.
+*************************************************************************/
+
+/* General libraries */
+#include <avr/interrupt.h>
+
+/* User defined libraries */
+#include "spi.h"
+#include "spi_bus.h"
+
+#if SPI_MSPIM_USART0 || SPI_MSPIM_USART1
+
+#if !defined(SPI_MSPIM0_XCK) || !defined(SPI_MSPIM1_XCK)
+#  error "MSPIM pins not defined in <spi_io.h>"
+#endif
+
+#define MSPIM_UDR(n)    (*((n) ? &UDR1 : &UDR0))
+#define MSPIM_UCSRA(n)  (*((n) ? &UCSR1A : &UCSR0A))
+#define MSPIM_UCSRB(n)  (*((n) ? &UCSR1B : &UCSR0B))
+#define MSPIM_UCSRC(n)  (*((n) ? &UCSR1C : &UCSR0C))
+#define MSPIM_UBRRL(n)  (*((n) ? &UBRR1L : &UBRR0L))
+#define MSPIM_UBRRH(n)  (*((n) ? &UBRR1H : &UBRR0H))
+
+/* Bit positions are the same for both USARTs */
+#define MSPIM_ISR_ENABLE(n) (MSPIM_UCSRB(n) |= (1 << RXCIE0))
+#define MSPIM_ISR_DISABLE(n) (MSPIM_UCSRB(n) &= ~(1 << RXCIE0))
+#define MSPIM_CS_ASSERT(dev) (*(dev)->port &= ~(dev)->mask)   /* Pull down := active */
+#define MSPIM_CS_RELEASE(dev) (*(dev)->port |= (dev)->mask)   /* Pull up := inactive */
+
+#define MSPIM_UBRR_MAX 4095
+
+#define ALWAYS_INLINE inline __attribute__((always_inline))
+
+/* Resolves a device to its UCSRnC/UBRRn values. XCK = F_CPU / (2 * (UBRRn + 1)). */
+static uint16_t spi_mspim_configure(device_t* _device, data_order_t data_order, spi_mode_t mode, uint32_t frequency){
+    
+    uint32_t ubrr = (F_CPU + 2 * frequency - 1) / (2 * frequency) - 1;
+    
+    if (ubrr > MSPIM_UBRR_MAX) ubrr = MSPIM_UBRR_MAX;
+    
+    /* Master SPI mode, Data Order, SPI Mode. UCPHAn and UCPOLn are swapped compared to SPCR. */
+    _device->ctrl = (1 << UMSEL01) | (1 << UMSEL00) | (data_order << UDORD0) | ((mode & 0x01) << UCPHA0) | ((mode >> 1) << UCPOL0);
+    _device->rate = (uint16_t)ubrr;
+    
+    return 16 * (uint16_t)(ubrr + 1);
+}
+
+static ALWAYS_INLINE void spi_mspim_registers(const uint8_t n, uint8_t ctrl, uint16_t rate){
+    MSPIM_UCSRC(n) = ctrl;
+    MSPIM_UBRRH(n) = (uint8_t)(rate >> 8);
+    MSPIM_UBRRL(n) = (uint8_t)rate;
+}
+
+static ALWAYS_INLINE void spi_mspim_init(spi_bus_t* bus, const uint8_t n, const device_t* defaults){
+    
+    /* The baud rate has to be zero while the transmitter is enabled */
+    MSPIM_UBRRH(n) = 0;
+    MSPIM_UBRRL(n) = 0;
+    
+    /* Set XCK and TXD output, RXD input */
+    if (n == 0) {
+        *SPI_DDR_OF(&SPI_MSPIM0_XCK_PORT) |= (1 << SPI_MSPIM0_XCK);
+        *SPI_DDR_OF(&SPI_MSPIM0_PORT) |= (1 << SPI_MSPIM0_TXD);
+        *SPI_DDR_OF(&SPI_MSPIM0_PORT) &= ~(1 << SPI_MSPIM0_RXD);
+    }
+    else {
+        *SPI_DDR_OF(&SPI_MSPIM1_XCK_PORT) |= (1 << SPI_MSPIM1_XCK);
+        *SPI_DDR_OF(&SPI_MSPIM1_PORT) |= (1 << SPI_MSPIM1_TXD);
+        *SPI_DDR_OF(&SPI_MSPIM1_PORT) &= ~(1 << SPI_MSPIM1_RXD);
+    }
+    
+    MSPIM_UCSRC(n) = defaults->ctrl;
+    
+    /* Enable Receive Complete Interrupt, Receiver, Transmitter */
+    MSPIM_UCSRB(n) = (1 << RXCIE0) | (1 << RXEN0) | (1 << TXEN0);
+    
+    bus->ctrl = defaults->ctrl;
+    bus->rate = defaults->rate;
+    
+    spi_mspim_registers(n, bus->ctrl, bus->rate);
+}
+
+static ALWAYS_INLINE uint8_t spi_mspim_pin_used(const uint8_t n, volatile uint8_t* port, uint8_t pin){
+    
+    if (n == 0) {
+        return (port == &SPI_MSPIM0_XCK_PORT && pin == SPI_MSPIM0_XCK) ||
+               (port == &SPI_MSPIM0_PORT && (pin == SPI_MSPIM0_TXD || pin == SPI_MSPIM0_RXD));
+    }
+    
+    return (port == &SPI_MSPIM1_XCK_PORT && pin == SPI_MSPIM1_XCK) ||
+           (port == &SPI_MSPIM1_PORT && (pin == SPI_MSPIM1_TXD || pin == SPI_MSPIM1_RXD));
+}
+
+static ALWAYS_INLINE void spi_mspim_enable(spi_bus_t* bus, const uint8_t n, device_t* _device){
+    
+    if (!spi_bus_select(bus, _device)) return;
+    
+    /* The transmitter is idle between transactions, so the registers can change */
+    if (_device->ctrl != bus->ctrl || _device->rate != bus->rate) {
+        bus->ctrl = _device->ctrl;
+        bus->rate = _device->rate;
+        spi_mspim_registers(n, bus->ctrl, bus->rate);
+    }
+}
+
+/* Writes the next byte of the send cursor into the transmit buffer */
+static ALWAYS_INLINE void spi_mspim_send(spi_bus_t* bus, const uint8_t n){
+    
+    bus->tx.remaining--;
+    
+    MSPIM_UDR(n) = (bus->tx.tx != NULL) ? *bus->tx.tx++ : bus->fill;
+}
+
+/* Returns 1 if the send cursor has another byte */
+static ALWAYS_INLINE uint8_t spi_mspim_pending(spi_bus_t* bus){
+    return bus->tx.remaining != 0 || spi_cursor_next(&bus->tx);
+}
+
+static ALWAYS_INLINE uint8_t spi_mspim_start(spi_bus_t* bus, const uint8_t n){
+    
+    if (!spi_bus_dequeue(bus)) return 0;
+    
+    spi_mspim_enable(bus, n, bus->transaction->device);
+    
+    MSPIM_CS_ASSERT(bus->device);
+    
+    /* Both cursors start at the first byte */
+    bus->rx = bus->tx;
+    
+    spi_mspim_send(bus, n);
+    
+    /* The second byte waits in the transmit buffer and follows without a gap */
+    if (spi_mspim_pending(bus)) spi_mspim_send(bus, n);
+    
+    spi_trace(SPI_TRACE_CS_ASSERT, bus->device, 0);
+    
+    return 1;
+}
+
+static ALWAYS_INLINE void spi_mspim_poll(spi_bus_t* bus, const uint8_t n, spi_transaction_t* _transaction){
+    
+    spi_mspim_enable(bus, n, _transaction->device);
+    
+    MSPIM_ISR_DISABLE(n);
+    
+    MSPIM_CS_ASSERT(bus->device);
+    
+    spi_trace(SPI_TRACE_CS_ASSERT, _transaction->device, 1);
+    
+    spi_cursor_load(&bus->tx, _transaction);
+    
+    if (spi_cursor_next(&bus->tx)) {
+        
+        uint8_t sending = 1;
+        
+        bus->rx = bus->tx;
+        
+        for (;;) {
+            
+            uint8_t status = MSPIM_UCSRA(n);
+            
+            /* Keep the transmit buffer filled */
+            if (sending && (status & (1 << UDRE0))) {
+                spi_mspim_send(bus, n);
+                sending = spi_mspim_pending(bus);
+            }
+            
+            if (status & (1 << RXC0)) {
+                
+                uint8_t data = MSPIM_UDR(n);
+                
+                if (bus->rx.rx != NULL) *bus->rx.rx++ = data;
+                
+                if (--bus->rx.remaining == 0 && !spi_cursor_next(&bus->rx)) break;
+            }
+        }
+    }
+    
+    MSPIM_CS_RELEASE(bus->device);
+    
+    spi_trace(SPI_TRACE_CS_RELEASE, _transaction->device, 0);
+    
+    MSPIM_ISR_ENABLE(n);
+    
+    spi_transaction_done(_transaction, SPI_NO_ERROR);
+}
+
+static ALWAYS_INLINE void spi_mspim_isr(spi_bus_t* bus, const uint8_t n){
+    
+    uint8_t data = MSPIM_UDR(n);
+    
+    if (bus->rx.rx != NULL) *bus->rx.rx++ = data;
+    
+    if (--bus->rx.remaining == 0) {
+        
+        const spi_segment_t* segment = bus->rx.segment;
+        
+        if (!spi_cursor_next(&bus->rx)) {
+            
+            // Transaction finished
+            
+            MSPIM_CS_RELEASE(bus->device);
+            
+            spi_stats_done(bus);
+            
+            spi_trace(SPI_TRACE_CS_RELEASE, bus->device, 0);
+            
+            spi_transaction_done(bus->transaction, SPI_NO_ERROR);
+            
+            // Load next transaction
+            
+            if (!spi_mspim_start(bus, n)) bus->state = SPI_INACTIVE;
+            
+            return;
+        }
+        
+        spi_trace_segment(bus, &bus->rx, segment);
+    }
+    
+    /* One byte received, one more fits into the transmit buffer */
+    if (spi_mspim_pending(bus)) spi_mspim_send(bus, n);
+}
+
+#if SPI_MSPIM_USART0
+
+static void spi_mspim0_init(spi_bus_t* bus, const device_t* defaults){ spi_mspim_init(bus, 0, defaults); }
+static uint8_t spi_mspim0_pin_used(volatile uint8_t* port, uint8_t pin){ return spi_mspim_pin_used(0, port, pin); }
+static uint8_t spi_mspim0_start(spi_bus_t* bus){ return spi_mspim_start(bus, 0); }
+static void spi_mspim0_poll(spi_bus_t* bus, spi_transaction_t* _transaction){ spi_mspim_poll(bus, 0, _transaction); }
+
+static const spi_bus_ops_t spi_mspim0_ops = {
+    .init = spi_mspim0_init,
+    .pin_used = spi_mspim0_pin_used,
+    .configure = spi_mspim_configure,
+    .start = spi_mspim0_start,
+    .poll = spi_mspim0_poll
+};
+
+static spi_bus_t mspim0 = { .ops = &spi_mspim0_ops };
+
+ISR(USART0_RX_vect){
+    spi_mspim_isr(&mspim0, 0);
+}
+
+#endif /* SPI_MSPIM_USART0 */
+
+#if SPI_MSPIM_USART1
+
+static void spi_mspim1_init(spi_bus_t* bus, const device_t* defaults){ spi_mspim_init(bus, 1, defaults); }
+static uint8_t spi_mspim1_pin_used(volatile uint8_t* port, uint8_t pin){ return spi_mspim_pin_used(1, port, pin); }
+static uint8_t spi_mspim1_start(spi_bus_t* bus){ return spi_mspim_start(bus, 1); }
+static void spi_mspim1_poll(spi_bus_t* bus, spi_transaction_t* _transaction){ spi_mspim_poll(bus, 1, _transaction); }
+
+static const spi_bus_ops_t spi_mspim1_ops = {
+    .init = spi_mspim1_init,
+    .pin_used = spi_mspim1_pin_used,
+    .configure = spi_mspim_configure,
+    .start = spi_mspim1_start,
+    .poll = spi_mspim1_poll
+};
+
+static spi_bus_t mspim1 = { .ops = &spi_mspim1_ops };
+
+ISR(USART1_RX_vect){
+    spi_mspim_isr(&mspim1, 1);
+}
+
+#endif /* SPI_MSPIM_USART1 */
+
+spi_bus_t* spi_mspim_bus(spi_bus_id_t id){
+    
+    switch (id) {
+#if SPI_MSPIM_USART0
+        case SPI_BUS_USART0: return &mspim0;
+#endif
+#if SPI_MSPIM_USART1
+        case SPI_BUS_USART1: return &mspim1;
+#endif
+        default: return NULL;
+    }
+}
+
+#endif /* SPI_MSPIM_USART0 || SPI_MSPIM_USART1 */
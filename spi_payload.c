@@ -0,0 +1,110 @@
+/*************************************************************************
+* Title     : SPI Payload Pool
+* Author    : Dimitri Dening
+* Created   : 17.10.2026 11:02:15
+* Software  : Microchip Studio V7
+* Hardware  : Atmega1284P
+
+DESCRIPTION:
+    Static payload slab with O(1) acquire and release.
+USAGE:
+    see <spi_payload.h>
+NOTES:
+    The free list is a stack of slot indices. Releasing a payload that is
+    not part of the pool or already free is ignored.
+*************************************************************************/
+
+/* General libraries */
+#include <util/atomic.h>
+
+/* User defined libraries */
+#include "spi.h"
+
+static payload_t pool[SPI_PAYLOAD_POOL_SIZE];
+
+static uint8_t free_list[SPI_PAYLOAD_POOL_SIZE];
+
+static uint8_t in_use[SPI_PAYLOAD_POOL_SIZE];
+
+static uint8_t free_top;
+
+static uint8_t high_watermark;
+
+static uint16_t exhausted;
+
+void spi_payload_pool_init(void){
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+
+        for (uint8_t i = 0; i < SPI_PAYLOAD_POOL_SIZE; i++) {
+            free_list[i] = SPI_PAYLOAD_POOL_SIZE - 1 - i;
+            in_use[i] = 0;
+        }
+
+        free_top = SPI_PAYLOAD_POOL_SIZE;
+        high_watermark = 0;
+        exhausted = 0;
+    }
+}
+
+payload_t* payload_create_spi(priority_t priority, device_t* device, uint8_t* data, spi_length_t number_of_bytes, callback_fn callback){
+
+    payload_t* payload = NULL;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+
+        if (free_top == 0) {
+            exhausted++;
+        }
+        else {
+            uint8_t slot = free_list[--free_top];
+
+            in_use[slot] = 1;
+            payload = &pool[slot];
+
+            if (SPI_PAYLOAD_POOL_SIZE - free_top > high_watermark) {
+                high_watermark = SPI_PAYLOAD_POOL_SIZE - free_top;
+            }
+        }
+    }
+
+    if (payload == NULL) return NULL;
+
+    payload->transaction.device = device;
+    payload->transaction.segments = payload->segments;
+    payload->transaction.nr_segments = 1;
+    payload->transaction.priority = priority;
+    payload->transaction.callback = callback;
+    payload->transaction.ctx = NULL;
+    payload->transaction.handle = SPI_HANDLE_NONE;
+    
+    payload->segments[0].tx = data;
+    payload->segments[0].rx = NULL;
+    payload->segments[0].length = number_of_bytes;
+
+    return payload;
+}
+
+void payload_free_spi(payload_t* payload){
+
+    if (payload < &pool[0] || payload > &pool[SPI_PAYLOAD_POOL_SIZE - 1]) return;
+
+    uint8_t slot = (uint8_t)(payload - pool);
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        if (in_use[slot]) {
+            in_use[slot] = 0;
+            free_list[free_top++] = slot;
+        }
+    }
+}
+
+void spi_payload_pool_stats(spi_pool_stats_t* stats){
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        stats->capacity = SPI_PAYLOAD_POOL_SIZE;
+        stats->in_use = SPI_PAYLOAD_POOL_SIZE - free_top;
+        stats->high_watermark = high_watermark;
+        stats->exhausted = exhausted;
+    }
+}
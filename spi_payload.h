@@ -0,0 +1,82 @@
+/*************************************************************************
+* Title		: SPI Payload Pool
+* Author	: Dimitri Dening
+* Created	: 17.10.2026 11:02:15
+* Software	: Microchip Studio V7
+* Hardware	: Atmega1284P
+* License	: MIT License
+* Usage		: see Doxygen manual
+*
+*       Copyright (C) 2021 Dimitri Dening
+*
+*       Permission is hereby granted, free of charge, to any person obtaining a copy
+*       of this software and associated documentation files (the "Software"), to deal
+*       in the Software without restriction, including without limitation the rights
+*       to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*       copies of the Software, and to permit persons to whom the Software is
+*       furnished to do so, subject to the following conditions:
+*
+*       The above copyright notice and this permission notice shall be included in all
+*       copies or substantial portions of the Software.
+*
+*       THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*       IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*       FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*       AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*       LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*       OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*       SOFTWARE.
+*
+* NOTES:
+*	This file should only be included from <spi.h>, never directly.
+*************************************************************************/
+
+/**
+@file spi_payload.h
+@author Dimitri Dening
+@date 17.10.2026
+@copyright (C) 2021 Dimitri Dening, MIT License
+@brief Fixed-capacity payload slab shared by the main loop and ISR(SPI_STC_vect).
+
+Payloads are taken from a static array of SPI_PAYLOAD_POOL_SIZE entries instead of the heap.
+Acquire and release pop and push an index stack inside a short ATOMIC_BLOCK, so both are O(1)
+and may be called from the main loop as well as from interrupt context.
+A payload handed to spi_write(), spi_read() or spi_read_write() is owned by the driver and
+returned to the pool once it has been transmitted or rejected.
+Each payload carries its own transaction with room for two segments (see <spi_transaction.h>).
+A payload created without a data buffer clocks out the fill byte of its device.
+
+@note This file should only be included from <spi.h>, never directly.
+@bug No known bugs.
+*/
+#ifndef SPI_PAYLOAD_H_
+#define SPI_PAYLOAD_H_
+
+#include <stdint.h>
+
+/* 
+ * A pooled transfer. The transaction has to be the first member, the driver
+ * returns a completed transaction to the pool by its address.
+ */
+typedef struct payload_t {
+    spi_transaction_t transaction;
+    spi_segment_t segments[2];
+} payload_t;
+
+/* Snapshot of the pool usage */
+typedef struct spi_pool_stats_t {
+    uint8_t capacity;
+    uint8_t in_use;
+    uint8_t high_watermark;     // Most payloads in use at the same time
+    uint16_t exhausted;         // Failed acquires because the pool was empty
+} spi_pool_stats_t;
+
+void spi_payload_pool_init(void);
+
+payload_t* payload_create_spi(priority_t priority, struct device_t* device, uint8_t* data, spi_length_t number_of_bytes, callback_fn callback);
+
+void payload_free_spi(payload_t*);
+
+void spi_payload_pool_stats(spi_pool_stats_t*);
+
+#endif /* SPI_PAYLOAD_H_ */
@@ -0,0 +1,149 @@
+/*************************************************************************
+* Title     : SPI Transaction Queue
+* Author    : Dimitri Dening
+* Created   : 17.10.2026 11:20:41
+* Software  : Microchip Studio V7
+* Hardware  : Atmega1284P
+
+DESCRIPTION:
+    Multi-level priority queue of pending transactions, one lock-free
+    single-producer/single-consumer ring per level.
+USAGE:
+    see <spi_queue.h>
+NOTES:
+    The producer only writes the head and the consumer only the tail of
+    a level, so neither side disables interrupts. The entry is stored
+    before the head is published. Indices run freely over 0..255, which
+    is why SPI_QUEUE_SIZE has to be a power of two of at most 128.
+*************************************************************************/
+
+/* General libraries */
+#include <stddef.h>
+
+/* User defined libraries */
+#include "spi.h"
+
+#if SPI_QUEUE_SIZE == 0 || SPI_QUEUE_SIZE > 128 || (SPI_QUEUE_SIZE & (SPI_QUEUE_SIZE - 1)) != 0
+# error "SPI_QUEUE_SIZE has to be a power of two between 1 and 128"
+#endif
+
+#define SPI_QUEUE_MASK (SPI_QUEUE_SIZE - 1)
+
+/* Keeps the compiler from moving memory accesses across, the AVR core itself doesn't reorder */
+#define SPI_QUEUE_BARRIER() __asm__ __volatile__ ("" ::: "memory")
+
+/* Highest set bit of a non-empty bitmap of levels, for any SPI_QUEUE_LEVELS */
+static inline uint8_t spi_queue_highest(uint8_t ready){
+
+    uint8_t level = SPI_QUEUE_LEVELS - 1;
+
+    while (!(ready & (1 << level))) level--;
+
+    return level;
+}
+
+/* Level of a transaction, unknown priorities are treated as PRIORITY_HIGH */
+static uint8_t spi_queue_priority(const spi_transaction_t* transaction){
+    return (transaction->priority < SPI_QUEUE_LEVELS) ? transaction->priority : PRIORITY_HIGH;
+}
+
+/* Bitmap of the non-empty levels, rebuilt from the indices on every call, each head is read once */
+static uint8_t spi_queue_ready(const spi_queue_t* queue){
+
+    uint8_t ready = 0;
+
+    for (uint8_t i = 0; i < SPI_QUEUE_LEVELS; i++) {
+        if (queue->levels[i].head != queue->levels[i].tail) ready |= (1 << i);
+    }
+
+    return ready;
+}
+
+spi_queue_t* spi_queue_init(spi_queue_t* queue){
+
+    for (uint8_t i = 0; i < SPI_QUEUE_LEVELS; i++) {
+        queue->levels[i].head = 0;
+        queue->levels[i].tail = 0;
+        queue->levels[i].age = 0;
+    }
+
+    return queue;
+}
+
+uint8_t spi_queue_space(const spi_queue_t* queue, const spi_transaction_t* transaction){
+
+    const spi_queue_level_t* level = &queue->levels[spi_queue_priority(transaction)];
+
+    /* The consumer may only free entries meanwhile, so the space never shrinks behind the producer's back */
+    return SPI_QUEUE_SIZE - (uint8_t)(level->head - level->tail);
+}
+
+void spi_queue_push(spi_queue_t* queue, spi_transaction_t* transaction){
+
+    spi_queue_level_t* level = &queue->levels[spi_queue_priority(transaction)];
+    uint8_t head = level->head;
+
+    level->buffer[head & SPI_QUEUE_MASK] = transaction;
+
+    /* Publishes the entry, the consumer sees it from here on */
+    SPI_QUEUE_BARRIER();
+    level->head = head + 1;
+}
+
+spi_error_t spi_queue_enqueue(spi_queue_t* queue, spi_transaction_t* transaction){
+
+    if (spi_queue_space(queue, transaction) == 0) return SPI_ERR_BUFFER_OVERFLOW;
+
+    spi_queue_push(queue, transaction);
+
+    return SPI_NO_ERROR;
+}
+
+spi_transaction_t* spi_queue_dequeue(spi_queue_t* queue){
+
+    uint8_t ready = spi_queue_ready(queue);
+
+    if (ready == 0) return NULL;
+
+    uint8_t priority = spi_queue_highest(ready);
+
+#if SPI_QUEUE_AGING
+    /* Age every waiting lower level, the highest one that ran out of patience is served instead */
+    uint8_t served = priority;
+
+    for (uint8_t i = 0; i < priority; i++) {
+        if ((ready & (1 << i)) && ++queue->levels[i].age > SPI_QUEUE_AGING) {
+            served = i;
+        }
+    }
+
+    priority = served;
+#endif
+
+    spi_queue_level_t* level = &queue->levels[priority];
+    uint8_t tail = level->tail;
+    spi_transaction_t* transaction = level->buffer[tail & SPI_QUEUE_MASK];
+
+    level->age = 0;
+
+    /* Frees the entry only after it was read */
+    SPI_QUEUE_BARRIER();
+    level->tail = tail + 1;
+
+    return transaction;
+}
+
+uint8_t spi_queue_empty(spi_queue_t* queue){
+    return spi_queue_ready(queue) == 0;
+}
+
+uint16_t spi_queue_depth(const spi_queue_t* queue){
+
+    uint16_t depth = 0;
+
+    for (uint8_t i = 0; i < SPI_QUEUE_LEVELS; i++) {
+        depth += (uint8_t)(queue->levels[i].head - queue->levels[i].tail);
+    }
+
+    return depth;
+}
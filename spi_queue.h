@@ -0,0 +1,95 @@
+/*************************************************************************
+* Title		: SPI Transaction Queue
+* Author	: Dimitri Dening
+* Created	: 17.10.2026 11:20:41
+* Software	: Microchip Studio V7
+* Hardware	: Atmega1284P
+* License	: MIT License
+* Usage		: see Doxygen manual
+*
+*       Copyright (C) 2021 Dimitri Dening
+*
+*       Permission is hereby granted, free of charge, to any person obtaining a copy
+*       of this software and associated documentation files (the "Software"), to deal
+*       in the Software without restriction, including without limitation the rights
+*       to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*       copies of the Software, and to permit persons to whom the Software is
+*       furnished to do so, subject to the following conditions:
+*
+*       The above copyright notice and this permission notice shall be included in all
+*       copies or substantial portions of the Software.
+*
+*       THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*       IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*       FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*       AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*       LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*       OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*       SOFTWARE.
+*
+* NOTES:
+*	This file should only be included from <spi.h>, never directly.
+*************************************************************************/
+
+/**
+@file spi_queue.h
+@author Dimitri Dening
+@date 17.10.2026
+@copyright (C) 2021 Dimitri Dening, MIT License
+@brief Multi-level priority queue of pending transactions.
+
+Every priority_t level is a FIFO of up to SPI_QUEUE_SIZE transaction pointers in a static ringbuffer.
+Enqueue writes one entry of its level. Dequeue compares head and tail of every level to find
+the highest waiting one, so it takes SPI_QUEUE_LEVELS steps however many transactions are queued.
+Transactions of the same priority keep their order.
+There is no shared bitmap of the non-empty levels: both sides would have to update it, which takes
+a critical section on every push and pop.
+
+Each level is a single-producer/single-consumer ring with its own head and tail index, so neither
+side disables interrupts. The producer is the main loop. The consumer is the main loop while the bus
+is inactive and its interrupt while the bus is active, the state of the bus hands it over.
+SPI_QUEUE_SIZE has to be a power of two of at most 128.
+The queue only stores pointers, the transactions live in the pool of <spi_payload.h> or with the caller.
+
+A lower level that is passed over SPI_QUEUE_AGING times in a row is served next, so bulk traffic
+on PRIORITY_LOW is delayed by at most SPI_QUEUE_AGING higher priority transactions.
+
+@note This file should only be included from <spi.h>, never directly.
+@bug No known bugs.
+*/
+#ifndef SPI_QUEUE_H_
+#define SPI_QUEUE_H_
+
+#include <stdint.h>
+
+#define SPI_QUEUE_LEVELS (PRIORITY_HIGH + 1)
+
+typedef struct spi_queue_level_t {
+    spi_transaction_t* buffer[SPI_QUEUE_SIZE];
+    volatile uint8_t head;  // Next entry to write, only advanced by the producer
+    volatile uint8_t tail;  // Next entry to read, only advanced by the consumer
+    uint8_t age;            // Dequeues that passed over this level since it was last served, consumer only
+} spi_queue_level_t;
+
+typedef struct spi_queue_t {
+    spi_queue_level_t levels[SPI_QUEUE_LEVELS];
+} spi_queue_t;
+
+spi_queue_t* spi_queue_init(spi_queue_t*);
+
+spi_error_t spi_queue_enqueue(spi_queue_t*, spi_transaction_t*);
+
+/* Free entries of the level a transaction goes to, producer only */
+uint8_t spi_queue_space(const spi_queue_t*, const spi_transaction_t*);
+
+/* Enqueues a transaction whose level has space, producer only */
+void spi_queue_push(spi_queue_t*, spi_transaction_t*);
+
+spi_transaction_t* spi_queue_dequeue(spi_queue_t*);
+
+uint8_t spi_queue_empty(spi_queue_t*);
+
+/* Transactions queued on all levels */
+uint16_t spi_queue_depth(const spi_queue_t*);
+
+#endif /* SPI_QUEUE_H_ */
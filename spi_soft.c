@@ -0,0 +1,332 @@
+/*************************************************************************
+* Title     : Bit-banged SPI Master
+* Author    : Dimitri Dening
+* Created   : 17.10.2026 22:41:09
+* Software  : Microchip Studio V7
+* Hardware  : Atmega1284P
+
+DESCRIPTION:
+    Runs a software SPI master on any three GPIO pins as an additional bus
+    with its own queue, for peripherals that are not wired to the SPI pins.
+USAGE:
+    Set SPI_SOFT to 1 and the SPI_SOFT_* pins in <spi_config.h>, call
+    spi_bus_init(SPI_BUS_SOFT, &config) and create devices with
+    spi_device_config_t.bus = SPI_BUS_SOFT. Everything else is <spi.h>.
+NOTES:
+    There is no interrupt behind the bus, the CPU clocks every transaction
+    out when it is submitted. Queued transactions are sent right away as
+    well, the queue only keeps the order of a batch. Streams stay on the
+    native SPI.
+    The pins are constants, so every edge is a single sbi/cbi and MISO is
+    read with sbic. The byte loop is unrolled and specialised for each SPI
+    mode and bit order, the mode of a device is switched on once per
+    transaction and never per bit.
+    A device runs at full speed if its max_frequency is at least what the
+    unrolled loop reaches, about F_CPU / 11. Below that every SCK half
+    period is stretched by a delay loop, so SCK never exceeds max_frequency.
+*************************************************************************/
+
+/* General libraries */
+#include <avr/interrupt.h>
+#include <util/delay_basic.h>
+
+/* User defined libraries */
+#include "spi.h"
+#include "spi_bus.h"
+
+#if SPI_SOFT
+
+#define SOFT_SCK_HIGH() (SPI_SOFT_SCK_PORT |= (1 << SPI_SOFT_SCK))
+#define SOFT_SCK_LOW() (SPI_SOFT_SCK_PORT &= ~(1 << SPI_SOFT_SCK))
+#define SOFT_MOSI_HIGH() (SPI_SOFT_MOSI_PORT |= (1 << SPI_SOFT_MOSI))
+#define SOFT_MOSI_LOW() (SPI_SOFT_MOSI_PORT &= ~(1 << SPI_SOFT_MOSI))
+#define SOFT_MISO() (SPI_SOFT_MISO_PIN & (1 << SPI_SOFT_MISO))
+#define SOFT_CS_ASSERT(dev) (*(dev)->port &= ~(dev)->mask)   /* Pull down := active */
+#define SOFT_CS_RELEASE(dev) (*(dev)->port |= (dev)->mask)   /* Pull up := inactive */
+
+/* Register value of a device: the SPI mode in bits 1:0, the bit order in bit 2 */
+#define SOFT_CTRL(data_order, mode) ((mode) | ((data_order) << 2))
+#define SOFT_CPOL(ctrl) (((ctrl) >> 1) & 0x01)
+#define SOFT_CPHA(ctrl) ((ctrl) & 0x01)
+#define SOFT_LSB(ctrl) ((ctrl) & 0x04)
+
+/* A bit of the unrolled loop: sbrs/sbrc, sbi or cbi for MOSI, two SCK edges, sbic and ori for MISO */
+#define SOFT_BIT_CYCLES 11
+/* Load, store and loop of a byte */
+#define SOFT_BYTE_CYCLES 8
+/* A bit of the stretched loop without its two delays */
+#define SOFT_SLOW_BIT_CYCLES 20
+/* An iteration of _delay_loop_1() */
+#define SOFT_DELAY_CYCLES 3
+/* Port accesses of a bit, charged by the register model of the host simulation */
+#define SOFT_BIT_ACCESSES 4
+
+#define ALWAYS_INLINE inline __attribute__((always_inline))
+
+/*
+ * Resolves a device to its mode, bit order and SCK delay. A delay of 0 selects the unrolled loop,
+ * otherwise each half period is stretched by that many delay loop iterations.
+ */
+static uint16_t spi_soft_configure(device_t* _device, data_order_t data_order, spi_mode_t mode, uint32_t frequency){
+    
+    uint32_t period = (frequency == 0) ? UINT32_MAX : (F_CPU + frequency - 1) / frequency;
+    uint32_t delay = 0;
+    
+    if (period > SOFT_BIT_CYCLES) {
+        delay = (period > SOFT_SLOW_BIT_CYCLES) ? (period - SOFT_SLOW_BIT_CYCLES + 2 * SOFT_DELAY_CYCLES - 1) / (2 * SOFT_DELAY_CYCLES) : 1;
+        if (delay > UINT8_MAX) delay = UINT8_MAX;
+    }
+    
+    _device->ctrl = SOFT_CTRL(data_order, mode);
+    _device->rate = (uint16_t)delay;
+    
+    if (delay == 0) return 8 * SOFT_BIT_CYCLES + SOFT_BYTE_CYCLES;
+    
+    return 8 * (SOFT_SLOW_BIT_CYCLES + 2 * SOFT_DELAY_CYCLES * (uint16_t)delay) + SOFT_BYTE_CYCLES;
+}
+
+/* Sets SCK to its idle level */
+static void spi_soft_idle(uint8_t ctrl){
+    
+    if (SOFT_CPOL(ctrl)) SOFT_SCK_HIGH();
+    else SOFT_SCK_LOW();
+}
+
+static void spi_soft_init(spi_bus_t* bus, const device_t* defaults){
+    
+    /* Set SCK and MOSI output, MISO input */
+    *SPI_DDR_OF(&SPI_SOFT_SCK_PORT) |= (1 << SPI_SOFT_SCK);
+    *SPI_DDR_OF(&SPI_SOFT_MOSI_PORT) |= (1 << SPI_SOFT_MOSI);
+    *SPI_DDR_OF(&SPI_SOFT_MISO_PORT) &= ~(1 << SPI_SOFT_MISO);
+    
+    bus->ctrl = defaults->ctrl;
+    bus->rate = defaults->rate;
+    
+    spi_soft_idle(bus->ctrl);
+}
+
+static uint8_t spi_soft_pin_used(volatile uint8_t* port, uint8_t pin){
+    return (port == &SPI_SOFT_SCK_PORT && pin == SPI_SOFT_SCK) ||
+           (port == &SPI_SOFT_MOSI_PORT && pin == SPI_SOFT_MOSI) ||
+           (port == &SPI_SOFT_MISO_PORT && pin == SPI_SOFT_MISO);
+}
+
+static void spi_soft_enable(spi_bus_t* bus, device_t* _device){
+    
+    if (!spi_bus_select(bus, _device)) return;
+    
+    bus->ctrl = _device->ctrl;
+    bus->rate = _device->rate;
+    
+    /* SCK has to idle at the polarity of the device before its chip select is asserted */
+    spi_soft_idle(bus->ctrl);
+}
+
+static ALWAYS_INLINE void spi_soft_sck(const uint8_t high){
+    
+    if (high) SOFT_SCK_HIGH();
+    else SOFT_SCK_LOW();
+}
+
+/* One bit of the unrolled loop. CPHA = 0 samples on the leading edge, CPHA = 1 shifts on it. */
+static ALWAYS_INLINE uint8_t spi_soft_bit(uint8_t out, uint8_t in, const uint8_t mask, const uint8_t ctrl){
+    
+    if (SOFT_CPHA(ctrl)) spi_soft_sck(!SOFT_CPOL(ctrl));
+    
+    if (out & mask) SOFT_MOSI_HIGH();
+    else SOFT_MOSI_LOW();
+    
+    spi_soft_sck(SOFT_CPHA(ctrl) ? SOFT_CPOL(ctrl) : !SOFT_CPOL(ctrl));
+    
+    if (SOFT_MISO()) in |= mask;
+    
+    if (!SOFT_CPHA(ctrl)) spi_soft_sck(SOFT_CPOL(ctrl));
+    
+    SPI_CYCLES(SOFT_BIT_CYCLES - 2 * SOFT_BIT_ACCESSES);
+    
+    return in;
+}
+
+static ALWAYS_INLINE uint8_t spi_soft_byte(uint8_t out, const uint8_t ctrl){
+    
+    uint8_t in = 0;
+    
+    if (SOFT_LSB(ctrl)) {
+        in = spi_soft_bit(out, in, 0x01, ctrl);
+        in = spi_soft_bit(out, in, 0x02, ctrl);
+        in = spi_soft_bit(out, in, 0x04, ctrl);
+        in = spi_soft_bit(out, in, 0x08, ctrl);
+        in = spi_soft_bit(out, in, 0x10, ctrl);
+        in = spi_soft_bit(out, in, 0x20, ctrl);
+        in = spi_soft_bit(out, in, 0x40, ctrl);
+        in = spi_soft_bit(out, in, 0x80, ctrl);
+    }
+    else {
+        in = spi_soft_bit(out, in, 0x80, ctrl);
+        in = spi_soft_bit(out, in, 0x40, ctrl);
+        in = spi_soft_bit(out, in, 0x20, ctrl);
+        in = spi_soft_bit(out, in, 0x10, ctrl);
+        in = spi_soft_bit(out, in, 0x08, ctrl);
+        in = spi_soft_bit(out, in, 0x04, ctrl);
+        in = spi_soft_bit(out, in, 0x02, ctrl);
+        in = spi_soft_bit(out, in, 0x01, ctrl);
+    }
+    
+    return in;
+}
+
+/* Clocks the rest of the transaction from the loaded chunk of the cursor on */
+static ALWAYS_INLINE void spi_soft_shift(spi_bus_t* bus, const uint8_t ctrl){
+    
+    spi_cursor_t* cursor = &bus->tx;
+    
+    do {
+        
+        const uint8_t* tx = cursor->tx;
+        uint8_t* rx = cursor->rx;
+        uint8_t remaining = cursor->remaining;
+        
+        while (remaining--) {
+            
+            uint8_t data = spi_soft_byte((tx != NULL) ? *tx++ : bus->fill, ctrl);
+            
+            if (rx != NULL) *rx++ = data;
+            
+            SPI_CYCLES(SOFT_BYTE_CYCLES);
+        }
+        
+        cursor->tx = tx;
+        cursor->rx = rx;
+        cursor->remaining = 0;
+        
+    } while (spi_cursor_next(cursor));
+}
+
+/* The stretched loop, with the mode and bit order read at runtime since the delays dominate */
+static void spi_soft_shift_slow(spi_bus_t* bus){
+    
+    spi_cursor_t* cursor = &bus->tx;
+    const uint8_t ctrl = bus->ctrl;
+    const uint8_t delay = (uint8_t)bus->rate;
+    const uint8_t first = SOFT_LSB(ctrl) ? 0x01 : 0x80;
+    
+    do {
+        
+        while (cursor->remaining != 0) {
+            
+            uint8_t out = (cursor->tx != NULL) ? *cursor->tx++ : bus->fill;
+            uint8_t in = 0;
+            
+            for (uint8_t mask = first; mask != 0; mask = SOFT_LSB(ctrl) ? (uint8_t)(mask << 1) : (uint8_t)(mask >> 1)) {
+                
+                if (SOFT_CPHA(ctrl)) spi_soft_sck(!SOFT_CPOL(ctrl));
+                
+                if (out & mask) SOFT_MOSI_HIGH();
+                else SOFT_MOSI_LOW();
+                
+                _delay_loop_1(delay);
+                
+                spi_soft_sck(SOFT_CPHA(ctrl) ? SOFT_CPOL(ctrl) : !SOFT_CPOL(ctrl));
+                
+                if (SOFT_MISO()) in |= mask;
+                
+                _delay_loop_1(delay);
+                
+                if (!SOFT_CPHA(ctrl)) spi_soft_sck(SOFT_CPOL(ctrl));
+                
+                SPI_CYCLES(SOFT_SLOW_BIT_CYCLES - 2 * SOFT_BIT_ACCESSES);
+            }
+            
+            if (cursor->rx != NULL) *cursor->rx++ = in;
+            
+            cursor->remaining--;
+        }
+        
+    } while (spi_cursor_next(cursor));
+}
+
+#define SOFT_SHIFT_CASE(data_order, mode) \
+    case SOFT_CTRL(data_order, mode): spi_soft_shift(bus, SOFT_CTRL(data_order, mode)); break;
+
+/* Clocks a transaction whose first chunk is loaded, picking the loop of the programmed device */
+static void spi_soft_run(spi_bus_t* bus){
+    
+    if (bus->rate != 0) {
+        spi_soft_shift_slow(bus);
+        return;
+    }
+    
+    switch (bus->ctrl) {
+        SOFT_SHIFT_CASE(SPI_MSB, SPI_MODE0)
+        SOFT_SHIFT_CASE(SPI_MSB, SPI_MODE1)
+        SOFT_SHIFT_CASE(SPI_MSB, SPI_MODE2)
+        SOFT_SHIFT_CASE(SPI_MSB, SPI_MODE3)
+        SOFT_SHIFT_CASE(SPI_LSB, SPI_MODE0)
+        SOFT_SHIFT_CASE(SPI_LSB, SPI_MODE1)
+        SOFT_SHIFT_CASE(SPI_LSB, SPI_MODE2)
+        SOFT_SHIFT_CASE(SPI_LSB, SPI_MODE3)
+        default: break;
+    }
+}
+
+/* There is no interrupt to hand the queue over to, so it is sent here until it is empty */
+static uint8_t spi_soft_start(spi_bus_t* bus){
+    
+    while (spi_bus_dequeue(bus)) {
+        
+        spi_transaction_t* _transaction = bus->transaction;
+        
+        spi_soft_enable(bus, _transaction->device);
+        
+        SOFT_CS_ASSERT(bus->device);
+        
+        spi_trace(SPI_TRACE_CS_ASSERT, bus->device, 0);
+        
+        spi_soft_run(bus);
+        
+        SOFT_CS_RELEASE(bus->device);
+        
+        spi_stats_done(bus);
+        
+        spi_trace(SPI_TRACE_CS_RELEASE, bus->device, 0);
+        
+        spi_transaction_done(_transaction, SPI_NO_ERROR);
+    }
+    
+    return 0;
+}
+
+static void spi_soft_poll(spi_bus_t* bus, spi_transaction_t* _transaction){
+    
+    spi_soft_enable(bus, _transaction->device);
+    
+    SOFT_CS_ASSERT(bus->device);
+    
+    spi_trace(SPI_TRACE_CS_ASSERT, _transaction->device, 1);
+    
+    spi_cursor_load(&bus->tx, _transaction);
+    
+    if (spi_cursor_next(&bus->tx)) spi_soft_run(bus);
+    
+    SOFT_CS_RELEASE(bus->device);
+    
+    spi_trace(SPI_TRACE_CS_RELEASE, _transaction->device, 0);
+    
+    spi_transaction_done(_transaction, SPI_NO_ERROR);
+}
+
+static const spi_bus_ops_t spi_soft_ops = {
+    .init = spi_soft_init,
+    .pin_used = spi_soft_pin_used,
+    .configure = spi_soft_configure,
+    .start = spi_soft_start,
+    .poll = spi_soft_poll
+};
+
+static spi_bus_t soft = { .ops = &spi_soft_ops };
+
+spi_bus_t* spi_soft_bus(void){
+    return &soft;
+}
+
+#endif /* SPI_SOFT */
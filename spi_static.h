@@ -0,0 +1,120 @@
+/*************************************************************************
+* Title		: SPI Static Configuration
+* Author	: Dimitri Dening
+* Created	: 17.10.2026 21:34:51
+* Software	: Microchip Studio V7
+* Hardware	: Atmega1284P
+* License	: MIT License
+* Usage		: see Doxygen manual
+*
+*       Copyright (C) 2021 Dimitri Dening
+*
+*       Permission is hereby granted, free of charge, to any person obtaining a copy
+*       of this software and associated documentation files (the "Software"), to deal
+*       in the Software without restriction, including without limitation the rights
+*       to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*       copies of the Software, and to permit persons to whom the Software is
+*       furnished to do so, subject to the following conditions:
+*
+*       The above copyright notice and this permission notice shall be included in all
+*       copies or substantial portions of the Software.
+*
+*       THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*       IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*       FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*       AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*       LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*       OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*       SOFTWARE.
+*
+* NOTES:
+*	This file should only be included from <spi.h>, never directly.
+*************************************************************************/
+
+
+/**
+@file spi_static.h
+@author Dimitri Dening
+@date 17.10.2026
+@copyright (C) 2021 Dimitri Dening, MIT License
+@brief Devices of the native SPI whose settings are resolved by the compiler.
+
+spi_create_device() derives the SPCR/SPSR values of a device from its settings at runtime and
+keeps it in the device table. For builds whose devices are known up front, SPI_DEVICE() folds
+the register values into constants of a statically allocated device_t and fails to compile if
+the SPI can't divide F_CPU by the given divider, if the chip select pin is SCK, MOSI or MISO or,
+with SPI_FIXED_FILL, if the fill byte is not SPI_FILL_BYTE.
+spi_add_device() then attaches the device to the native bus without touching the device table.
+
+@code
+    static device_t flash = SPI_DEVICE(B, PORTB4, SPI_MSB, SPI_MODE3, 16, 0xFF);
+
+    int main(void){
+
+        spi_init(&spi_config);
+        spi_add_device(&flash);
+        ...
+    }
+@endcode
+
+The default bus settings of spi_config are set at compile time with SPI_DEFAULT_DATA_ORDER,
+SPI_DEFAULT_MODE and SPI_DEFAULT_CLOCK_RATE. Without SPI_MSPIM_USART0, SPI_MSPIM_USART1, SPI_SOFT and SPI_BUFFERED the
+native SPI is the only bus, and the driver calls its start, poll and configure functions directly
+instead of through the bus operations. C++ code gets the same checks from the templates of <spi.hpp>.
+
+@note The port is given once, as a letter to SPI_DEVICE(). spi_free_device() keeps it, so a freed
+      device can be added again.
+@note Only the pins of the native SPI are checked, MSPIM buses use spi_create_device().
+@note This file should only be included from <spi.h>, never directly.
+@bug No known bugs.
+*/
+#ifndef SPI_STATIC_H_
+#define SPI_STATIC_H_
+
+/* An SCK divider the native SPI can't generate */
+#define SPI_CLOCK_INVALID 0xFF
+
+/* clock_rate_t of an SCK divider, SPI_CLOCK_INVALID if the native SPI can't divide by it */
+#define SPI_CLOCK_RATE(divider) \
+    ((divider) == 2 ? SPI_CLOCK_DIV2 : \
+     (divider) == 4 ? SPI_CLOCK_DIV4 : \
+     (divider) == 8 ? SPI_CLOCK_DIV8 : \
+     (divider) == 16 ? SPI_CLOCK_DIV16 : \
+     (divider) == 32 ? SPI_CLOCK_DIV32 : \
+     (divider) == 64 ? SPI_CLOCK_DIV64 : \
+     (divider) == 128 ? SPI_CLOCK_DIV128 : SPI_CLOCK_INVALID)
+
+/* SPCR of a device: interrupt, SPI and master enabled, SPR1:0 are the low bits of clock_rate_t */
+#define SPI_NATIVE_CTRL(data_order, mode, clockrate) \
+    ((1 << SPIE) | (1 << SPE) | ((data_order) << DORD) | (1 << MSTR) | ((mode) << CPHA) | (((clockrate) & 0x03) << SPR0))
+
+/* SPSR of a device, bit 2 of clock_rate_t selects SPI2X */
+#define SPI_NATIVE_RATE(clockrate) (((clockrate) & 0x04) ? (1 << SPI2X) : 0)
+
+/* 1 if the pin of a port, given by its letter, is SCK, MOSI or MISO of the native SPI */
+#define SPI_PIN_RESERVED(port_letter, pin) \
+    (SPI_PORT_ID_##port_letter == SPI_PORT_ID && ((pin) == SPI_SCK || (pin) == SPI_MOSI || (pin) == SPI_MISO))
+
+/* Output register of a port given by its letter, as an address constant */
+#ifndef SPI_PORT_ADDRESS
+#define SPI_PORT_ADDRESS(port_letter) (&PORT##port_letter)
+#endif
+
+/* Evaluates to 0 and stops the compiler if the constant condition is false */
+#define SPI_STATIC_CHECK(condition) (0 * sizeof(char[(condition) ? 1 : -1]))
+
+/* Initializer of a device_t on the native SPI, the chip select pin is given by its port letter */
+#define SPI_DEVICE(port_letter, pin, data_order, mode, divider, fill_byte) { \
+    .port = SPI_PORT_ADDRESS(port_letter), \
+    .mask = (uint8_t)((1 << (pin)) + SPI_STATIC_CHECK((pin) < 8 && !SPI_PIN_RESERVED(port_letter, pin))), \
+    .ctrl = (uint8_t)(SPI_NATIVE_CTRL(data_order, mode, SPI_CLOCK_RATE(divider)) \
+        + SPI_STATIC_CHECK(SPI_CLOCK_RATE(divider) != SPI_CLOCK_INVALID)), \
+    .rate = SPI_NATIVE_RATE(SPI_CLOCK_RATE(divider)), \
+    .poll_max_bytes = 0, \
+    .fill = (uint8_t)((fill_byte) + SPI_STATIC_CHECK(!SPI_FIXED_FILL || (fill_byte) == SPI_FILL_BYTE)), \
+    .bus = NULL \
+}
+
+spi_error_t spi_add_device(device_t*);
+
+#endif /* SPI_STATIC_H_ */
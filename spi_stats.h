@@ -0,0 +1,111 @@
+/*************************************************************************
+* Title		: SPI Statistics
+* Author	: Dimitri Dening
+* Created	: 17.10.2026 19:12:08
+* Software	: Microchip Studio V7
+* Hardware	: Atmega1284P
+* License	: MIT License
+* Usage		: see Doxygen manual
+*
+*       Copyright (C) 2021 Dimitri Dening
+*
+*       Permission is hereby granted, free of charge, to any person obtaining a copy
+*       of this software and associated documentation files (the "Software"), to deal
+*       in the Software without restriction, including without limitation the rights
+*       to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*       copies of the Software, and to permit persons to whom the Software is
+*       furnished to do so, subject to the following conditions:
+*
+*       The above copyright notice and this permission notice shall be included in all
+*       copies or substantial portions of the Software.
+*
+*       THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*       IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*       FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*       AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*       LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*       OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*       SOFTWARE.
+*
+* NOTES:
+*	This file should only be included from <spi.h>, never directly.
+*************************************************************************/
+
+
+/**
+@file spi_stats.h
+@author Dimitri Dening
+@date 17.10.2026
+@copyright (C) 2021 Dimitri Dening, MIT License
+@brief Per-device and per-bus counters of the driver, see spi_get_stats().
+
+With SPI_STATS set in <spi_config.h> the driver counts the transactions and bytes of every device,
+and for every bus its chip select assertions, the deepest its queue got, the time it was busy and
+the longest a transaction waited from its submission until its chip select was asserted. The
+counters are updated once per transaction, when the bus starts and ends it, and never per byte.
+
+Times are ticks of SPI_STATS_TIME(), by default TCNT1. The application runs Timer1 freely with
+a prescaler that suits its transfers. A transaction may take up to one timer period, and while
+the buses are idle spi_get_stats() has to be called at least once per timer period to keep the
+elapsed time, so that idle time = elapsed - busy.
+
+@code
+    spi_stats_t stats;
+    spi_device_stats_t flash_stats;
+
+    spi_get_stats(&stats);
+    spi_get_device_stats(flash, &flash_stats);
+
+    uint32_t idle = stats.bus[SPI_BUS_SPI].elapsed - stats.bus[SPI_BUS_SPI].busy;
+
+    spi_reset_stats();
+@endcode
+
+spi_wait() and spi_wait_idle() count the ticks they spent in idle sleep. All buses share the
+time base, so the CPU was busy for the elapsed time of a bus minus the slept ticks.
+
+@code
+    uint32_t cpu_busy = stats.bus[SPI_BUS_SPI].elapsed - stats.sleep.slept;
+@endcode
+
+Errors per spi_error_t are the counters of <spi_error_handler.h>, the snapshot includes them and
+spi_error_clear() resets them.
+
+@note Without SPI_STATS the functions are available, but the snapshot stays zero.
+@note Transactions that complete without a single byte never reach the bus and are not counted.
+@note This file should only be included from <spi.h>, never directly.
+@bug No known bugs.
+*/
+#ifndef SPI_STATS_H_
+#define SPI_STATS_H_
+
+#include <stdint.h>
+
+typedef struct spi_device_stats_t {
+    uint32_t transactions;      // Transactions sent to the device
+    uint32_t bytes;             // Bytes clocked while its chip select was asserted
+} spi_device_stats_t;
+
+typedef struct spi_bus_stats_t {
+    uint32_t cs_asserts;        // Chip select assertions, one per transaction or stream
+    uint32_t bytes;
+    uint32_t busy;              // Ticks with a chip select asserted
+    uint32_t elapsed;           // Ticks since the last reset
+    uint16_t max_latency;       // Longest time in ticks from submission to chip select
+    uint16_t queue_peak;        // Most transactions queued at once
+} spi_bus_stats_t;
+
+typedef struct spi_sleep_stats_t {
+    uint32_t waits;             // Calls of spi_wait() and spi_wait_idle()
+    uint32_t sleeps;            // Times the waits went to sleep, one per wakeup
+    uint32_t slept;             // Ticks in idle sleep
+    uint32_t awake;             // Ticks the waits were awake, checking their condition
+} spi_sleep_stats_t;
+
+typedef struct spi_stats_t {
+    spi_bus_stats_t bus[SPI_NR_BUSES];
+    spi_sleep_stats_t sleep;
+    spi_error_stats_t errors;
+} spi_stats_t;
+
+#endif /* SPI_STATS_H_ */
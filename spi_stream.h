@@ -0,0 +1,109 @@
+/*************************************************************************
+* Title		: SPI Streams
+* Author	: Dimitri Dening
+* Created	: 17.10.2026 16:37:45
+* Software	: Microchip Studio V7
+* Hardware	: Atmega1284P
+* License	: MIT License
+* Usage		: see Doxygen manual
+*
+*       Copyright (C) 2021 Dimitri Dening
+*
+*       Permission is hereby granted, free of charge, to any person obtaining a copy
+*       of this software and associated documentation files (the "Software"), to deal
+*       in the Software without restriction, including without limitation the rights
+*       to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*       copies of the Software, and to permit persons to whom the Software is
+*       furnished to do so, subject to the following conditions:
+*
+*       The above copyright notice and this permission notice shall be included in all
+*       copies or substantial portions of the Software.
+*
+*       THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*       IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*       FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*       AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*       LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*       OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*       SOFTWARE.
+*
+* NOTES:
+*	This file should only be included from <spi.h>, never directly.
+*************************************************************************/
+
+/**
+@file spi_stream.h
+@author Dimitri Dening
+@date 17.10.2026
+@copyright (C) 2021 Dimitri Dening, MIT License
+@brief Continuous reception from one device into a ring of caller-provided buffers.
+
+A stream asserts the chip select of its device, sends the segments of its transaction once, e.g.
+a read command, and then clocks out the fill byte until it is stopped. The received bytes go to the buffers in turn. Every buffer is filled in two halves,
+and ISR(SPI_STC_vect) calls the watermark callback once the first half (SPI_STREAM_HALF) and
+once the whole buffer (SPI_STREAM_FULL) has been received. The next half is already shifting
+when the callback runs, so the bus does not pause between buffers and the main loop can work
+on one buffer while the others are being filled.
+
+@code
+    static uint8_t block_a[128], block_b[128];
+    static uint8_t* const blocks[] = { block_a, block_b };
+    static volatile uint8_t* ready;
+
+    static void on_block(void* ctx, uint8_t* buffer, spi_stream_event_t event){
+        if (event == SPI_STREAM_FULL) ready = buffer;
+    }
+
+    static spi_stream_t stream = {
+        .buffers = blocks,
+        .nr_buffers = ARRAY_LEN(blocks),     // at most 127
+        .length = sizeof(block_a),
+        .watermark = on_block
+    };
+
+    stream.transaction.device = adc;
+    spi_handle_t handle = spi_stream_start(&stream);
+
+    // ... process ready blocks
+
+    spi_stream_stop(&stream);
+    spi_wait(handle);
+@endcode
+
+A stream occupies its bus. Transactions submitted meanwhile stay queued and are sent once the
+stream stopped. A stream stops at the next half buffer boundary after spi_stream_stop(), its
+handle then completes and the transaction callback is called.
+
+@note Streams run on the native SPI only, since they rely on ISR(SPI_STC_vect).
+@note The watermark callback runs in ISR context. A buffer has to be processed before the
+      stream comes back to it, the driver does not detect overruns.
+@note This file should only be included from <spi.h>, never directly.
+@bug No known bugs.
+*/
+#ifndef SPI_STREAM_H_
+#define SPI_STREAM_H_
+
+#include <stdint.h>
+
+typedef enum {
+    SPI_STREAM_HALF,    // The first half of the buffer has been received
+    SPI_STREAM_FULL     // The whole buffer has been received
+} spi_stream_event_t;
+
+/* Called with the ctx pointer of the stream transaction and the buffer the event refers to */
+typedef void (*spi_stream_fn)(void* ctx, uint8_t* buffer, spi_stream_event_t event);
+
+typedef struct spi_stream_t {
+    spi_transaction_t transaction;  // Device, callback, ctx and optional command segments
+    uint8_t* const* buffers;
+    uint8_t nr_buffers;
+    spi_length_t length;            // Bytes per buffer, at least 2
+    spi_stream_fn watermark;
+    volatile uint8_t stop;          // Set by spi_stream_stop()
+    uint8_t half;                   // Half buffer being received or SPI_STREAM_COMMAND, set by the driver
+} spi_stream_t;
+
+/* The command segments of the stream transaction are being sent */
+#define SPI_STREAM_COMMAND 0xFF
+
+#endif /* SPI_STREAM_H_ */
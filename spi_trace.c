@@ -0,0 +1,174 @@
+/*************************************************************************
+* Title     : SPI Transaction Trace
+* Author    : Dimitri Dening
+* Created   : 17.10.2026 20:11:17
+* Software  : Microchip Studio V7
+* Hardware  : Atmega1284P
+
+DESCRIPTION:
+    Ring of timestamped driver events and its binary dump.
+USAGE:
+    see <spi_trace.h>
+NOTES:
+    spi_trace_record() runs in ISR and main loop context, so the ring is
+    only touched inside an ATOMIC_BLOCK. A full ring drops its oldest entry.
+*************************************************************************/
+
+/* General libraries */
+#include <util/atomic.h>
+
+/* User defined libraries */
+#include "spi.h"
+
+#define UART_DEBUG_OUTPUT 1
+
+#if UART_DEBUG_OUTPUT
+    #include "uart.h"
+#endif
+
+#if SPI_TRACE && ((SPI_TRACE_SIZE & (SPI_TRACE_SIZE - 1)) != 0 || SPI_TRACE_SIZE == 0 || SPI_TRACE_SIZE > 128)
+# error "SPI_TRACE_SIZE has to be a power of two between 1 and 128"
+#endif
+
+/* Bytes of a dumped entry and of the frame header */
+#define ENTRY_BYTES     5
+#define HEADER_BYTES    6
+
+/* Entry bytes per line of spi_trace_report() */
+#define REPORT_BYTES    16
+
+#if SPI_TRACE
+static spi_trace_entry_t trace[SPI_TRACE_SIZE];
+static uint8_t trace_head;              // Next entry to write
+static uint8_t trace_tail;              // Oldest unread entry
+static uint16_t trace_lost;             // Entries overwritten before they were read
+#endif
+
+void spi_trace_record(spi_trace_event_t event, uint8_t device, uint8_t arg) {
+
+#if SPI_TRACE
+    uint16_t time = SPI_TRACE_TIME();
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+
+        spi_trace_entry_t* entry = &trace[trace_head % SPI_TRACE_SIZE];
+
+        /* A full ring drops its oldest entry */
+        if ((uint8_t)(trace_head - trace_tail) == SPI_TRACE_SIZE) {
+            trace_tail++;
+            if (trace_lost != UINT16_MAX) trace_lost++;
+        }
+
+        entry->time = time;
+        entry->event = event;
+        entry->device = device;
+        entry->arg = arg;
+        trace_head++;
+    }
+#else
+    (void)event;
+    (void)device;
+    (void)arg;
+#endif
+}
+
+uint8_t spi_trace_read(spi_trace_entry_t* entry) {
+
+    uint8_t read = 0;
+
+#if SPI_TRACE
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        if (trace_tail != trace_head) {
+            *entry = trace[trace_tail % SPI_TRACE_SIZE];
+            trace_tail++;
+            read = 1;
+        }
+    }
+#else
+    (void)entry;
+#endif
+
+    return read;
+}
+
+void spi_trace_dump(spi_trace_put_fn put, void* ctx) {
+
+    uint8_t count = 0;
+    uint16_t lost = 0;
+
+#if SPI_TRACE
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        count = trace_head - trace_tail;
+        lost = trace_lost;
+        trace_lost = 0;
+    }
+#endif
+
+    put(ctx, 'S');
+    put(ctx, 'T');
+    put(ctx, SPI_TRACE_VERSION);
+    put(ctx, count);
+    put(ctx, (uint8_t)lost);
+    put(ctx, (uint8_t)(lost >> 8));
+
+    /* Entries recorded meanwhile only replace older ones, so there are always count entries to read */
+    for (uint8_t i = 0; i < count; i++) {
+
+        spi_trace_entry_t entry;
+
+        if (!spi_trace_read(&entry)) break;
+
+        put(ctx, (uint8_t)entry.time);
+        put(ctx, (uint8_t)(entry.time >> 8));
+        put(ctx, entry.event);
+        put(ctx, entry.device);
+        put(ctx, entry.arg);
+    }
+}
+
+#if UART_DEBUG_OUTPUT
+typedef struct {
+    char line[2 * REPORT_BYTES + 1];
+    uint8_t length;
+} report_t;
+
+static void spi_trace_flush(report_t* report) {
+
+    if (report->length == 0) return;
+
+    report->line[report->length] = '\0';
+    uart_put("%s %s", "[spi trace]:", report->line);
+    report->length = 0;
+}
+
+static void spi_trace_hex(void* ctx, uint8_t byte) {
+
+    static const char digits[] = "0123456789abcdef";
+    report_t* report = ctx;
+
+    report->line[report->length++] = digits[byte >> 4];
+    report->line[report->length++] = digits[byte & 0x0F];
+
+    if (report->length == 2 * REPORT_BYTES) spi_trace_flush(report);
+}
+#endif
+
+void spi_trace_report(void) {
+
+#if UART_DEBUG_OUTPUT
+    report_t report = { .length = 0 };
+
+    spi_trace_dump(spi_trace_hex, &report);
+    spi_trace_flush(&report);
+#endif
+}
+
+void spi_trace_clear(void) {
+
+#if SPI_TRACE
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        trace_tail = trace_head;
+        trace_lost = 0;
+    }
+#endif
+}
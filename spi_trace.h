@@ -0,0 +1,113 @@
+/*************************************************************************
+* Title		: SPI Transaction Trace
+* Author	: Dimitri Dening
+* Created	: 17.10.2026 20:03:41
+* Software	: Microchip Studio V7
+* Hardware	: Atmega1284P
+* License	: MIT License
+* Usage		: see Doxygen manual
+*
+*       Copyright (C) 2021 Dimitri Dening
+*
+*       Permission is hereby granted, free of charge, to any person obtaining a copy
+*       of this software and associated documentation files (the "Software"), to deal
+*       in the Software without restriction, including without limitation the rights
+*       to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*       copies of the Software, and to permit persons to whom the Software is
+*       furnished to do so, subject to the following conditions:
+*
+*       The above copyright notice and this permission notice shall be included in all
+*       copies or substantial portions of the Software.
+*
+*       THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*       IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*       FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*       AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*       LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*       OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*       SOFTWARE.
+*
+* NOTES:
+*	This file should only be included from <spi.h>, never directly.
+*************************************************************************/
+
+
+/**
+@file spi_trace.h
+@author Dimitri Dening
+@date 17.10.2026
+@copyright (C) 2021 Dimitri Dening, MIT License
+@brief Ring of timestamped transaction events for finding latency problems in the field.
+
+With SPI_TRACE set in <spi_config.h> the driver records an event on every submission, chip select
+assertion and release, segment switch, completion and logged error. An entry holds the event, the
+index of the device in the device table, one argument byte and a timestamp of SPI_TRACE_TIME(),
+by default the time base of the statistics. The ring keeps the latest SPI_TRACE_SIZE entries, older
+ones are overwritten and counted as lost. Nothing is recorded per byte.
+
+spi_trace_dump() drains the ring into a compact binary frame, one byte at a time through a callback.
+spi_trace_report() sends the same frame as hex lines over the UART, which <sim/spi_trace_decode.c>
+turns into a timeline and latency histograms on the host:
+
+@code
+    static void put(void* ctx, uint8_t byte){
+        uart_putc(byte);
+    }
+
+    spi_trace_dump(put, NULL);      // binary
+    spi_trace_report();             // "[spi trace]: 53540108..." lines
+@endcode
+
+Frame layout, all values little endian:
+
+@code
+    'S' 'T' version count lost_lo lost_hi        header, 6 bytes
+    time_lo time_hi event device arg             count entries, 5 bytes each
+@endcode
+
+@note Events are recorded from the main loop and the interrupts, so recording takes a short critical section.
+@note The application may record its own markers with spi_trace_record() and SPI_TRACE_MARK.
+@note This file should only be included from <spi.h>, never directly.
+@bug No known bugs.
+*/
+#ifndef SPI_TRACE_H_
+#define SPI_TRACE_H_
+
+#include <stdint.h>
+
+typedef enum {
+    SPI_TRACE_SUBMIT,       // Queued or about to be polled, arg is the priority
+    SPI_TRACE_CS_ASSERT,    // The bus started the transaction, arg is 1 if it is polled
+    SPI_TRACE_SEGMENT,      // The next segment is being clocked, arg is its index
+    SPI_TRACE_CS_RELEASE,
+    SPI_TRACE_DONE,         // Handed back to its owner, arg is the status
+    SPI_TRACE_ERROR,        // Logged by error_handler(), arg is the error
+    SPI_TRACE_MARK          // Recorded by the application
+} spi_trace_event_t;
+
+/* Device index of events that don't belong to a device */
+#define SPI_TRACE_NO_DEVICE 0xFF
+
+#define SPI_TRACE_VERSION 1
+
+typedef struct spi_trace_entry_t {
+    uint16_t time;
+    uint8_t event;
+    uint8_t device;
+    uint8_t arg;
+} spi_trace_entry_t;
+
+/* Receives the bytes of a dump */
+typedef void (*spi_trace_put_fn)(void* ctx, uint8_t byte);
+
+void spi_trace_record(spi_trace_event_t event, uint8_t device, uint8_t arg);
+
+uint8_t spi_trace_read(spi_trace_entry_t* entry);
+
+void spi_trace_dump(spi_trace_put_fn put, void* ctx);
+
+void spi_trace_report(void);
+
+void spi_trace_clear(void);
+
+#endif /* SPI_TRACE_H_ */
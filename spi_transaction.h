@@ -0,0 +1,126 @@
+/*************************************************************************
+* Title		: SPI Transactions
+* Author	: Dimitri Dening
+* Created	: 17.10.2026 13:41:52
+* Software	: Microchip Studio V7
+* Hardware	: Atmega1284P
+* License	: MIT License
+* Usage		: see Doxygen manual
+*
+*       Copyright (C) 2021 Dimitri Dening
+*
+*       Permission is hereby granted, free of charge, to any person obtaining a copy
+*       of this software and associated documentation files (the "Software"), to deal
+*       in the Software without restriction, including without limitation the rights
+*       to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*       copies of the Software, and to permit persons to whom the Software is
+*       furnished to do so, subject to the following conditions:
+*
+*       The above copyright notice and this permission notice shall be included in all
+*       copies or substantial portions of the Software.
+*
+*       THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*       IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*       FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*       AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*       LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*       OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*       SOFTWARE.
+*
+* NOTES:
+*	This file should only be included from <spi.h>, never directly.
+*************************************************************************/
+
+/**
+@file spi_transaction.h
+@author Dimitri Dening
+@date 17.10.2026
+@copyright (C) 2021 Dimitri Dening, MIT License
+@brief A transaction is a list of segments clocked back to back under one chip select assertion.
+
+ISR(SPI_STC_vect) moves from one segment to the next without releasing the chip select and
+without going back to the queue, so a command, its address, dummy clocks and the data phase
+form one gap-free unit on the bus.
+A segment is up to 2^SPI_LENGTH_BITS - 1 bytes long, e.g. a complete 264 byte AT45DB page.
+
+@code
+    // AT45DB041B main memory page read (0xD2): opcode + address, 4 dummy bytes, data
+    static const uint8_t cmd[] = { 0xD2, 0x00, 0x00, 0x00 };
+    static uint8_t page[8];
+
+    static const spi_segment_t segments[] = {
+        SPI_TX(cmd, sizeof(cmd)),
+        SPI_FILL(4),
+        SPI_RX(page, sizeof(page))
+    };
+
+    static spi_transaction_t transaction = {
+        .segments = segments,
+        .nr_segments = ARRAY_LEN(segments)
+    };
+
+    transaction.device = spi_device;
+    spi_wait(spi_transfer(&transaction));
+@endcode
+
+@note The transaction and its segments are owned by the caller and have to stay valid until the
+      transaction completed.
+@note This file should only be included from <spi.h>, never directly.
+@bug No known bugs.
+*/
+#ifndef SPI_TRANSACTION_H_
+#define SPI_TRANSACTION_H_
+
+#include <stdint.h>
+
+struct device_t;
+
+typedef enum {
+    PRIORITY_LOW,
+    PRIORITY_MEDIUM,
+    PRIORITY_HIGH
+} priority_t;
+
+#if SPI_LENGTH_BITS == 8
+typedef uint8_t spi_length_t;
+#elif SPI_LENGTH_BITS == 16
+typedef uint16_t spi_length_t;
+#elif SPI_LENGTH_BITS == 32
+typedef uint32_t spi_length_t;
+#else
+#error "SPI_LENGTH_BITS has to be 8, 16 or 32"
+#endif
+
+/* Called once per transaction with its ctx pointer and final status, in ISR context for interrupt driven transfers */
+typedef void (*callback_fn)(void* ctx, spi_error_t status);
+
+/* 
+ * Describes one full-duplex phase of a transaction. A NULL tx clocks out the fill byte
+ * of the device, a NULL rx discards the received bytes.
+ */
+typedef struct spi_segment_t {
+    const uint8_t* tx;
+    uint8_t* rx;
+    spi_length_t length;
+} spi_segment_t;
+
+/* Describes a list of segments transferred under a single chip select assertion */
+typedef struct spi_transaction_t {
+    struct device_t* device;
+    const spi_segment_t* segments;
+    uint8_t nr_segments;
+    priority_t priority;
+    callback_fn callback;
+    void* ctx;                      // Passed to the callback
+    spi_handle_t handle;            // Set by the driver on submission
+#if SPI_STATS
+    uint16_t submitted;             // SPI_STATS_TIME() of the submission, set by the driver
+#endif
+} spi_transaction_t;
+
+#define SPI_TX(tx, length)          { (tx), NULL, (length) }   // Send tx, discard the received bytes
+#define SPI_RX(rx, length)          { NULL, (rx), (length) }   // Send the fill byte, store the received bytes
+#define SPI_DUPLEX(tx, rx, length)  { (tx), (rx), (length) }   // Send tx, store the received bytes
+#define SPI_FILL(length)            { NULL, NULL, (length) }   // Send the fill byte, discard the received bytes
+
+#endif /* SPI_TRANSACTION_H_ */
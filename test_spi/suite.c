@@ -34,9 +34,60 @@
 @date 13.02.2022
 */
 #include <stdio.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
 #include "suite.h"
 #include "uart.h"
 
+#ifndef F_CPU
+#error "F_CPU has to be defined, the bench lines convert cycles to bytes per second with it"
+#endif
+
+/* Timer3, so that Timer1 stays free for SPI_STATS_TIME() of the driver */
+#ifndef SUITE_CYCLES
+#define SUITE_CYCLES() suite_timer3_cycles()
+#define SUITE_TIMER3 1
+#endif
+
+#if SUITE_TIMER3
+static volatile uint16_t timer3_overflows;
+
+ISR(TIMER3_OVF_vect) {
+	timer3_overflows++;
+}
+
+/* Timer3 in normal mode without prescaler */
+static void suite_timer3_start(void) {
+	TCCR3B = 0;
+	TCCR3A = 0;
+	TCNT3 = 0;
+	timer3_overflows = 0;
+	TIFR3 = (1 << TOV3);
+	TIMSK3 |= (1 << TOIE3);
+	TCCR3B = (1 << CS30);
+}
+
+static void suite_timer3_stop(void) {
+	TCCR3B = 0;
+	TIMSK3 &= ~(1 << TOIE3);
+}
+
+static uint32_t suite_timer3_cycles(void) {
+	uint16_t high;
+	uint16_t low;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		high = timer3_overflows;
+		low = TCNT3;
+		/* An overflow that is still pending belongs to a low count read after it */
+		if ((TIFR3 & (1 << TOV3)) && low < 0x8000) high++;
+	}
+
+	return (uint32_t)high << 16 | low;
+}
+#endif
+
 static void test_report_failure(const struct test_case* test, const char* stage, int result) {
 	uart_put("Test %s failed: %d", test->name, result);
 }
@@ -61,11 +112,15 @@ static int test_case_run(const struct test_case* test) {
 	
 	uart_put("Running test: %s", test->name);
 
+	if (test->setup) test->setup(test);
+
 	result = test_call(test->run, test);
 	if (result) {
 		test_report_failure(test, "test", result);
 	}
 
+	if (test->cleanup) test->cleanup(test);
+
 	return result;
 }
 
@@ -93,4 +148,80 @@ int test_spi_suite_run(const struct test_suite* suite) {
 	uart_put("Test suite %s complete: %u tests, %u failures, %u errors\r\n", suite->name, suite->nr_tests, nr_failures, nr_errors);
 
 	return nr_errors + nr_failures;
+}
+
+/* Sorts the samples of a bench case for its median, they are few */
+static void bench_sort(uint32_t* samples, uint8_t count) {
+	for (uint8_t i = 1; i < count; i++) {
+		uint32_t sample = samples[i];
+		uint8_t j = i;
+		while (j > 0 && samples[j - 1] > sample) {
+			samples[j] = samples[j - 1];
+			j--;
+		}
+		samples[j] = sample;
+	}
+}
+
+static int bench_case_run(const struct bench_case* bench, uint8_t repetitions) {
+	static uint32_t samples[SUITE_BENCH_MAX_REPETITIONS];
+	int result = TEST_PASS;
+	uint8_t i;
+
+	if (bench->setup) bench->setup(bench);
+
+	for (i = 0; i < SUITE_BENCH_WARMUP && result == TEST_PASS; i++) {
+		result = bench->run(bench);
+	}
+
+	for (i = 0; i < repetitions && result == TEST_PASS; i++) {
+		uint32_t start = SUITE_CYCLES();
+		result = bench->run(bench);
+		samples[i] = SUITE_CYCLES() - start;
+	}
+
+	if (bench->cleanup) bench->cleanup(bench);
+
+	if (result != TEST_PASS) {
+		uart_put("bench %s error=%d", bench->name, result);
+		return result;
+	}
+
+	bench_sort(samples, repetitions);
+
+	uint32_t median = samples[repetitions / 2];
+	uint32_t bytes_per_s = median ? (uint32_t)((uint64_t)bench->bytes * F_CPU / median) : 0;
+
+	uart_put("bench %s reps=%u min_cycles=%lu median_cycles=%lu max_cycles=%lu bytes=%lu bytes_per_s=%lu f_cpu=%lu",
+		bench->name, repetitions, (unsigned long)samples[0], (unsigned long)median, (unsigned long)samples[repetitions - 1],
+		(unsigned long)bench->bytes, (unsigned long)bytes_per_s, (unsigned long)F_CPU);
+
+	return TEST_PASS;
+}
+
+int test_spi_bench_run(const struct bench_suite* suite) {
+	unsigned int nr_errors = 0;
+	unsigned int i;
+	uint8_t repetitions = suite->repetitions;
+
+	if (repetitions == 0) repetitions = 1;
+	if (repetitions > SUITE_BENCH_MAX_REPETITIONS) repetitions = SUITE_BENCH_MAX_REPETITIONS;
+
+	uart_put("Running bench suite %s ...", suite->name);
+
+#if SUITE_TIMER3
+	suite_timer3_start();
+#endif
+
+	for (i = 0; i < suite->nr_benches; i++) {
+		if (bench_case_run(suite->benches[i], repetitions) != TEST_PASS) nr_errors++;
+	}
+
+#if SUITE_TIMER3
+	suite_timer3_stop();
+#endif
+
+	uart_put("Bench suite %s complete: %u cases, %u errors\r\n", suite->name, suite->nr_benches, nr_errors);
+
+	return nr_errors;
 }
\ No newline at end of file
@@ -32,11 +32,31 @@
 @file suite.h
 @author Dimitri Dening
 @date 13.02.2022
+@note A bench suite runs every case SUITE_BENCH_WARMUP times unmeasured and then a number of
+      measured repetitions, and reports one line per case over the UART:
+@code
+    bench throughput div=16 size=64 devices=1 reps=15 min_cycles=9311 median_cycles=9318 max_cycles=9342 bytes=512 bytes_per_s=549474 f_cpu=10000000
+@endcode
+@note The cycles are counted by Timer3 at F_CPU with its overflows counted in ISR(TIMER3_OVF_vect),
+      so the suite owns Timer3 while it runs. Timer1 is left to SPI_STATS_TIME(), which must not be
+      pointed at Timer3. Boards without Timer3 define SUITE_CYCLES() as a free-running 32 bit cycle count.
 */
 
 #ifndef TEST_SUITE_H_INCLUDED
 #define TEST_SUITE_H_INCLUDED
 
+#include <stdint.h>
+
+/* Unmeasured runs of a bench case before its repetitions */
+#ifndef SUITE_BENCH_WARMUP
+#define SUITE_BENCH_WARMUP 2
+#endif
+
+/* Most measured repetitions of a bench case, the samples are kept for the median */
+#ifndef SUITE_BENCH_MAX_REPETITIONS
+#define SUITE_BENCH_MAX_REPETITIONS 32
+#endif
+
 enum test_status {
 	TEST_ERROR = -1,
 	TEST_PASS = 0,  
@@ -65,6 +85,46 @@ struct test_suite {
 		.name    = _test_str_##_sym,                                \
 	}
 
+/* A case whose run is measured, setup and cleanup run once around all of its repetitions */
+struct bench_case {
+	void (*setup)(const struct bench_case* bench);
+	int (*run)(const struct bench_case* bench);
+	void (*cleanup)(const struct bench_case* bench);
+	const char* name;					  // Key=value pairs describing the case
+	const void* params;					  // Passed through to the hooks
+	uint32_t bytes;						  // Bus bytes per run, 0 if the case doesn't move data
+};
+
+struct bench_suite {
+	unsigned int nr_benches;
+	const struct bench_case* const* benches;
+	const char* name;
+	uint8_t repetitions;				  // At most SUITE_BENCH_MAX_REPETITIONS
+};
+
+#define DEFINE_BENCH_CASE(_sym, _setup, _run, _cleanup, _name, _params, _bytes) \
+	static const char _bench_str_##_sym[] = _name;                  \
+	static const struct bench_case _sym = {                         \
+		.setup   = _setup,                                          \
+		.run     = _run,                                            \
+		.cleanup = _cleanup,                                        \
+		.name    = _bench_str_##_sym,                               \
+		.params  = _params,                                         \
+		.bytes   = _bytes,                                          \
+	}
+
+#define DEFINE_BENCH_ARRAY(_sym)                                    \
+	const struct bench_case *const _sym[]
+
+#define DEFINE_BENCH_SUITE(_sym, _bench_array, _name, _repetitions)    \
+	static const char _bench_str_##_sym[] = _name;                     \
+	const struct bench_suite _sym = {                                  \
+		.nr_benches  = ARRAY_LEN(_bench_array),                        \
+		.benches     = _bench_array,                                   \
+		.name        = _bench_str_##_sym,                              \
+		.repetitions = _repetitions,                                   \
+	}
+
 #define DEFINE_TEST_ARRAY(_sym)                                     \
 	const struct test_case *const _sym[]
 
@@ -82,4 +142,6 @@ struct test_suite {
 
 int test_spi_suite_run(const struct test_suite* suite);
 
+int test_spi_bench_run(const struct bench_suite* suite);
+
 #endif /* TEST_SUITE_H_INCLUDED */
\ No newline at end of file
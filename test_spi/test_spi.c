@@ -36,12 +36,15 @@
 @brief SPI Unit Test
 @note Connect the flash memory (AT45DB041B) on the STK600 to the SPI PORT.
 @note Connect two STK600s to run the entire unit test.       
+@note test_spi_bench() runs the benchmark cases. Their transactions are AT45DB status reads, which
+      the flash answers for any length, and the pins of SPI_BENCH_PORTS besides the first are left open.
 */
 
 #include <avr/io.h>
 #include <avr/wdt.h>
 #include <avr/interrupt.h>
 #include <util/delay.h>
+#include <util/atomic.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -49,43 +52,65 @@
 #include "test_spi.h"
 #include "suite.h"
 #include "spi.h"
+#include "at45db.h"
+#include "at45db_cache.h"
 #include "uart.h"
 #include "led_lib.h"
 
-/* Define CPU frequency in Hz here if not defined in Makefile */
-#ifndef F_CPU
-#define F_CPU 10000000UL
-#endif
-	
+/* Number of bytes read from page 0 */
+#define FLASH_READ_BYTES 5
+
+/* Page size of the AT45DB041B */
+#define FLASH_PAGE_BYTES 264
+
 static device_t* spi_device;
 
-static uint8_t data_buffer_write[]	= { 0x84, 0x00, 0x00, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05 };
-static uint8_t data_flash_write[]	= { 0x83, 0x00, 0x00, 0x00 };
+static at45db_t flash;
+
+static at45db_cache_t cache;
+
+/* Transactions per bench run, every one keeps its completion handle and queue entry */
+#define BENCH_TRANSACTIONS 8
+
+#define BENCH_MAX_DEVICES 4
+
+typedef struct {
+	uint32_t frequency;			// Maximum SCK of the devices
+	uint8_t size;				// Bytes per transaction
+	uint8_t nr_devices;			// Devices the transactions alternate between
+} spi_bench_t;
+
+static const uint8_t bench_ports[BENCH_MAX_DEVICES] = { SPI_BENCH_PORTS };
+
+static device_t* bench_devices[BENCH_MAX_DEVICES];
+
+static uint8_t bench_data[UINT8_MAX];
+
+static spi_segment_t bench_segments[BENCH_TRANSACTIONS];
+
+static spi_transaction_t bench_transactions[BENCH_TRANSACTIONS];
+
 static uint8_t data_flash_read[]	= { 0xd2, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
 static uint8_t data_sent[]			= { 0x01, 0x02, 0x03, 0x04, 0x05 };
-static uint8_t dummy[]              = { 0x00, 0x00, 0x00, 0x00, 0x00 };
-
-/* Callback Flags */
-static bool memory_return_success = 0;
 
 /* Callback Functions */
-static void callback_memory_leak(void) { memory_return_success = 1; };
+static void callback_memory_leak(void* ctx, spi_error_t status) {
+	if (status == SPI_NO_ERROR) (*(uint16_t*)ctx)++;
+}
+
+static void callback_status(void* ctx, spi_error_t status) {
+	*(spi_error_t*)ctx = status;
+}
       
 static int flash_read_data(device_t* device, uint8_t* container) {
-
-	bool ret = 0;
 			   
     /* Send the flash read command */
     payload_t* payload1 = payload_create_spi(PRIORITY_LOW, device, data_flash_read, ARRAY_LEN(data_flash_read), NULL);
     
     /* Get the data from flash */  
-    payload_t* payload2 = payload_create_spi(PRIORITY_LOW, device, dummy, ARRAY_LEN(dummy), NULL);
-    
-    ret = spi_read_write(payload1, payload2, container);
-    
-    if (ret != 0) return TEST_ERROR;
+    payload_t* payload2 = payload_create_spi(PRIORITY_LOW, device, NULL, FLASH_READ_BYTES, NULL);
     
-	for (volatile uint16_t i = 0; i < 30000; i++) {}
+    if (spi_wait(spi_read_write(payload1, payload2, container)) != SPI_NO_ERROR) return TEST_ERROR;
 			
 	return 0;
 }
@@ -94,7 +119,7 @@ static int run_spi_flash_read_test(const struct test_case* test) {
 	
 	bool ret = false;
 	
-	uint8_t* spi_receive = (uint8_t*)malloc(sizeof(uint8_t) * ARRAY_LEN(dummy));
+	uint8_t* spi_receive = (uint8_t*)malloc(sizeof(uint8_t) * FLASH_READ_BYTES);
 
 	if (spi_receive == NULL) { return TEST_ERROR; }
 	
@@ -107,7 +132,7 @@ static int run_spi_flash_read_test(const struct test_case* test) {
 	}
 	
 	/* Check the read data */
-	for (uint8_t i = 0; i < ARRAY_LEN(dummy); i++) {
+	for (uint8_t i = 0; i < FLASH_READ_BYTES; i++) {
 		uart_put("%s %d", "[device 1]: read spi data", spi_receive[i]);
 		/* Clear receive data buffer */
 		spi_receive[i] = 0;
@@ -118,14 +143,138 @@ static int run_spi_flash_read_test(const struct test_case* test) {
 	return TEST_PASS;
 }
 
+static int run_spi_transaction_test(const struct test_case* test) {
+	
+	uint8_t expected[FLASH_READ_BYTES];
+	uint8_t received[FLASH_READ_BYTES];
+	
+	/* Opcode and address, the four don't care bytes and the data phase under one chip select */
+	const spi_segment_t segments[] = {
+		SPI_TX(data_flash_read, 4),
+		SPI_FILL(4),
+		SPI_RX(received, ARRAY_LEN(received))
+	};
+	
+	spi_transaction_t transaction = {
+		.device = spi_device,
+		.segments = segments,
+		.nr_segments = ARRAY_LEN(segments),
+		.priority = PRIORITY_LOW,
+		.callback = NULL
+	};
+	
+	if (flash_read_data(spi_device, expected) != 0) return TEST_ERROR;
+	
+	if (spi_wait(spi_transfer(&transaction)) != SPI_NO_ERROR) return TEST_ERROR;
+	
+	/* Both ways of reading page 0 have to return the same bytes */
+	for (uint8_t i = 0; i < ARRAY_LEN(received); i++) {
+		if (received[i] != expected[i]) {
+			uart_put("%s %d", "[device 1]: transaction mismatch at", i);
+			return TEST_FAIL;
+		}
+	}
+	
+	return TEST_PASS;
+}
+
+static int run_spi_page_read_test(const struct test_case* test) {
+	
+	uint8_t expected[FLASH_READ_BYTES];
+	
+	uint8_t* page = (uint8_t*)malloc(sizeof(uint8_t) * FLASH_PAGE_BYTES);
+	
+	if (page == NULL) { return TEST_ERROR; }
+	
+	/* The whole page is a single segment longer than 255 bytes */
+	const spi_segment_t segments[] = {
+		SPI_TX(data_flash_read, 4),
+		SPI_FILL(4),
+		SPI_RX(page, FLASH_PAGE_BYTES)
+	};
+	
+	spi_transaction_t transaction = {
+		.device = spi_device,
+		.segments = segments,
+		.nr_segments = ARRAY_LEN(segments),
+		.priority = PRIORITY_LOW,
+		.callback = NULL
+	};
+	
+	if (flash_read_data(spi_device, expected) != 0 || spi_wait(spi_transfer(&transaction)) != SPI_NO_ERROR) {
+		free(page);
+		return TEST_ERROR;
+	}
+	
+	for (uint8_t i = 0; i < FLASH_READ_BYTES; i++) {
+		if (page[i] != expected[i]) {
+			uart_put("%s %d", "[device 1]: page read mismatch at", i);
+			free(page);
+			return TEST_FAIL;
+		}
+	}
+	
+	free(page);
+	
+	return TEST_PASS;
+}
+
+/* Continuous array read (0xE8): opcode, address and four don't care bytes, then the stream */
+static uint8_t data_flash_stream[] = { 0xe8, 0x00, 0x00, 0x00 };
+
+static void callback_stream(void* ctx, uint8_t* buffer, spi_stream_event_t event) {
+	
+	spi_stream_t* stream = ctx;
+	
+	/* The stop takes effect after the half that is already shifting, so both buffers are filled once */
+	if (event == SPI_STREAM_HALF && buffer == stream->buffers[1]) spi_stream_stop(stream);
+}
+
+static int run_spi_stream_test(const struct test_case* test) {
+	
+	static uint8_t block_a[FLASH_PAGE_BYTES / 2];
+	static uint8_t block_b[FLASH_PAGE_BYTES / 2];
+	static uint8_t* const blocks[] = { block_a, block_b };
+	
+	uint8_t expected[FLASH_READ_BYTES];
+	
+	const spi_segment_t command[] = {
+		SPI_TX(data_flash_stream, ARRAY_LEN(data_flash_stream)),
+		SPI_FILL(4)
+	};
+	
+	spi_stream_t stream = {
+		.transaction = {
+			.device = spi_device,
+			.segments = command,
+			.nr_segments = ARRAY_LEN(command),
+			.ctx = &stream
+		},
+		.buffers = blocks,
+		.nr_buffers = ARRAY_LEN(blocks),
+		.length = ARRAY_LEN(block_a),
+		.watermark = callback_stream
+	};
+	
+	if (flash_read_data(spi_device, expected) != 0 || spi_wait(spi_stream_start(&stream)) != SPI_NO_ERROR) return TEST_ERROR;
+	
+	/* The stream starts at page 0, byte 0 */
+	for (uint8_t i = 0; i < FLASH_READ_BYTES; i++) {
+		if (block_a[i] != expected[i]) {
+			uart_put("%s %d", "[device 1]: stream mismatch at", i);
+			return TEST_FAIL;
+		}
+	}
+	
+	return TEST_PASS;
+}
+
 static int run_spi_transfer_test(const struct test_case* test) {
 	
 	bool write_enable = false;
 	bool ret = false;
-    
-    payload_t* payload;
 	
-	uint8_t* spi_receive = (uint8_t*)malloc(sizeof(uint8_t) * ARRAY_LEN(dummy));
+	uint8_t* spi_receive = (uint8_t*)malloc(sizeof(uint8_t) * FLASH_READ_BYTES);
 
 	if (spi_receive == NULL) { return TEST_ERROR; }
 	
@@ -138,7 +287,7 @@ static int run_spi_transfer_test(const struct test_case* test) {
 	}
 	
 	/* Check the read data */
-	for (uint8_t i = 0; i < ARRAY_LEN(dummy); i++) {
+	for (uint8_t i = 0; i < FLASH_READ_BYTES; i++) {
 		if (spi_receive[i] != data_sent[i]) {
 			write_enable = true;
 		}
@@ -152,31 +301,11 @@ static int run_spi_transfer_test(const struct test_case* test) {
 
 		uart_put("%s", "[device 1]: write mode");
 		
-		/* Send the buffer write command followed by data to be written */     
-        payload = payload_create_spi(PRIORITY_LOW, spi_device, data_buffer_write, ARRAY_LEN(data_buffer_write), NULL);
-        
-        ret = spi_write(payload);
-        
-		if (ret != 0) {
+		/* Merges the data into page 0 and waits for the page program */
+		if (at45db_write(&flash, 0, data_sent, ARRAY_LEN(data_sent)) != SPI_NO_ERROR || at45db_sync(&flash) != SPI_NO_ERROR) {
 			free(spi_receive);
 			return TEST_ERROR;
 		}
-
-		/* Flash delay */
-		for (volatile uint16_t i = 0; i < 30000; i++) {}
-
-		/* Send the flash write command to write the previously sent data to flash */
-        payload = payload_create_spi(PRIORITY_LOW, spi_device, data_flash_write, ARRAY_LEN(data_flash_write), NULL);
-        
-		ret = spi_write(payload);
-         
-		if (ret != 0) { 
-			free(spi_receive);
-			return TEST_ERROR;
-		}
-
-		/* Flash delay */
-		for (volatile uint16_t i = 0; i < 30000; i++) {}
 	}
 	
 	/* Read the data from flash. */
@@ -187,7 +316,7 @@ static int run_spi_transfer_test(const struct test_case* test) {
 	}
 
 	/* Check the read data */
-	for (uint8_t i = 0; i < ARRAY_LEN(dummy); i++) {
+	for (uint8_t i = 0; i < FLASH_READ_BYTES; i++) {
 		
 		uart_put("%s %d %s %d", "[device 1]: read spi data", spi_receive[i], "expected", data_sent[i]);
 		
@@ -202,13 +331,303 @@ static int run_spi_transfer_test(const struct test_case* test) {
 	return TEST_PASS;
 }
    
+static int run_spi_cache_test(const struct test_case* test) {
+	
+	uint8_t expected[FLASH_READ_BYTES];
+	uint8_t received[FLASH_READ_BYTES];
+	
+	at45db_cache_stats_t stats;
+	
+	at45db_cache_init(&cache, &flash);
+	
+	if (flash_read_data(spi_device, expected) != 0) return TEST_ERROR;
+	
+	/* The first read loads page 0, the following ones are served from RAM */
+	for (uint8_t n = 0; n < 3; n++) {
+		
+		if (at45db_cache_read(&cache, 0, received, ARRAY_LEN(received)) != SPI_NO_ERROR) return TEST_ERROR;
+		
+		for (uint8_t i = 0; i < ARRAY_LEN(received); i++) {
+			if (received[i] != expected[i]) {
+				uart_put("%s %d", "[device 1]: cache mismatch at", i);
+				return TEST_FAIL;
+			}
+		}
+	}
+	
+	at45db_cache_stats(&cache, &stats);
+	
+	uart_put("%s %lu %s %lu", "[cache]: hits", stats.hits, "misses", stats.misses);
+	
+	if (stats.hits != 2 || stats.misses != 1 || stats.dirty != 0) return TEST_FAIL;
+	
+	return TEST_PASS;
+}
+   
+static int run_spi_batch_test(const struct test_case* test) {
+	
+	uint8_t expected[FLASH_READ_BYTES];
+	uint8_t received[3][FLASH_READ_BYTES];
+	
+	spi_segment_t segments[3][3];
+	spi_transaction_t transactions[3];
+	spi_transaction_t* batch[3];
+	spi_handle_t handles[3];
+	
+	if (flash_read_data(spi_device, expected) != 0) return TEST_ERROR;
+	
+	/* Three reads of page 0 queued at once, each under its own chip select */
+	for (uint8_t n = 0; n < 3; n++) {
+		
+		segments[n][0] = (spi_segment_t)SPI_TX(data_flash_read, 4);
+		segments[n][1] = (spi_segment_t)SPI_FILL(4);
+		segments[n][2] = (spi_segment_t)SPI_RX(received[n], FLASH_READ_BYTES);
+		
+		transactions[n] = (spi_transaction_t){
+			.device = spi_device,
+			.segments = segments[n],
+			.nr_segments = 3,
+			.priority = PRIORITY_LOW,
+			.callback = NULL
+		};
+		
+		batch[n] = &transactions[n];
+	}
+	
+	if (spi_submit_batch(batch, 3, handles) != SPI_NO_ERROR) return TEST_ERROR;
+	
+	for (uint8_t n = 0; n < 3; n++) {
+		
+		if (spi_wait(handles[n]) != SPI_NO_ERROR) return TEST_ERROR;
+		
+		for (uint8_t i = 0; i < FLASH_READ_BYTES; i++) {
+			if (received[n][i] != expected[i]) {
+				uart_put("%s %d %s %d", "[device 1]: batch", n, "mismatch at", i);
+				return TEST_FAIL;
+			}
+		}
+	}
+	
+	return TEST_PASS;
+}
+   
+static int run_spi_error_log_test(const struct test_case* test) {
+	
+	uint8_t data[FLASH_READ_BYTES];
+	
+	spi_error_stats_t stats;
+	spi_error_entry_t entry;
+	
+	spi_error_clear();
+	
+	/* A read behind the end of the flash is rejected, logged and returns right away */
+	if (at45db_read(&flash, AT45DB_SIZE, data, ARRAY_LEN(data)) != SPI_ERR_DATA_OVERFLOW) return TEST_FAIL;
+	
+	spi_error_stats(&stats);
+	
+	if (stats.count[SPI_ERR_DATA_OVERFLOW] != 1 || stats.lost != 0) return TEST_FAIL;
+	
+	if (!spi_error_log_read(&entry) || entry.error != SPI_ERR_DATA_OVERFLOW) return TEST_FAIL;
+	
+	if (spi_error_log_read(&entry)) return TEST_FAIL;
+	
+	return TEST_PASS;
+}
+   
+static int run_spi_stats_test(const struct test_case* test) {
+	
+	uint8_t data[FLASH_READ_BYTES];
+	
+	spi_stats_t stats;
+	spi_device_stats_t device_stats;
+	
+	spi_reset_stats();
+	
+	if (flash_read_data(spi_device, data) != 0) return TEST_ERROR;
+	
+	spi_get_stats(&stats);
+	
+	if (spi_get_device_stats(spi_device, &device_stats) != SPI_NO_ERROR) return TEST_FAIL;
+	
+#if SPI_STATS
+	/* The command and the data phase go out under one chip select */
+	if (device_stats.transactions != 1 || device_stats.bytes != ARRAY_LEN(data_flash_read) + FLASH_READ_BYTES) return TEST_FAIL;
+	
+	if (stats.bus[SPI_BUS_SPI].cs_asserts != 1 || stats.bus[SPI_BUS_SPI].bytes != device_stats.bytes) return TEST_FAIL;
+	
+	if (stats.bus[SPI_BUS_SPI].busy > stats.bus[SPI_BUS_SPI].elapsed) return TEST_FAIL;
+	
+	spi_reset_stats();
+	spi_get_device_stats(spi_device, &device_stats);
+	
+	if (device_stats.transactions != 0) return TEST_FAIL;
+#else
+	if (stats.bus[SPI_BUS_SPI].cs_asserts != 0 || device_stats.transactions != 0) return TEST_FAIL;
+#endif
+	
+	return TEST_PASS;
+}
+   
+static int run_spi_wait_idle_test(const struct test_case* test) {
+	
+	uint8_t expected[FLASH_READ_BYTES];
+	uint8_t data[2][FLASH_READ_BYTES];
+	spi_handle_t handles[2];
+	spi_error_t status;
+	
+	spi_stats_t stats;
+	
+	if (flash_read_data(spi_device, expected) != 0) return TEST_ERROR;
+	
+	spi_reset_stats();
+	
+	/* Both reads are in flight at once, neither handle is waited on */
+	for (uint8_t i = 0; i < 2; i++) {
+		
+		payload_t* command = payload_create_spi(PRIORITY_LOW, spi_device, data_flash_read, ARRAY_LEN(data_flash_read), NULL);
+		payload_t* read = payload_create_spi(PRIORITY_LOW, spi_device, NULL, FLASH_READ_BYTES, NULL);
+		
+		handles[i] = spi_read_write(command, read, data[i]);
+	}
+	
+	if (spi_wait_idle() != SPI_NO_ERROR) return TEST_FAIL;
+	
+	for (uint8_t i = 0; i < 2; i++) {
+		
+		if (!spi_poll(handles[i], &status) || status != SPI_NO_ERROR) return TEST_FAIL;
+		
+		if (memcmp(data[i], expected, FLASH_READ_BYTES) != 0) return TEST_FAIL;
+	}
+	
+	spi_get_stats(&stats);
+	
+#if SPI_STATS
+	if (stats.sleep.waits != 1 || stats.sleep.slept > stats.bus[SPI_BUS_SPI].elapsed) return TEST_FAIL;
+#else
+	if (stats.sleep.waits != 0 || stats.sleep.slept != 0) return TEST_FAIL;
+#endif
+	
+	/* Nothing is queued, the wait returns right away */
+	if (spi_wait_idle() != SPI_NO_ERROR) return TEST_FAIL;
+	
+	return TEST_PASS;
+}
+   
+static int run_spi_handles_test(const struct test_case* test) {
+	
+	spi_segment_t segments[SPI_HANDLES + 1];
+	spi_transaction_t transactions[SPI_HANDLES + 1];
+	spi_handle_t handles[SPI_HANDLES + 1];
+	spi_error_t refused = SPI_NO_ERROR;
+	
+	spi_device_config_t config = {
+		.bus = SPI_BUS_SPI,
+		.data_order = spi_config.data_order,
+		.mode = spi_config.mode,
+		.max_frequency = F_CPU / 128,
+		.fill_byte = spi_config.fill_byte
+	};
+	
+	/* Slow enough that none of the status reads is polled */
+	device_t* device = spi_create_device(&SPI_PORT, bench_ports[0], &config);
+	
+	if (device == NULL) return TEST_ERROR;
+	
+	bench_data[0] = AT45DB_STATUS_READ;
+	
+	/* Every handle is taken before the first transaction can complete, the last submission finds none */
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		for (uint8_t i = 0; i < SPI_HANDLES + 1; i++) {
+			
+			segments[i] = (spi_segment_t)SPI_TX(bench_data, 16);
+			transactions[i] = (spi_transaction_t){ .device = device, .segments = &segments[i], .nr_segments = 1,
+				.priority = PRIORITY_LOW, .callback = (i == SPI_HANDLES) ? callback_status : NULL, .ctx = &refused };
+			
+			handles[i] = spi_transfer(&transactions[i]);
+		}
+	}
+	
+	uint8_t ok = handles[SPI_HANDLES] == SPI_HANDLE_NONE && refused == SPI_ERR_BUFFER_OVERFLOW
+		&& spi_wait(handles[SPI_HANDLES]) == SPI_ERR_BUFFER_OVERFLOW;
+	
+	for (uint8_t i = 0; i < SPI_HANDLES; i++) {
+		if (spi_wait(handles[i]) != SPI_NO_ERROR) ok = 0;
+	}
+	
+	spi_free_device(device);
+	
+	return ok ? TEST_PASS : TEST_FAIL;
+}
+
+static int run_spi_trace_test(const struct test_case* test) {
+	
+	uint8_t data[FLASH_READ_BYTES];
+	
+	spi_trace_entry_t entry;
+	
+	spi_trace_clear();
+	
+	if (flash_read_data(spi_device, data) != 0) return TEST_ERROR;
+	
+#if SPI_TRACE
+	uint8_t events = 0;
+	
+	/* Submission, chip select, segment switches if it was interrupt driven, release and completion */
+	while (spi_trace_read(&entry)) {
+		
+		if (entry.device != spi_device->id) return TEST_FAIL;
+		
+		if (events == 0 && entry.event != SPI_TRACE_SUBMIT) return TEST_FAIL;
+		if (events == 1 && entry.event != SPI_TRACE_CS_ASSERT) return TEST_FAIL;
+		
+		events++;
+	}
+	
+	if (events < 4 || entry.event != SPI_TRACE_DONE || entry.arg != SPI_NO_ERROR) return TEST_FAIL;
+#else
+	if (spi_trace_read(&entry)) return TEST_FAIL;
+#endif
+	
+	return TEST_PASS;
+}
+   
+static int run_spi_static_device_test(const struct test_case* test) {
+	
+	static device_t flash = SPI_DEVICE(B, PORTB4, SPI_MSB, SPI_MODE3, 2, SPI_FILL_BYTE);
+	
+	uint8_t data[FLASH_READ_BYTES];
+	uint8_t expected[FLASH_READ_BYTES];
+	
+	/* The folded register values match the ones spi_create_device() resolved for the same settings */
+	if (flash.ctrl != spi_device->ctrl || flash.rate != spi_device->rate || flash.fill != spi_device->fill) return TEST_FAIL;
+	
+	if (flash.port != spi_device->port) return TEST_FAIL;
+	
+	if (spi_add_device(&flash) != SPI_NO_ERROR) return TEST_ERROR;
+	
+	if (flash.poll_max_bytes != spi_device->poll_max_bytes) return TEST_FAIL;
+	
+	if (flash_read_data(spi_device, expected) != 0 || flash_read_data(&flash, data) != 0) return TEST_ERROR;
+	
+	spi_free_device(&flash);
+	
+	if (memcmp(data, expected, FLASH_READ_BYTES) != 0) return TEST_FAIL;
+	
+	/* A freed device keeps its port and can be added again */
+	if (spi_add_device(&flash) != SPI_NO_ERROR) return TEST_FAIL;
+	
+	spi_free_device(&flash);
+	
+	return TEST_PASS;
+}
+   
 static int run_spi_memory_leak_test(const struct test_case* test) {
     
-    bool ret = 0;
+    uint16_t completed = 0;
     
     int number_of_tasks = 30000; // <-- increase value to provoke possible memory leak
     
-    uint8_t* container = (uint8_t*)malloc(sizeof(uint8_t) * ARRAY_LEN(dummy));
+    uint8_t* container = (uint8_t*)malloc(sizeof(uint8_t) * FLASH_READ_BYTES);
     
     if (container == NULL) {
         uart_put("%s", "Failed creating container!");
@@ -219,35 +638,94 @@ static int run_spi_memory_leak_test(const struct test_case* test) {
     
     for (int i = 0; i < number_of_tasks; i++) {
               
-        payload = payload_create_spi(PRIORITY_LOW, spi_device, dummy, ARRAY_LEN(dummy), &callback_memory_leak);
+        payload = payload_create_spi(PRIORITY_LOW, spi_device, NULL, FLASH_READ_BYTES, &callback_memory_leak);
             
         if (payload == NULL) {
             free(container);
             return TEST_ERROR;
         }    
-             
-        ret = spi_read(payload, container);
         
-        if (ret != 0) {
+        payload->transaction.ctx = &completed;
+        
+        if (spi_wait(spi_read(payload, container)) != SPI_NO_ERROR) {
             uart_put("%s %i", "Failed at task: ", i);
             free(container);
-            free(payload);
             return TEST_ERROR;
         }
-        
-        while(memory_return_success != 1);
-        
-        memory_return_success = 0;
-        
     }
     
     free(container);
     
+    /* Every payload has to be back in the pool once the last transfer completed */
+    spi_pool_stats_t stats;
+    
+    spi_payload_pool_stats(&stats);
+    
+    uart_put("%s %u %s %u", "[pool]: high watermark", stats.high_watermark, "exhausted", stats.exhausted);
+    
+    if (stats.in_use != 0 || completed != number_of_tasks) return TEST_FAIL;
+    
     return TEST_PASS;
 }
      
-void test_spi(void) {
-    
+static void setup_spi_bench(const struct bench_case* bench) {
+	
+	const spi_bench_t* params = bench->params;
+	
+	spi_device_config_t config = {
+		.bus = SPI_BUS_SPI,
+		.data_order = spi_config.data_order,
+		.mode = spi_config.mode,
+		.max_frequency = params->frequency,
+		.fill_byte = spi_config.fill_byte
+	};
+	
+	/* A status read, the flash keeps sending its status register while the chip select is asserted */
+	bench_data[0] = AT45DB_STATUS_READ;
+	
+	for (uint8_t i = 0; i < params->nr_devices; i++) {
+		bench_devices[i] = spi_create_device(&SPI_PORT, bench_ports[i], &config);
+	}
+}
+
+static void cleanup_spi_bench(const struct bench_case* bench) {
+	
+	const spi_bench_t* params = bench->params;
+	
+	for (uint8_t i = 0; i < params->nr_devices; i++) {
+		if (bench_devices[i] != NULL) spi_free_device(bench_devices[i]);
+		bench_devices[i] = NULL;
+	}
+}
+
+/* Sends BENCH_TRANSACTIONS writes round robin to the devices of the case and waits for all of them */
+static int run_spi_bench(const struct bench_case* bench) {
+	
+	const spi_bench_t* params = bench->params;
+	spi_handle_t handles[BENCH_TRANSACTIONS];
+	
+	for (uint8_t i = 0; i < BENCH_TRANSACTIONS; i++) {
+		
+		device_t* device = bench_devices[i % params->nr_devices];
+		
+		if (device == NULL) return TEST_ERROR;
+		
+		bench_segments[i] = (spi_segment_t)SPI_TX(bench_data, params->size);
+		bench_transactions[i] = (spi_transaction_t){ .device = device, .segments = &bench_segments[i], .nr_segments = 1,
+			.priority = PRIORITY_LOW, .callback = NULL, .ctx = NULL };
+		
+		handles[i] = spi_transfer(&bench_transactions[i]);
+	}
+	
+	for (uint8_t i = 0; i < BENCH_TRANSACTIONS; i++) {
+		if (spi_wait(handles[i]) != SPI_NO_ERROR) return TEST_FAIL;
+	}
+	
+	return TEST_PASS;
+}
+
+static void test_spi_init(void) {
+	
 	cli();		
 	
 	led_init();
@@ -256,18 +734,53 @@ void test_spi(void) {
 	
 	spi_init(&spi_config);
 	
+#if SPI_STATS && defined(TCCR1B)
+	/* SPI_STATS_TIME() reads Timer1, free-running at F_CPU / 8; the suite keeps to Timer3 */
+	TCCR1A = 0;
+	TCCR1B = (1 << CS11);
+#endif
+	
 	sei();
 	
-	spi_device = spi_create_device(SPI_TEST_PORT, SPI_TEST_PORT, SPI_TEST_PORT);
+	spi_device = spi_create_device(&SPI_PORT, SPI_TEST_PORT, NULL);
+	
+	at45db_init(&flash, spi_device);
+}
+
+void test_spi(void) {
+    
+	test_spi_init();
     	
 	DEFINE_TEST_CASE(data_flash_read_test, NULL, run_spi_flash_read_test, NULL, "SPI data flash read test");
 	DEFINE_TEST_CASE(data_transfer_test, NULL, run_spi_transfer_test, NULL, "SPI data transfer test");
+	DEFINE_TEST_CASE(transaction_test, NULL, run_spi_transaction_test, NULL, "SPI transaction test");
+	DEFINE_TEST_CASE(page_read_test, NULL, run_spi_page_read_test, NULL, "SPI page read test");
+	DEFINE_TEST_CASE(stream_test, NULL, run_spi_stream_test, NULL, "SPI stream test");
+	DEFINE_TEST_CASE(cache_test, NULL, run_spi_cache_test, NULL, "AT45DB page cache test");
+	DEFINE_TEST_CASE(batch_test, NULL, run_spi_batch_test, NULL, "SPI batch submission test");
+	DEFINE_TEST_CASE(error_log_test, NULL, run_spi_error_log_test, NULL, "SPI error log test");
+	DEFINE_TEST_CASE(stats_test, NULL, run_spi_stats_test, NULL, "SPI statistics test");
+	DEFINE_TEST_CASE(wait_idle_test, NULL, run_spi_wait_idle_test, NULL, "SPI wait idle test");
+	DEFINE_TEST_CASE(handles_test, NULL, run_spi_handles_test, NULL, "SPI completion handles test");
+	DEFINE_TEST_CASE(trace_test, NULL, run_spi_trace_test, NULL, "SPI trace test");
+	DEFINE_TEST_CASE(static_device_test, NULL, run_spi_static_device_test, NULL, "SPI static device test");
     DEFINE_TEST_CASE(memory_leak_test, NULL, run_spi_memory_leak_test, NULL, "SPI memory leak test");
 
 	/* Put test case addresses in an array */
 	DEFINE_TEST_ARRAY(spi_tests) = {
 		&data_flash_read_test,
 		&data_transfer_test,
+		&transaction_test,
+		&page_read_test,
+		&stream_test,
+		&cache_test,
+		&batch_test,
+		&error_log_test,
+		&stats_test,
+		&wait_idle_test,
+		&handles_test,
+		&trace_test,
+		&static_device_test,
         &memory_leak_test
 	};
     	
@@ -276,4 +789,68 @@ void test_spi(void) {
     
 	/* Run all tests in the test suite */
 	test_spi_suite_run(&spi_suite);
-}
\ No newline at end of file
+}
+
+void test_spi_bench(void) {
+	
+	/* Throughput per clock_rate_t */
+	static const spi_bench_t div2	= { F_CPU / 2, 64, 1 };
+	static const spi_bench_t div4	= { F_CPU / 4, 64, 1 };
+	static const spi_bench_t div8	= { F_CPU / 8, 64, 1 };
+	static const spi_bench_t div16	= { F_CPU / 16, 64, 1 };
+	static const spi_bench_t div32	= { F_CPU / 32, 64, 1 };
+	static const spi_bench_t div64	= { F_CPU / 64, 64, 1 };
+	static const spi_bench_t div128	= { F_CPU / 128, 64, 1 };
+	
+	/* Throughput per payload size */
+	static const spi_bench_t size1		= { F_CPU / 16, 1, 1 };
+	static const spi_bench_t size4		= { F_CPU / 16, 4, 1 };
+	static const spi_bench_t size16		= { F_CPU / 16, 16, 1 };
+	static const spi_bench_t size255	= { F_CPU / 16, 255, 1 };
+	
+	/* Transactions alternating between devices */
+	static const spi_bench_t devices1	= { F_CPU / 16, 16, 1 };
+	static const spi_bench_t devices2	= { F_CPU / 16, 16, 2 };
+	static const spi_bench_t devices4	= { F_CPU / 16, 16, 4 };
+	
+	test_spi_init();
+	
+	DEFINE_BENCH_CASE(div2_bench, setup_spi_bench, run_spi_bench, cleanup_spi_bench, "throughput div=2 size=64 devices=1", &div2, BENCH_TRANSACTIONS * 64);
+	DEFINE_BENCH_CASE(div4_bench, setup_spi_bench, run_spi_bench, cleanup_spi_bench, "throughput div=4 size=64 devices=1", &div4, BENCH_TRANSACTIONS * 64);
+	DEFINE_BENCH_CASE(div8_bench, setup_spi_bench, run_spi_bench, cleanup_spi_bench, "throughput div=8 size=64 devices=1", &div8, BENCH_TRANSACTIONS * 64);
+	DEFINE_BENCH_CASE(div16_bench, setup_spi_bench, run_spi_bench, cleanup_spi_bench, "throughput div=16 size=64 devices=1", &div16, BENCH_TRANSACTIONS * 64);
+	DEFINE_BENCH_CASE(div32_bench, setup_spi_bench, run_spi_bench, cleanup_spi_bench, "throughput div=32 size=64 devices=1", &div32, BENCH_TRANSACTIONS * 64);
+	DEFINE_BENCH_CASE(div64_bench, setup_spi_bench, run_spi_bench, cleanup_spi_bench, "throughput div=64 size=64 devices=1", &div64, BENCH_TRANSACTIONS * 64);
+	DEFINE_BENCH_CASE(div128_bench, setup_spi_bench, run_spi_bench, cleanup_spi_bench, "throughput div=128 size=64 devices=1", &div128, BENCH_TRANSACTIONS * 64);
+	DEFINE_BENCH_CASE(size1_bench, setup_spi_bench, run_spi_bench, cleanup_spi_bench, "throughput div=16 size=1 devices=1", &size1, BENCH_TRANSACTIONS * 1);
+	DEFINE_BENCH_CASE(size4_bench, setup_spi_bench, run_spi_bench, cleanup_spi_bench, "throughput div=16 size=4 devices=1", &size4, BENCH_TRANSACTIONS * 4);
+	DEFINE_BENCH_CASE(size16_bench, setup_spi_bench, run_spi_bench, cleanup_spi_bench, "throughput div=16 size=16 devices=1", &size16, BENCH_TRANSACTIONS * 16);
+	DEFINE_BENCH_CASE(size255_bench, setup_spi_bench, run_spi_bench, cleanup_spi_bench, "throughput div=16 size=255 devices=1", &size255, BENCH_TRANSACTIONS * 255);
+	DEFINE_BENCH_CASE(devices1_bench, setup_spi_bench, run_spi_bench, cleanup_spi_bench, "devices div=16 size=16 devices=1", &devices1, BENCH_TRANSACTIONS * 16);
+	DEFINE_BENCH_CASE(devices2_bench, setup_spi_bench, run_spi_bench, cleanup_spi_bench, "devices div=16 size=16 devices=2", &devices2, BENCH_TRANSACTIONS * 16);
+	DEFINE_BENCH_CASE(devices4_bench, setup_spi_bench, run_spi_bench, cleanup_spi_bench, "devices div=16 size=16 devices=4", &devices4, BENCH_TRANSACTIONS * 16);
+	
+	/* Put bench case addresses in an array */
+	DEFINE_BENCH_ARRAY(spi_benches) = {
+		&div2_bench,
+		&div4_bench,
+		&div8_bench,
+		&div16_bench,
+		&div32_bench,
+		&div64_bench,
+		&div128_bench,
+		&size1_bench,
+		&size4_bench,
+		&size16_bench,
+		&size255_bench,
+		&devices1_bench,
+		&devices2_bench,
+		&devices4_bench
+	};
+	
+	/* Define the bench suite, an odd number of repetitions has a single median */
+	DEFINE_BENCH_SUITE(spi_bench_suite, spi_benches, "SPI driver benchmarks", 15);
+	
+	/* Run all bench cases in the suite */
+	test_spi_bench_run(&spi_bench_suite);
+}
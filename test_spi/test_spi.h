@@ -5,8 +5,10 @@
 
 #if defined(__AVR_ATmega1284P__) || defined(__AVR_ATmega16__)
 #   define SPI_TEST_PORT PORTB4
+#   define SPI_BENCH_PORTS SPI_TEST_PORT, PORTB3, PORTB2, PORTB1
 # elif defined(__AVR_ATmega2560__)
 #   define SPI_TEST_PORT PB0
+#   define SPI_BENCH_PORTS SPI_TEST_PORT, PB4, PB5, PB6
 #else
 #  if !defined(__COMPILING_AVR_LIBC__)
 #    warning "NO SPI_TEST_PORT DEFINED FOR MICROCONTROLLER"
@@ -15,4 +17,6 @@
 
 void test_spi(void);
 
+void test_spi_bench(void);
+
 #endif /* TEST_SPI_H_ */
\ No newline at end of file